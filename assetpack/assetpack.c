@@ -0,0 +1,1051 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "asset_pack.h"
+
+enum {
+    PACK_MAX_PALETTES = MODE0_PALETTE_256_BANKS * 16,
+    PACK_MAX_TILES = 0x10000,
+    PACK_HASH_SLOTS = 1u << 19,
+    PACK_BMP_FILE_HEADER_BYTES = 14
+};
+
+typedef enum JsonType {
+    JSON_NULL,
+    JSON_BOOL,
+    JSON_NUMBER,
+    JSON_STRING,
+    JSON_ARRAY,
+    JSON_OBJECT
+} JsonType;
+
+typedef struct JsonValue {
+    JsonType type;
+    double number;
+    char *string;
+    char **keys;
+    struct JsonValue *items;
+    size_t count;
+} JsonValue;
+
+typedef struct JsonParser {
+    const char *text;
+    size_t cursor;
+    size_t size;
+} JsonParser;
+
+typedef struct PackSprite {
+    VirtuaPPUAssetSprite record;
+    uint8_t *pixels;
+    uint16_t source_palette;
+    uint32_t tiles_hash;
+    bool bg;
+} PackSprite;
+
+typedef struct PackBuilder {
+    Mode0Palette16Rgb888 source_palettes[PACK_MAX_PALETTES];
+    uint32_t source_palette_count;
+    Mode0Palette16Rgb888 palettes[PACK_MAX_PALETTES];
+    uint8_t palette_sizes[PACK_MAX_PALETTES];
+    uint32_t palette_count;
+    PackSprite *sprites;
+    uint32_t sprite_count;
+    Mode0TileEntry *entries;
+    uint32_t entry_count;
+    uint32_t entry_capacity;
+    uint8_t *gfx;
+    uint32_t tile_count;
+    uint32_t tile_capacity;
+    uint32_t *tile_hash;
+    uint32_t source_tiles;
+    uint32_t flipped_tiles;
+    uint32_t shared_sprites;
+    uint32_t bmp_sprites;
+    bool dedupe;
+    bool pack_palettes;
+} PackBuilder;
+
+static void json_free(JsonValue *value)
+{
+    size_t i;
+
+    for (i = 0; i < value->count; ++i) {
+        json_free(&value->items[i]);
+        if (value->keys != NULL) {
+            free(value->keys[i]);
+        }
+    }
+    free(value->items);
+    free(value->keys);
+    free(value->string);
+    memset(value, 0, sizeof(*value));
+}
+
+static void json_skip_space(JsonParser *parser)
+{
+    while (parser->cursor < parser->size && strchr(" \t\r\n", parser->text[parser->cursor]) != NULL) {
+        ++parser->cursor;
+    }
+}
+
+static bool json_parse_value(JsonParser *parser, JsonValue *value, int depth);
+
+static bool json_parse_string(JsonParser *parser, char **out)
+{
+    size_t length = 0u;
+    char *string;
+
+    if (parser->text[parser->cursor] != '"') {
+        return false;
+    }
+    ++parser->cursor;
+
+    string = (char *)malloc(parser->size - parser->cursor + 1u);
+    if (string == NULL) {
+        return false;
+    }
+
+    while (parser->cursor < parser->size && parser->text[parser->cursor] != '"') {
+        char c = parser->text[parser->cursor++];
+
+        if (c == '\\' && parser->cursor < parser->size) {
+            c = parser->text[parser->cursor++];
+            switch (c) {
+            case 'n':
+                c = '\n';
+                break;
+            case 't':
+                c = '\t';
+                break;
+            case 'r':
+                c = '\r';
+                break;
+            case 'b':
+                c = '\b';
+                break;
+            case 'f':
+                c = '\f';
+                break;
+            case 'u':
+                /* Asset names are ASCII; other code points are kept as a placeholder. */
+                parser->cursor += (parser->cursor + 4u <= parser->size) ? 4u : 0u;
+                c = '?';
+                break;
+            default:
+                break;
+            }
+        }
+        string[length++] = c;
+    }
+
+    if (parser->cursor >= parser->size) {
+        free(string);
+        return false;
+    }
+
+    ++parser->cursor;
+    string[length] = '\0';
+    *out = string;
+    return true;
+}
+
+static bool json_append(JsonValue *value, char *key, JsonValue *item)
+{
+    JsonValue *items = (JsonValue *)realloc(value->items, (value->count + 1u) * sizeof(*items));
+
+    if (items == NULL) {
+        return false;
+    }
+    value->items = items;
+
+    if (value->type == JSON_OBJECT) {
+        char **keys = (char **)realloc(value->keys, (value->count + 1u) * sizeof(*keys));
+
+        if (keys == NULL) {
+            return false;
+        }
+        value->keys = keys;
+        value->keys[value->count] = key;
+    }
+
+    value->items[value->count++] = *item;
+    return true;
+}
+
+static bool json_parse_container(JsonParser *parser, JsonValue *value, int depth)
+{
+    char close = (value->type == JSON_OBJECT) ? '}' : ']';
+
+    ++parser->cursor;
+    json_skip_space(parser);
+    if (parser->cursor < parser->size && parser->text[parser->cursor] == close) {
+        ++parser->cursor;
+        return true;
+    }
+
+    for (;;) {
+        JsonValue item;
+        char *key = NULL;
+
+        memset(&item, 0, sizeof(item));
+        json_skip_space(parser);
+        if (value->type == JSON_OBJECT) {
+            if (parser->cursor >= parser->size || !json_parse_string(parser, &key)) {
+                return false;
+            }
+            json_skip_space(parser);
+            if (parser->cursor >= parser->size || parser->text[parser->cursor] != ':') {
+                free(key);
+                return false;
+            }
+            ++parser->cursor;
+        }
+
+        if (!json_parse_value(parser, &item, depth + 1) || !json_append(value, key, &item)) {
+            json_free(&item);
+            free(key);
+            return false;
+        }
+
+        json_skip_space(parser);
+        if (parser->cursor >= parser->size) {
+            return false;
+        }
+        if (parser->text[parser->cursor] == ',') {
+            ++parser->cursor;
+            continue;
+        }
+        if (parser->text[parser->cursor] == close) {
+            ++parser->cursor;
+            return true;
+        }
+        return false;
+    }
+}
+
+static bool json_parse_value(JsonParser *parser, JsonValue *value, int depth)
+{
+    const char *start;
+    char *end;
+
+    json_skip_space(parser);
+    if (parser->cursor >= parser->size || depth > 64) {
+        return false;
+    }
+
+    start = parser->text + parser->cursor;
+    switch (*start) {
+    case '{':
+        value->type = JSON_OBJECT;
+        return json_parse_container(parser, value, depth);
+    case '[':
+        value->type = JSON_ARRAY;
+        return json_parse_container(parser, value, depth);
+    case '"':
+        value->type = JSON_STRING;
+        return json_parse_string(parser, &value->string);
+    default:
+        break;
+    }
+
+    if (strncmp(start, "null", 4) == 0) {
+        value->type = JSON_NULL;
+        parser->cursor += 4u;
+        return true;
+    }
+    if (strncmp(start, "true", 4) == 0 || strncmp(start, "false", 5) == 0) {
+        value->type = JSON_BOOL;
+        value->number = (*start == 't') ? 1.0 : 0.0;
+        parser->cursor += (*start == 't') ? 4u : 5u;
+        return true;
+    }
+
+    value->type = JSON_NUMBER;
+    value->number = strtod(start, &end);
+    if (end == start) {
+        return false;
+    }
+    parser->cursor += (size_t)(end - start);
+    return true;
+}
+
+static const JsonValue *json_get(const JsonValue *object, const char *key)
+{
+    size_t i;
+
+    if (object == NULL || object->type != JSON_OBJECT) {
+        return NULL;
+    }
+
+    for (i = 0; i < object->count; ++i) {
+        if (strcmp(object->keys[i], key) == 0) {
+            return &object->items[i];
+        }
+    }
+
+    return NULL;
+}
+
+static long json_get_int(const JsonValue *object, const char *key, long fallback)
+{
+    const JsonValue *value = json_get(object, key);
+
+    return (value != NULL && value->type == JSON_NUMBER) ? (long)value->number : fallback;
+}
+
+static char *pack_read_file(const char *path, size_t *size)
+{
+    FILE *file = fopen(path, "rb");
+    char *data;
+    long length;
+
+    if (file == NULL) {
+        return NULL;
+    }
+    if (fseek(file, 0, SEEK_END) != 0 || (length = ftell(file)) < 0 || fseek(file, 0, SEEK_SET) != 0) {
+        fclose(file);
+        return NULL;
+    }
+
+    data = (char *)malloc((size_t)length + 1u);
+    if (data == NULL || fread(data, 1u, (size_t)length, file) != (size_t)length) {
+        free(data);
+        fclose(file);
+        return NULL;
+    }
+
+    fclose(file);
+    data[length] = '\0';
+    *size = (size_t)length;
+    return data;
+}
+
+static uint32_t pack_get_u32(const uint8_t *src)
+{
+    return (uint32_t)src[0] | ((uint32_t)src[1] << 8u) | ((uint32_t)src[2] << 16u) | ((uint32_t)src[3] << 24u);
+}
+
+/* Reads an uncompressed 4bpp or 8bpp indexed BMP into one palette index per pixel, top row first. */
+static uint8_t *pack_read_bmp(const char *path, uint32_t *width, uint32_t *height)
+{
+    size_t size = 0u;
+    uint8_t *file = (uint8_t *)pack_read_file(path, &size);
+    uint8_t *pixels;
+    uint32_t data_offset;
+    int32_t raw_height;
+    uint32_t bpp;
+    uint32_t stride;
+    uint32_t x;
+    uint32_t y;
+
+    if (file == NULL) {
+        return NULL;
+    }
+    if (size < PACK_BMP_FILE_HEADER_BYTES + 40u || file[0] != 'B' || file[1] != 'M') {
+        free(file);
+        return NULL;
+    }
+
+    data_offset = pack_get_u32(file + 10u);
+    *width = pack_get_u32(file + 18u);
+    raw_height = (int32_t)pack_get_u32(file + 22u);
+    bpp = (uint32_t)file[28] | ((uint32_t)file[29] << 8u);
+    *height = (uint32_t)((raw_height < 0) ? -raw_height : raw_height);
+    stride = ((*width * bpp + 31u) / 32u) * 4u;
+
+    if ((bpp != 4u && bpp != 8u) || pack_get_u32(file + 30u) != 0u || *width == 0u || *height == 0u ||
+        *width > 4096u || *height > 4096u || (uint64_t)data_offset + (uint64_t)stride * *height > size) {
+        free(file);
+        return NULL;
+    }
+
+    pixels = (uint8_t *)malloc((size_t)*width * *height);
+    if (pixels == NULL) {
+        free(file);
+        return NULL;
+    }
+
+    for (y = 0; y < *height; ++y) {
+        const uint8_t *row = file + data_offset + (size_t)((raw_height < 0) ? y : *height - 1u - y) * stride;
+
+        for (x = 0; x < *width; ++x) {
+            pixels[(size_t)y * *width + x] = (bpp == 8u) ? row[x] : (uint8_t)((row[x / 2u] >> ((x & 1u) ? 0u : 4u)) & 0x0Fu);
+        }
+    }
+
+    free(file);
+    return pixels;
+}
+
+static bool pack_reserve(PackBuilder *builder, uint32_t tiles)
+{
+    if (builder->tile_count + tiles > PACK_MAX_TILES) {
+        return false;
+    }
+
+    if (builder->tile_count + tiles > builder->tile_capacity) {
+        uint32_t capacity = builder->tile_capacity ? builder->tile_capacity : 256u;
+        uint8_t *gfx;
+
+        while (capacity < builder->tile_count + tiles) {
+            capacity *= 2u;
+        }
+        gfx = (uint8_t *)realloc(builder->gfx, (size_t)capacity * VIRTUAPPU_ASSET_PACK_TILE_BYTES);
+        if (gfx == NULL) {
+            return false;
+        }
+        builder->gfx = gfx;
+        builder->tile_capacity = capacity;
+    }
+
+    if (builder->entry_count + tiles > builder->entry_capacity) {
+        uint32_t capacity = builder->entry_capacity ? builder->entry_capacity : 256u;
+        Mode0TileEntry *entries;
+
+        while (capacity < builder->entry_count + tiles) {
+            capacity *= 2u;
+        }
+        entries = (Mode0TileEntry *)realloc(builder->entries, (size_t)capacity * sizeof(*entries));
+        if (entries == NULL) {
+            return false;
+        }
+        builder->entries = entries;
+        builder->entry_capacity = capacity;
+    }
+
+    return true;
+}
+
+static bool pack_add_palettes(PackBuilder *builder, const JsonValue *palettes)
+{
+    size_t i;
+
+    if (palettes == NULL || palettes->type != JSON_ARRAY) {
+        return true;
+    }
+    if (palettes->count > PACK_MAX_PALETTES) {
+        fprintf(stderr, "too many 16-colour palettes (%zu, at most %d)\n", palettes->count, PACK_MAX_PALETTES);
+        return false;
+    }
+
+    for (i = 0; i < palettes->count; ++i) {
+        const JsonValue *colors = json_get(&palettes->items[i], "colors");
+        Mode0Palette16Rgb888 *palette = &builder->source_palettes[builder->source_palette_count++];
+        size_t c;
+
+        memset(palette, 0, sizeof(*palette));
+        for (c = 0; colors != NULL && colors->type == JSON_ARRAY && c < colors->count && c < 16u; ++c) {
+            palette->colors[c].r = (uint8_t)json_get_int(&colors->items[c], "r", 0);
+            palette->colors[c].g = (uint8_t)json_get_int(&colors->items[c], "g", 0);
+            palette->colors[c].b = (uint8_t)json_get_int(&colors->items[c], "b", 0);
+        }
+    }
+
+    return true;
+}
+
+/* Pixels come from sprites/<name>.bmp when it exists; otherwise from the 4bpp tile data in the JSON. */
+static bool pack_add_sprite(PackBuilder *builder, const JsonValue *json, const char *sprite_dir)
+{
+    PackSprite *sprite = &builder->sprites[builder->sprite_count];
+    VirtuaPPUAssetSprite *record = &sprite->record;
+    const JsonValue *name = json_get(json, "name");
+    const JsonValue *tiles = json_get(json, "tiles");
+    const JsonValue *usage = json_get(json, "usage");
+    char path[1024];
+    uint32_t width = 0u;
+    uint32_t height = 0u;
+    uint32_t tile_count;
+    size_t p;
+    uint32_t i;
+
+    memset(sprite, 0, sizeof(*sprite));
+    if (name == NULL || name->type != JSON_STRING || strlen(name->string) >= VIRTUAPPU_ASSET_PACK_NAME_BYTES) {
+        fprintf(stderr, "sprite %u: missing name or longer than %d bytes\n", builder->sprite_count, VIRTUAPPU_ASSET_PACK_NAME_BYTES - 1);
+        return false;
+    }
+
+    strcpy(record->name, name->string);
+    record->width = (uint16_t)json_get_int(json, "width", 0);
+    record->height = (uint16_t)json_get_int(json, "height", 0);
+    record->blocks_w = (uint8_t)json_get_int(json, "blocks_w", record->width / 8u);
+    record->blocks_h = (uint8_t)json_get_int(json, "blocks_h", record->height / 8u);
+    sprite->source_palette = (uint16_t)json_get_int(json, "palette_index", 0);
+    tile_count = (uint32_t)record->blocks_w * record->blocks_h;
+
+    /* Sprites are OBJ art unless marked "usage": "bg", which lets their tiles be shared one by one. */
+    if (usage != NULL && (usage->type != JSON_STRING || (strcmp(usage->string, "bg") != 0 && strcmp(usage->string, "obj") != 0))) {
+        fprintf(stderr, "%s: usage must be \"obj\" or \"bg\"\n", record->name);
+        return false;
+    }
+    sprite->bg = usage != NULL && strcmp(usage->string, "bg") == 0;
+
+    if (sprite->source_palette >= builder->source_palette_count) {
+        fprintf(stderr, "%s: palette %u does not exist\n", record->name, sprite->source_palette);
+        return false;
+    }
+    if (snprintf(path, sizeof(path), "%s/%s.bmp", sprite_dir, record->name) >= (int)sizeof(path)) {
+        fprintf(stderr, "%s: sprite path too long\n", record->name);
+        return false;
+    }
+
+    sprite->pixels = pack_read_bmp(path, &width, &height);
+    if (sprite->pixels != NULL) {
+        if (width != (uint32_t)record->blocks_w * 8u || height != (uint32_t)record->blocks_h * 8u) {
+            fprintf(stderr, "%s: %ux%u BMP does not match %ux%u blocks\n", path, width, height, record->blocks_w, record->blocks_h);
+            return false;
+        }
+        for (p = 0; p < (size_t)width * height; ++p) {
+            if (sprite->pixels[p] > 15u) {
+                fprintf(stderr, "%s: colour index %u does not fit a 16-colour palette\n", path, sprite->pixels[p]);
+                return false;
+            }
+        }
+        ++builder->bmp_sprites;
+        return true;
+    }
+
+    if (tiles == NULL || tiles->type != JSON_ARRAY || tiles->count != tile_count) {
+        fprintf(stderr, "%s: no BMP at %s and %u tiles expected in the JSON\n", record->name, path, tile_count);
+        return false;
+    }
+
+    width = (uint32_t)record->blocks_w * 8u;
+    sprite->pixels = (uint8_t *)malloc((size_t)tile_count * 64u + 1u);
+    if (sprite->pixels == NULL) {
+        return false;
+    }
+
+    for (i = 0; i < tile_count; ++i) {
+        const JsonValue *data = json_get(&tiles->items[i], "data");
+        uint32_t b;
+
+        if (data == NULL || data->type != JSON_ARRAY || data->count != VIRTUAPPU_ASSET_PACK_TILE_BYTES) {
+            fprintf(stderr, "%s: tile %u is not %d bytes\n", record->name, i, VIRTUAPPU_ASSET_PACK_TILE_BYTES);
+            return false;
+        }
+        for (b = 0; b < VIRTUAPPU_ASSET_PACK_TILE_BYTES; ++b) {
+            uint8_t byte = (uint8_t)data->items[b].number;
+            size_t x = (size_t)(i % record->blocks_w) * 8u + (b % 4u) * 2u;
+            size_t y = (size_t)(i / record->blocks_w) * 8u + b / 4u;
+
+            sprite->pixels[y * width + x] = byte & 0x0Fu;
+            sprite->pixels[y * width + x + 1u] = byte >> 4u;
+        }
+    }
+
+    return true;
+}
+
+static int pack_find_color(const PackBuilder *builder, uint32_t palette, const Mode0Rgb888 *color)
+{
+    uint32_t slot;
+
+    /* Slot 0 is transparent, so a visible colour never maps onto it. */
+    for (slot = 1; slot < builder->palette_sizes[palette]; ++slot) {
+        const Mode0Rgb888 *entry = &builder->palettes[palette].colors[slot];
+
+        if (entry->r == color->r && entry->g == color->g && entry->b == color->b) {
+            return (int)slot;
+        }
+    }
+
+    return -1;
+}
+
+/* Sprites are packed by decreasing colour count, each into the palette that needs the fewest new
+ * slots, so sprites with overlapping colour sets share one 16-colour palette. */
+static bool pack_palettes(PackBuilder *builder)
+{
+    uint32_t *order;
+    uint32_t *color_counts;
+    uint32_t i;
+
+    if (!builder->pack_palettes) {
+        memcpy(builder->palettes, builder->source_palettes, sizeof(builder->palettes));
+        builder->palette_count = builder->source_palette_count;
+        for (i = 0; i < builder->sprite_count; ++i) {
+            builder->sprites[i].record.palette_index = (uint8_t)builder->sprites[i].source_palette;
+        }
+        return true;
+    }
+
+    order = (uint32_t *)malloc(((size_t)builder->sprite_count * 2u + 1u) * sizeof(*order));
+    if (order == NULL) {
+        return false;
+    }
+    color_counts = order + builder->sprite_count;
+
+    for (i = 0; i < builder->sprite_count; ++i) {
+        const PackSprite *sprite = &builder->sprites[i];
+        size_t pixel_count = (size_t)sprite->record.blocks_w * sprite->record.blocks_h * 64u;
+        bool used[16] = {false};
+        size_t p;
+        uint32_t j;
+
+        for (p = 0; p < pixel_count; ++p) {
+            used[sprite->pixels[p]] = true;
+        }
+        color_counts[i] = 0u;
+        for (j = 1; j < 16u; ++j) {
+            color_counts[i] += used[j] ? 1u : 0u;
+        }
+
+        for (j = i; j > 0u && color_counts[order[j - 1u]] < color_counts[i]; --j) {
+            order[j] = order[j - 1u];
+        }
+        order[j] = i;
+    }
+
+    for (i = 0; i < builder->sprite_count; ++i) {
+        PackSprite *sprite = &builder->sprites[order[i]];
+        const Mode0Palette16Rgb888 *source = &builder->source_palettes[sprite->source_palette];
+        size_t pixel_count = (size_t)sprite->record.blocks_w * sprite->record.blocks_h * 64u;
+        uint8_t remap[16];
+        bool used[16] = {false};
+        uint32_t best = builder->palette_count;
+        uint32_t best_new = 16u;
+        uint32_t palette;
+        size_t p;
+        uint32_t c;
+
+        for (p = 0; p < pixel_count; ++p) {
+            used[sprite->pixels[p]] = true;
+        }
+
+        for (palette = 0; palette < builder->palette_count; ++palette) {
+            uint32_t fresh = 0u;
+
+            for (c = 1; c < 16u; ++c) {
+                if (used[c] && pack_find_color(builder, palette, &source->colors[c]) < 0) {
+                    ++fresh;
+                }
+            }
+            if (builder->palette_sizes[palette] + fresh <= 16u && fresh < best_new) {
+                best = palette;
+                best_new = fresh;
+            }
+        }
+
+        if (best == builder->palette_count) {
+            if (builder->palette_count == PACK_MAX_PALETTES) {
+                fprintf(stderr, "%s: packed palettes exceed %d\n", sprite->record.name, PACK_MAX_PALETTES);
+                free(order);
+                return false;
+            }
+            memset(&builder->palettes[best], 0, sizeof(builder->palettes[best]));
+            builder->palettes[best].colors[0] = source->colors[0];
+            builder->palette_sizes[best] = 1u;
+            ++builder->palette_count;
+        }
+
+        remap[0] = 0u;
+        for (c = 1; c < 16u; ++c) {
+            int slot;
+
+            if (!used[c]) {
+                remap[c] = 0u;
+                continue;
+            }
+            slot = pack_find_color(builder, best, &source->colors[c]);
+            if (slot < 0) {
+                slot = builder->palette_sizes[best]++;
+                builder->palettes[best].colors[slot] = source->colors[c];
+            }
+            remap[c] = (uint8_t)slot;
+        }
+
+        for (p = 0; p < pixel_count; ++p) {
+            sprite->pixels[p] = remap[sprite->pixels[p]];
+        }
+        sprite->record.palette_index = (uint8_t)best;
+    }
+
+    free(order);
+    return true;
+}
+
+static void pack_flip_tile(uint8_t *dst, const uint8_t *src, uint32_t flips)
+{
+    uint32_t y;
+    uint32_t b;
+
+    for (y = 0; y < 8u; ++y) {
+        const uint8_t *row = src + ((flips & 2u) ? 7u - y : y) * 4u;
+
+        for (b = 0; b < 4u; ++b) {
+            dst[y * 4u + b] = (flips & 1u) ? (uint8_t)((row[3u - b] >> 4u) | (row[3u - b] << 4u)) : row[b];
+        }
+    }
+}
+
+static uint32_t pack_hash_tile(const uint8_t *tile)
+{
+    uint32_t hash = 2166136261u;
+    uint32_t b;
+
+    for (b = 0; b < VIRTUAPPU_ASSET_PACK_TILE_BYTES; ++b) {
+        hash = (hash ^ tile[b]) * 16777619u;
+    }
+
+    return hash & (PACK_HASH_SLOTS - 1u);
+}
+
+/* Slots hold (tile << 2) | flips: the stored tile drawn with those flips equals the hashed bytes. */
+static uint32_t *pack_find_tile(PackBuilder *builder, const uint8_t *tile)
+{
+    uint32_t slot = pack_hash_tile(tile);
+
+    while (builder->tile_hash[slot] != UINT32_MAX) {
+        uint8_t variant[VIRTUAPPU_ASSET_PACK_TILE_BYTES];
+        uint32_t key = builder->tile_hash[slot];
+
+        pack_flip_tile(variant, builder->gfx + (size_t)(key >> 2u) * VIRTUAPPU_ASSET_PACK_TILE_BYTES, key & 3u);
+        if (memcmp(variant, tile, sizeof(variant)) == 0) {
+            break;
+        }
+        slot = (slot + 1u) & (PACK_HASH_SLOTS - 1u);
+    }
+
+    return &builder->tile_hash[slot];
+}
+
+static void pack_emit_tile(PackBuilder *builder, const uint8_t *tile, uint16_t palette_index, bool share)
+{
+    uint32_t index = builder->tile_count;
+    uint32_t flips = 0u;
+
+    ++builder->source_tiles;
+    if (share) {
+        uint32_t *slot = pack_find_tile(builder, tile);
+
+        if (*slot != UINT32_MAX) {
+            index = *slot >> 2u;
+            flips = *slot & 3u;
+            builder->flipped_tiles += (flips != 0u) ? 1u : 0u;
+        }
+    }
+
+    if (index == builder->tile_count) {
+        memcpy(builder->gfx + (size_t)index * VIRTUAPPU_ASSET_PACK_TILE_BYTES, tile, VIRTUAPPU_ASSET_PACK_TILE_BYTES);
+        ++builder->tile_count;
+        if (builder->dedupe) {
+            uint32_t variant_flips;
+
+            /* The unflipped tile is registered first, so symmetric tiles resolve without flip bits. */
+            for (variant_flips = 0; variant_flips < 4u; ++variant_flips) {
+                uint8_t variant[VIRTUAPPU_ASSET_PACK_TILE_BYTES];
+                uint32_t *slot;
+
+                pack_flip_tile(variant, tile, variant_flips);
+                slot = pack_find_tile(builder, variant);
+                if (*slot == UINT32_MAX) {
+                    *slot = (index << 2u) | variant_flips;
+                }
+            }
+        }
+    }
+
+    builder->entries[builder->entry_count++] =
+        mode0_make_tile_entry((uint16_t)index, (uint8_t)palette_index, 0u, (flips & 1u) != 0u, (flips & 2u) != 0u, false);
+}
+
+/* Returns the first tile of an earlier contiguous sprite holding exactly these tiles, or UINT32_MAX. */
+static uint32_t pack_find_sprite_tiles(const PackBuilder *builder, uint32_t sprite_index, const uint8_t *tiles)
+{
+    const PackSprite *sprite = &builder->sprites[sprite_index];
+    size_t tile_bytes = (size_t)sprite->record.blocks_w * sprite->record.blocks_h * VIRTUAPPU_ASSET_PACK_TILE_BYTES;
+    uint32_t s;
+
+    for (s = 0; s < sprite_index; ++s) {
+        const PackSprite *other = &builder->sprites[s];
+        uint32_t first_tile;
+
+        if ((other->record.flags & VIRTUAPPU_ASSET_SPRITE_CONTIGUOUS) == 0u || other->tiles_hash != sprite->tiles_hash ||
+            other->record.blocks_w != sprite->record.blocks_w || other->record.blocks_h != sprite->record.blocks_h ||
+            other->record.entry_count == 0u) {
+            continue;
+        }
+
+        first_tile = builder->entries[other->record.first_entry] & 0xFFFFu;
+        if (memcmp(builder->gfx + (size_t)first_tile * VIRTUAPPU_ASSET_PACK_TILE_BYTES, tiles, tile_bytes) == 0) {
+            return first_tile;
+        }
+    }
+
+    return UINT32_MAX;
+}
+
+static bool pack_sprite_is_contiguous(const PackBuilder *builder, const VirtuaPPUAssetSprite *record)
+{
+    uint32_t first_tile = (record->entry_count != 0u) ? (builder->entries[record->first_entry] & 0xFFFFu) : 0u;
+    uint32_t i;
+
+    for (i = 0; i < record->entry_count; ++i) {
+        Mode0TileEntry entry = builder->entries[record->first_entry + i];
+
+        if ((entry & 0xFFFFu) != first_tile + i || (entry & (MODE0_TILE_HFLIP | MODE0_TILE_VFLIP)) != 0u) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/* OBJ sprites keep consecutive unflipped tiles because OAM addresses a tile run from one index with
+ * no per-tile flips; they only share tiles with a whole identical sprite. BG sprites share single
+ * tiles, flipped or not, with anything packed before them. */
+static bool pack_emit_tiles(PackBuilder *builder)
+{
+    uint8_t *tiles = NULL;
+    uint32_t s;
+
+    if (builder->dedupe) {
+        builder->tile_hash = (uint32_t *)malloc((size_t)PACK_HASH_SLOTS * sizeof(uint32_t));
+        if (builder->tile_hash == NULL) {
+            return false;
+        }
+        memset(builder->tile_hash, 0xFF, (size_t)PACK_HASH_SLOTS * sizeof(uint32_t));
+    }
+
+    for (s = 0; s < builder->sprite_count; ++s) {
+        PackSprite *sprite = &builder->sprites[s];
+        VirtuaPPUAssetSprite *record = &sprite->record;
+        uint32_t width = (uint32_t)record->blocks_w * 8u;
+        uint32_t tile_count = (uint32_t)record->blocks_w * record->blocks_h;
+        uint32_t shared_tile = UINT32_MAX;
+        uint8_t *grown;
+        uint32_t t;
+        uint32_t b;
+
+        if (!pack_reserve(builder, tile_count)) {
+            fprintf(stderr, "%s: out of tile space (at most %d tiles)\n", record->name, PACK_MAX_TILES);
+            free(tiles);
+            return false;
+        }
+
+        grown = (uint8_t *)realloc(tiles, (size_t)tile_count * VIRTUAPPU_ASSET_PACK_TILE_BYTES + 1u);
+        if (grown == NULL) {
+            free(tiles);
+            return false;
+        }
+        tiles = grown;
+
+        /* Two pixels per byte, left pixel in the low nibble, as decode_4bpp expects. */
+        for (t = 0; t < tile_count; ++t) {
+            uint8_t *tile = tiles + (size_t)t * VIRTUAPPU_ASSET_PACK_TILE_BYTES;
+            uint32_t y;
+
+            for (y = 0; y < 8u; ++y) {
+                const uint8_t *row = sprite->pixels + (size_t)((t / record->blocks_w) * 8u + y) * width + (t % record->blocks_w) * 8u;
+                uint32_t x;
+
+                for (x = 0; x < 8u; x += 2u) {
+                    tile[y * 4u + x / 2u] = (uint8_t)(row[x] | (row[x + 1u] << 4u));
+                }
+            }
+        }
+
+        sprite->tiles_hash = 2166136261u;
+        for (b = 0; b < tile_count * VIRTUAPPU_ASSET_PACK_TILE_BYTES; ++b) {
+            sprite->tiles_hash = (sprite->tiles_hash ^ tiles[b]) * 16777619u;
+        }
+
+        record->first_entry = builder->entry_count;
+        if (builder->dedupe && !sprite->bg) {
+            shared_tile = pack_find_sprite_tiles(builder, s, tiles);
+        }
+
+        if (shared_tile != UINT32_MAX) {
+            for (t = 0; t < tile_count; ++t) {
+                builder->entries[builder->entry_count++] =
+                    mode0_make_tile_entry((uint16_t)(shared_tile + t), record->palette_index, 0u, false, false, false);
+            }
+            builder->source_tiles += tile_count;
+            ++builder->shared_sprites;
+        } else {
+            for (t = 0; t < tile_count; ++t) {
+                pack_emit_tile(builder, tiles + (size_t)t * VIRTUAPPU_ASSET_PACK_TILE_BYTES, record->palette_index, builder->dedupe && sprite->bg);
+            }
+        }
+
+        record->entry_count = builder->entry_count - record->first_entry;
+        if (pack_sprite_is_contiguous(builder, record)) {
+            record->flags |= VIRTUAPPU_ASSET_SPRITE_CONTIGUOUS;
+        }
+    }
+
+    free(tiles);
+    return true;
+}
+
+static uint32_t pack_align(uint32_t value, uint32_t alignment)
+{
+    return (value + alignment - 1u) / alignment * alignment;
+}
+
+static bool pack_write(const PackBuilder *builder, const char *path, uint32_t *file_bytes)
+{
+    VirtuaPPUAssetPackHeader header;
+    uint8_t *image;
+    FILE *file;
+    uint32_t s;
+    bool ok;
+
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, virtuappu_asset_pack_magic, sizeof(header.magic));
+    header.version = VIRTUAPPU_ASSET_PACK_VERSION;
+    header.header_bytes = sizeof(header);
+    header.tile_bytes = VIRTUAPPU_ASSET_PACK_TILE_BYTES;
+    header.palette_offset = pack_align(sizeof(header), VIRTUAPPU_ASSET_PACK_SECTION_ALIGN);
+    header.palette_count = builder->palette_count;
+    header.sprite_offset = pack_align(header.palette_offset + builder->palette_count * (uint32_t)sizeof(Mode0Palette16Rgb888), VIRTUAPPU_ASSET_PACK_SECTION_ALIGN);
+    header.sprite_count = builder->sprite_count;
+    header.entry_offset = pack_align(header.sprite_offset + builder->sprite_count * (uint32_t)sizeof(VirtuaPPUAssetSprite), VIRTUAPPU_ASSET_PACK_SECTION_ALIGN);
+    header.entry_count = builder->entry_count;
+    header.gfx_offset = pack_align(header.entry_offset + builder->entry_count * (uint32_t)sizeof(Mode0TileEntry), VIRTUAPPU_ASSET_PACK_GFX_ALIGN);
+    header.gfx_bytes = builder->tile_count * VIRTUAPPU_ASSET_PACK_TILE_BYTES;
+    header.file_bytes = header.gfx_offset + header.gfx_bytes;
+
+    image = (uint8_t *)calloc(header.file_bytes, 1u);
+    if (image == NULL) {
+        return false;
+    }
+
+    memcpy(image, &header, sizeof(header));
+    memcpy(image + header.palette_offset, builder->palettes, builder->palette_count * sizeof(Mode0Palette16Rgb888));
+    for (s = 0; s < builder->sprite_count; ++s) {
+        memcpy(image + header.sprite_offset + s * sizeof(VirtuaPPUAssetSprite), &builder->sprites[s].record, sizeof(VirtuaPPUAssetSprite));
+    }
+    if (builder->entry_count != 0u) {
+        memcpy(image + header.entry_offset, builder->entries, builder->entry_count * sizeof(Mode0TileEntry));
+        memcpy(image + header.gfx_offset, builder->gfx, header.gfx_bytes);
+    }
+
+    file = fopen(path, "wb");
+    ok = file != NULL && fwrite(image, 1u, header.file_bytes, file) == header.file_bytes;
+    if (file != NULL && fclose(file) != 0) {
+        ok = false;
+    }
+
+    free(image);
+    *file_bytes = header.file_bytes;
+    return ok;
+}
+
+int main(int argc, char **argv)
+{
+    const char *json_path = NULL;
+    const char *out_path = NULL;
+    const char *sprite_dir = NULL;
+    char default_sprite_dir[1024];
+    PackBuilder builder;
+    JsonParser parser;
+    JsonValue root;
+    const JsonValue *sprites;
+    size_t size = 0u;
+    char *text;
+    uint32_t file_bytes = 0u;
+    int result = 1;
+    uint32_t s;
+    int i;
+
+    memset(&builder, 0, sizeof(builder));
+    builder.dedupe = true;
+    builder.pack_palettes = true;
+    for (i = 1; i < argc; ++i) {
+        if (strncmp(argv[i], "--sprites=", 10) == 0) {
+            sprite_dir = argv[i] + 10;
+        } else if (strcmp(argv[i], "--no-dedupe") == 0) {
+            builder.dedupe = false;
+        } else if (strcmp(argv[i], "--no-palette-pack") == 0) {
+            builder.pack_palettes = false;
+        } else if (json_path == NULL && argv[i][0] != '-') {
+            json_path = argv[i];
+        } else if (out_path == NULL && argv[i][0] != '-') {
+            out_path = argv[i];
+        } else {
+            json_path = NULL;
+            break;
+        }
+    }
+
+    if (json_path == NULL || out_path == NULL) {
+        fprintf(stderr, "usage: %s <assets.json> <out.vpak> [--sprites=DIR] [--no-dedupe] [--no-palette-pack]\n", argv[0]);
+        return 1;
+    }
+
+    if (sprite_dir == NULL) {
+        const char *slash = strrchr(json_path, '/');
+        int dir_length = (slash != NULL) ? (int)(slash - json_path) : 1;
+
+        snprintf(default_sprite_dir, sizeof(default_sprite_dir), "%.*s/sprites", dir_length, (slash != NULL) ? json_path : ".");
+        sprite_dir = default_sprite_dir;
+    }
+
+    text = pack_read_file(json_path, &size);
+    if (text == NULL) {
+        fprintf(stderr, "%s: cannot read '%s'\n", argv[0], json_path);
+        return 1;
+    }
+
+    memset(&root, 0, sizeof(root));
+    parser.text = text;
+    parser.cursor = 0u;
+    parser.size = size;
+    if (!json_parse_value(&parser, &root, 0) || root.type != JSON_OBJECT) {
+        fprintf(stderr, "%s: '%s' is not a JSON object (near byte %zu)\n", argv[0], json_path, parser.cursor);
+        json_free(&root);
+        free(text);
+        return 1;
+    }
+
+    sprites = json_get(&root, "sprites");
+    builder.sprites = (PackSprite *)calloc((sprites != NULL && sprites->type == JSON_ARRAY && sprites->count != 0u) ? sprites->count : 1u,
+                                           sizeof(*builder.sprites));
+
+    if (builder.sprites != NULL && pack_add_palettes(&builder, json_get(&root, "palettes_16"))) {
+        size_t index;
+
+        result = 0;
+        for (index = 0; sprites != NULL && sprites->type == JSON_ARRAY && index < sprites->count && result == 0; ++index) {
+            if (!pack_add_sprite(&builder, &sprites->items[index], sprite_dir)) {
+                free(builder.sprites[builder.sprite_count].pixels);
+                result = 1;
+            } else {
+                ++builder.sprite_count;
+            }
+        }
+    }
+
+    /* Palettes are packed first: remapping colour indices can turn distinct tiles into duplicates. */
+    if (result == 0 && (!pack_palettes(&builder) || !pack_emit_tiles(&builder))) {
+        result = 1;
+    }
+    if (result == 0 && !pack_write(&builder, out_path, &file_bytes)) {
+        fprintf(stderr, "%s: cannot write '%s'\n", argv[0], out_path);
+        result = 1;
+    }
+
+    if (result == 0) {
+        long saved = ((long)builder.source_tiles - (long)builder.tile_count) * VIRTUAPPU_ASSET_PACK_TILE_BYTES +
+                     ((long)builder.source_palette_count - (long)builder.palette_count) * (long)sizeof(Mode0Palette16Rgb888);
+
+        printf("{\"sprites\":%u,\"sprites_from_bmp\":%u,\"source_palettes\":%u,\"palettes\":%u,\"source_tiles\":%u,"
+               "\"tiles\":%u,\"flipped_tiles\":%u,\"shared_sprites\":%u,\"gfx_bytes\":%u,\"vram_bytes_saved\":%ld,\"file_bytes\":%u}\n",
+               builder.sprite_count, builder.bmp_sprites, builder.source_palette_count, builder.palette_count, builder.source_tiles,
+               builder.tile_count, builder.flipped_tiles, builder.shared_sprites, builder.tile_count * VIRTUAPPU_ASSET_PACK_TILE_BYTES, saved, file_bytes);
+    }
+
+    for (s = 0; s < builder.sprite_count; ++s) {
+        free(builder.sprites[s].pixels);
+    }
+    free(builder.sprites);
+    free(builder.tile_hash);
+    free(builder.entries);
+    free(builder.gfx);
+    json_free(&root);
+    free(text);
+    return result;
+}
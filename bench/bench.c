@@ -0,0 +1,465 @@
+#if !defined(_WIN32) && !defined(_POSIX_C_SOURCE)
+#define _POSIX_C_SOURCE 199309L
+#endif
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+#include "modes_impl.h"
+#include "thread_pool.h"
+#include "virtuappu.h"
+
+enum {
+    BENCH_DEFAULT_FRAMES = 240,
+    BENCH_MAX_THREAD_COUNTS = 16,
+    BENCH_BATCH_INSTANCES_PER_THREAD = 2
+};
+
+typedef struct BenchScene {
+    const char *name;
+    uint8_t mode;
+    uint16_t width;
+    uint16_t height;
+    void (*setup)(VirtuaPPUContext *ctx);
+    void (*animate)(VirtuaPPUContext *ctx, uint32_t frame);
+} BenchScene;
+
+typedef struct BenchResult {
+    double ns_per_frame;
+    double batch_ns_per_frame;
+    uint32_t batch_instances;
+} BenchResult;
+
+static uint32_t bench_rng_state;
+
+static void bench_seed(uint32_t seed)
+{
+    bench_rng_state = seed != 0u ? seed : 0x9E3779B9u;
+}
+
+static uint32_t bench_rand(void)
+{
+    bench_rng_state ^= bench_rng_state << 13u;
+    bench_rng_state ^= bench_rng_state >> 17u;
+    bench_rng_state ^= bench_rng_state << 5u;
+    return bench_rng_state;
+}
+
+static uint64_t bench_now_ns(void)
+{
+#if defined(_WIN32)
+    LARGE_INTEGER counter;
+    LARGE_INTEGER frequency;
+
+    QueryPerformanceCounter(&counter);
+    QueryPerformanceFrequency(&frequency);
+    return (uint64_t)((double)counter.QuadPart * 1e9 / (double)frequency.QuadPart);
+#else
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+#endif
+}
+
+static void bench_io_write16(VirtuaPPUContext *ctx, uint16_t offset, uint16_t value)
+{
+    ctx->mode1_memory.io_mem[offset] = (uint8_t)(value & 0xFFu);
+    ctx->mode1_memory.io_mem[offset + 1u] = (uint8_t)(value >> 8u);
+}
+
+static void bench_io_write32(VirtuaPPUContext *ctx, uint16_t offset, uint32_t value)
+{
+    bench_io_write16(ctx, offset, (uint16_t)(value & 0xFFFFu));
+    bench_io_write16(ctx, (uint16_t)(offset + 2u), (uint16_t)(value >> 16u));
+}
+
+static void bench_setup_mode0(VirtuaPPUContext *ctx)
+{
+    static uint8_t gfx[64u * 1024u];
+    Mode0PPURegs regs;
+    size_t i;
+
+    memset(&regs, 0, sizeof(regs));
+    regs.master_enable_mask = MODE0_LAYER_BG0 | MODE0_LAYER_BG1 | MODE0_LAYER_BG2 | MODE0_LAYER_BG3 | MODE0_LAYER_OBJ;
+    regs.outside_enable_mask = regs.master_enable_mask;
+    virtuappu_mode0_set_ppu_regs_ctx(ctx, &regs);
+
+    for (i = 0; i < sizeof(gfx); ++i) {
+        gfx[i] = (uint8_t)bench_rand();
+    }
+    virtuappu_mode0_set_gfx_data_ctx(ctx, gfx, sizeof(gfx), 0u);
+
+    for (i = 0; i < MODE0_BG_COUNT; ++i) {
+        Mode0BgEntry bg;
+        size_t entry;
+
+        memset(&bg, 0, sizeof(bg));
+        bg.flags = MODE0_BG_FLAG_ENABLED | MODE0_BG_FLAG_WRAP_X | MODE0_BG_FLAG_WRAP_Y;
+        bg.layer_priority = (uint8_t)i;
+        bg.palette_index = (uint16_t)i;
+        virtuappu_mode0_set_bg_entry_ctx(ctx, i, &bg);
+
+        for (entry = 0; entry < MODE0_TILEMAP_ENTRIES_PER_BG; ++entry) {
+            Mode0TileEntry tile = mode0_make_tile_entry(
+                (uint16_t)(bench_rand() % 2048u),
+                (uint8_t)(bench_rand() % 16u),
+                (uint8_t)i,
+                (bench_rand() & 1u) != 0u,
+                (bench_rand() & 1u) != 0u,
+                false);
+            virtuappu_mode0_set_tilemap_entry_ctx(ctx, i, entry, tile);
+        }
+    }
+
+    for (i = 0; i < MODE0_OAM_COUNT; ++i) {
+        Mode0OAMEntry oam;
+
+        memset(&oam, 0, sizeof(oam));
+        oam.x = (int16_t)(bench_rand() % 1280u);
+        oam.y = (int16_t)(bench_rand() % 360u);
+        oam.width_blocks = (uint8_t)(1u + bench_rand() % 4u);
+        oam.height_blocks = (uint8_t)(1u + bench_rand() % 4u);
+        oam.tile_index = (uint16_t)(bench_rand() % 2048u);
+        oam.palette_index = (uint16_t)(bench_rand() % 16u);
+        oam.priority = (uint8_t)(bench_rand() % 4u);
+        oam.flags = MODE0_OAM_FLAG_ENABLED;
+        virtuappu_mode0_set_oam_entry_ctx(ctx, i, &oam);
+    }
+
+    ctx->registers->frame_width = 1280u;
+}
+
+static void bench_animate_mode0(VirtuaPPUContext *ctx, uint32_t frame)
+{
+    size_t i;
+
+    for (i = 0; i < MODE0_BG_COUNT; ++i) {
+        Mode0LineScroll scroll;
+
+        scroll.scroll_x = (int16_t)(frame * (i + 1u));
+        scroll.scroll_y = (int16_t)frame;
+        virtuappu_mode0_set_bg_line_scroll_ctx(ctx, i, frame % MODE0_MAX_LINES, &scroll);
+    }
+}
+
+static void bench_fill_mode1_memory(VirtuaPPUContext *ctx)
+{
+    VirtuaPPUMode1GbaMemory *memory = &ctx->mode1_memory;
+    size_t i;
+
+    for (i = 0; i < MODE1_VRAM_SIZE; ++i) {
+        memory->vram[i] = (uint8_t)bench_rand();
+    }
+    for (i = 0; i < MODE1_PALETTE_COLORS; ++i) {
+        memory->bg_palette[i] = (uint16_t)(bench_rand() & 0x7FFFu);
+        memory->obj_palette[i] = (uint16_t)(bench_rand() & 0x7FFFu);
+    }
+    for (i = 0; i < MODE1_GBA_OAM_COUNT; ++i) {
+        uint16_t y = (uint16_t)(bench_rand() % MODE1_GBA_HEIGHT);
+        uint16_t x = (uint16_t)(bench_rand() % MODE1_GBA_WIDTH);
+        uint16_t shape = (uint16_t)(bench_rand() % 3u);
+        uint16_t size = (uint16_t)(bench_rand() % 4u);
+        uint16_t tile = (uint16_t)(bench_rand() % 1024u);
+        uint16_t priority = (uint16_t)(bench_rand() % 4u);
+        uint16_t palette = (uint16_t)(bench_rand() % 16u);
+
+        memory->oam_mem[i * 4u] = (uint16_t)(y | (shape << 14u));
+        memory->oam_mem[i * 4u + 1u] = (uint16_t)(x | (size << 14u));
+        memory->oam_mem[i * 4u + 2u] = (uint16_t)(tile | (priority << 10u) | (palette << 12u));
+    }
+}
+
+static void bench_setup_windows_and_blend(VirtuaPPUContext *ctx)
+{
+    bench_io_write16(ctx, MODE1_IO_WIN0H, (uint16_t)((40u << 8u) | 200u));
+    bench_io_write16(ctx, MODE1_IO_WIN0V, (uint16_t)((20u << 8u) | 140u));
+    bench_io_write16(ctx, MODE1_IO_WININ, 0x003Fu);
+    bench_io_write16(ctx, MODE1_IO_WINOUT, 0x001Fu);
+    bench_io_write16(ctx, MODE1_IO_BLDCNT, (uint16_t)(0x0011u | (1u << 6u) | 0x0E00u));
+    bench_io_write16(ctx, MODE1_IO_BLDALPHA, (uint16_t)(10u | (6u << 8u)));
+}
+
+static void bench_setup_mode1(VirtuaPPUContext *ctx)
+{
+    int i;
+
+    ctx->registers->mode = 1u;
+    virtuappu_mode1_bind_gba_memory_ctx(ctx, NULL);
+    bench_fill_mode1_memory(ctx);
+
+    bench_io_write16(ctx, MODE1_IO_DISPCNT, (uint16_t)(MODE1_DISP_OBJ_1D | MODE1_DISP_BG0_ON | MODE1_DISP_BG1_ON |
+                                                       MODE1_DISP_BG2_ON | MODE1_DISP_BG3_ON | MODE1_DISP_OBJ_ON |
+                                                       MODE1_DISP_WIN0_ON));
+    for (i = 0; i < MODE1_GBA_BG_COUNT; ++i) {
+        uint16_t bgcnt = (uint16_t)(i | ((24 + i * 2) << 8));
+        bench_io_write16(ctx, (uint16_t)(MODE1_IO_BG0CNT + i * 2), bgcnt);
+    }
+    bench_setup_windows_and_blend(ctx);
+}
+
+static void bench_animate_mode1(VirtuaPPUContext *ctx, uint32_t frame)
+{
+    int i;
+
+    for (i = 0; i < MODE1_GBA_BG_COUNT; ++i) {
+        bench_io_write16(ctx, (uint16_t)(MODE1_IO_BG0HOFS + i * 4), (uint16_t)(frame * (uint32_t)(i + 1)));
+        bench_io_write16(ctx, (uint16_t)(MODE1_IO_BG0VOFS + i * 4), (uint16_t)(frame / 2u));
+    }
+}
+
+static void bench_setup_mode2(VirtuaPPUContext *ctx)
+{
+    ctx->registers->mode = 2u;
+    virtuappu_mode1_bind_gba_memory_ctx(ctx, NULL);
+    bench_fill_mode1_memory(ctx);
+
+    bench_io_write16(ctx, MODE1_IO_DISPCNT, (uint16_t)(MODE1_DISP_OBJ_1D | MODE1_DISP_BG0_ON | MODE1_DISP_BG1_ON |
+                                                       MODE1_DISP_BG2_ON | MODE1_DISP_OBJ_ON));
+    bench_io_write16(ctx, MODE1_IO_BG0CNT, (uint16_t)(1u | (24u << 8u)));
+    bench_io_write16(ctx, MODE1_IO_BG1CNT, (uint16_t)(2u | (26u << 8u)));
+    bench_io_write16(ctx, MODE1_IO_BG2CNT, (uint16_t)((16u << 8u) | (1u << 13u) | (1u << 14u)));
+    bench_setup_windows_and_blend(ctx);
+}
+
+static void bench_animate_mode2(VirtuaPPUContext *ctx, uint32_t frame)
+{
+    double angle = (double)frame * 0.02;
+    int16_t cos_fixed = (int16_t)lround(cos(angle) * 256.0);
+    int16_t sin_fixed = (int16_t)lround(sin(angle) * 256.0);
+    int32_t center = 128 << 8;
+    int32_t ref_x = center - (cos_fixed * 120 - sin_fixed * 80);
+    int32_t ref_y = center - (sin_fixed * 120 + cos_fixed * 80);
+
+    bench_io_write16(ctx, 0x20u, (uint16_t)cos_fixed);
+    bench_io_write16(ctx, 0x22u, (uint16_t)(int16_t)-sin_fixed);
+    bench_io_write16(ctx, 0x24u, (uint16_t)sin_fixed);
+    bench_io_write16(ctx, 0x26u, (uint16_t)cos_fixed);
+    bench_io_write32(ctx, 0x28u, (uint32_t)ref_x & 0x0FFFFFFFu);
+    bench_io_write32(ctx, 0x2Cu, (uint32_t)ref_y & 0x0FFFFFFFu);
+}
+
+static void bench_setup_mode7(VirtuaPPUContext *ctx)
+{
+    Mode7Layout *layout = (Mode7Layout *)ctx->vram;
+    size_t i;
+
+    ctx->registers->mode = 7u;
+    for (i = 0; i < MODE7_VRAM_SIZE_BYTES; ++i) {
+        layout->vram[i] = (uint8_t)bench_rand();
+    }
+    for (i = 0; i < 40u; ++i) {
+        layout->oam[i * 4u] = (uint8_t)(16u + bench_rand() % MODE7_GB_SCREEN_HEIGHT);
+        layout->oam[i * 4u + 1u] = (uint8_t)(8u + bench_rand() % MODE7_GB_SCREEN_WIDTH);
+        layout->oam[i * 4u + 2u] = (uint8_t)bench_rand();
+        layout->oam[i * 4u + 3u] = (uint8_t)(bench_rand() & 0xF0u);
+    }
+
+    layout->regs.lcdc = MODE7_LCDC_ENABLE | MODE7_LCDC_WINDOW_TILE_MAP | MODE7_LCDC_WINDOW_ENABLE |
+                        MODE7_LCDC_BG_WINDOW_TILE_DATA | MODE7_LCDC_OBJ_SIZE | MODE7_LCDC_OBJ_ENABLE |
+                        MODE7_LCDC_BG_ENABLE;
+    layout->regs.bgp = 0xE4u;
+    layout->regs.obp0 = 0xD2u;
+    layout->regs.obp1 = 0x1Bu;
+    layout->regs.wy = 40u;
+    layout->regs.wx = 87u;
+}
+
+static void bench_animate_mode7(VirtuaPPUContext *ctx, uint32_t frame)
+{
+    Mode7Layout *layout = (Mode7Layout *)ctx->vram;
+
+    layout->regs.scx = (uint8_t)frame;
+    layout->regs.scy = (uint8_t)(frame / 2u);
+}
+
+static const BenchScene bench_scenes[] = {
+    {"mode0_4bg_512obj", 0u, 1280u, MODE0_MAX_LINES, bench_setup_mode0, bench_animate_mode0},
+    {"mode1_text_128obj_win_alpha", 1u, MODE1_GBA_WIDTH, MODE1_GBA_HEIGHT, bench_setup_mode1, bench_animate_mode1},
+    {"mode2_rotating_bg2", 2u, MODE1_GBA_WIDTH, MODE1_GBA_HEIGHT, bench_setup_mode2, bench_animate_mode2},
+    {"mode7_busy_dmg", 7u, MODE7_GB_SCREEN_WIDTH, MODE7_GB_SCREEN_HEIGHT, bench_setup_mode7, bench_animate_mode7}
+};
+
+static VirtuaPPUContext *bench_create_scene(const BenchScene *scene)
+{
+    VirtuaPPUContext *ctx = virtuappu_context_create();
+
+    if (ctx == NULL) {
+        return NULL;
+    }
+
+    bench_seed(0xC0FFEEu + scene->mode);
+    ctx->registers->mode = scene->mode;
+    scene->setup(ctx);
+    return ctx;
+}
+
+static BenchResult bench_run(const BenchScene *scene, uint32_t thread_count, uint32_t frames)
+{
+    BenchResult result;
+    VirtuaPPUContext *instances[VIRTUAPPU_THREAD_POOL_MAX_THREADS * BENCH_BATCH_INSTANCES_PER_THREAD];
+    VirtuaPPUContext *ctx;
+    VirtuaPPUThreadConfig config;
+    uint64_t start;
+    uint32_t instance_count = thread_count * BENCH_BATCH_INSTANCES_PER_THREAD;
+    uint32_t frame;
+    uint32_t i;
+
+    memset(&result, 0, sizeof(result));
+    memset(&config, 0, sizeof(config));
+    config.thread_count = thread_count;
+    virtuappu_thread_pool_configure(&config);
+
+    ctx = bench_create_scene(scene);
+    if (ctx == NULL) {
+        return result;
+    }
+
+    scene->animate(ctx, 0u);
+    virtuappu_render_frame_ctx(ctx);
+
+    start = bench_now_ns();
+    for (frame = 0; frame < frames; ++frame) {
+        scene->animate(ctx, frame);
+        virtuappu_render_frame_ctx(ctx);
+    }
+    result.ns_per_frame = (double)(bench_now_ns() - start) / (double)frames;
+
+    for (i = 0; i < instance_count; ++i) {
+        instances[i] = virtuappu_context_create();
+        if (instances[i] == NULL) {
+            break;
+        }
+        virtuappu_context_copy_state(instances[i], ctx);
+    }
+    instance_count = i;
+
+    if (instance_count > 0u) {
+        start = bench_now_ns();
+        for (frame = 0; frame < frames; ++frame) {
+            virtuappu_render_batch(instances, instance_count);
+        }
+        result.batch_ns_per_frame = (double)(bench_now_ns() - start) / ((double)frames * (double)instance_count);
+        result.batch_instances = instance_count;
+    }
+
+    for (i = 0; i < instance_count; ++i) {
+        virtuappu_context_destroy(instances[i]);
+    }
+    virtuappu_context_destroy(ctx);
+
+    return result;
+}
+
+static uint32_t bench_parse_threads(const char *list, uint32_t *counts)
+{
+    uint32_t count = 0u;
+
+    while (*list != '\0' && count < BENCH_MAX_THREAD_COUNTS) {
+        char *end;
+        unsigned long value = strtoul(list, &end, 10);
+
+        if (end == list) {
+            break;
+        }
+        if (value > 0u && value <= VIRTUAPPU_THREAD_POOL_MAX_THREADS) {
+            counts[count++] = (uint32_t)value;
+        }
+        list = (*end == ',') ? end + 1 : end;
+    }
+
+    return count;
+}
+
+static uint32_t bench_default_threads(uint32_t *counts)
+{
+    uint32_t hardware;
+    uint32_t count = 0u;
+    uint32_t threads;
+
+    virtuappu_thread_pool_configure(NULL);
+    hardware = virtuappu_thread_pool_size();
+
+    for (threads = 1u; threads < hardware && count + 1u < BENCH_MAX_THREAD_COUNTS; threads *= 2u) {
+        counts[count++] = threads;
+    }
+    counts[count++] = hardware;
+
+    return count;
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t thread_counts[BENCH_MAX_THREAD_COUNTS];
+    uint32_t thread_count_count = 0u;
+    uint32_t frames = BENCH_DEFAULT_FRAMES;
+    bool first = true;
+    size_t scene_index;
+    int i;
+
+    for (i = 1; i < argc; ++i) {
+        if (strncmp(argv[i], "--frames=", 9) == 0) {
+            frames = (uint32_t)strtoul(argv[i] + 9, NULL, 10);
+        } else if (strncmp(argv[i], "--threads=", 10) == 0) {
+            thread_count_count = bench_parse_threads(argv[i] + 10, thread_counts);
+        } else {
+            fprintf(stderr, "usage: %s [--frames=N] [--threads=1,2,4]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    if (frames == 0u) {
+        frames = BENCH_DEFAULT_FRAMES;
+    }
+    if (thread_count_count == 0u) {
+        thread_count_count = bench_default_threads(thread_counts);
+    }
+
+    printf("{\n  \"format\": 1,\n  \"frames\": %u,\n  \"results\": [", frames);
+    for (scene_index = 0; scene_index < sizeof(bench_scenes) / sizeof(bench_scenes[0]); ++scene_index) {
+        const BenchScene *scene = &bench_scenes[scene_index];
+        double pixels = (double)scene->width * (double)scene->height;
+        double baseline = 0.0;
+        uint32_t t;
+
+        for (t = 0; t < thread_count_count; ++t) {
+            BenchResult result = bench_run(scene, thread_counts[t], frames);
+
+            if (t == 0u) {
+                baseline = result.batch_ns_per_frame;
+            }
+
+            printf("%s\n    {\"scene\": \"%s\", \"mode\": %u, \"width\": %u, \"height\": %u, \"threads\": %u, "
+                   "\"ns_per_frame\": %.1f, \"ns_per_pixel\": %.3f, \"batch_instances\": %u, "
+                   "\"batch_ns_per_frame\": %.1f, \"batch_speedup\": %.2f}",
+                   first ? "" : ",",
+                   scene->name,
+                   (unsigned)scene->mode,
+                   (unsigned)scene->width,
+                   (unsigned)scene->height,
+                   thread_counts[t],
+                   result.ns_per_frame,
+                   result.ns_per_frame / pixels,
+                   result.batch_instances,
+                   result.batch_ns_per_frame,
+                   (result.batch_ns_per_frame > 0.0) ? baseline / result.batch_ns_per_frame : 0.0);
+            first = false;
+
+            fprintf(stderr, "%-28s threads=%-3u %10.0f ns/frame %7.3f ns/px  batch %10.0f ns/frame\n",
+                    scene->name, thread_counts[t], result.ns_per_frame, result.ns_per_frame / pixels,
+                    result.batch_ns_per_frame);
+        }
+    }
+    printf("\n  ]\n}\n");
+
+    virtuappu_thread_pool_shutdown();
+    return 0;
+}
@@ -0,0 +1,473 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "reference.h"
+#include "simd.h"
+#include "thread_pool.h"
+#include "virtuappu.h"
+
+enum {
+    FUZZ_STATE_BYTES = sizeof(Mode1Layout) > sizeof(Mode7Layout) ? sizeof(Mode1Layout) : sizeof(Mode7Layout),
+    FUZZ_DEFAULT_ITERATIONS = 200,
+    FUZZ_MINIMIZE_BUDGET = 4000,
+    FUZZ_DUMP_MAGIC = 0x5A465056
+};
+
+typedef struct FuzzCase {
+    int mode;
+    uint32_t frame_width;
+    size_t size;
+    uint8_t state[FUZZ_STATE_BYTES];
+} FuzzCase;
+
+typedef struct FuzzMismatch {
+    VirtuaPPUSimdLevel level;
+    uint32_t x;
+    uint32_t y;
+    uint32_t expected;
+    uint32_t actual;
+    uint32_t pixels;
+} FuzzMismatch;
+
+typedef struct FuzzRunner {
+    VirtuaPPUContext *ctx;
+    uint32_t *expected;
+    VirtuaPPUSimdLevel max_level;
+    uint32_t renders;
+} FuzzRunner;
+
+static uint64_t fuzz_rng_state;
+
+static uint32_t fuzz_rand(void)
+{
+    fuzz_rng_state ^= fuzz_rng_state << 13u;
+    fuzz_rng_state ^= fuzz_rng_state >> 7u;
+    fuzz_rng_state ^= fuzz_rng_state << 17u;
+    return (uint32_t)(fuzz_rng_state >> 16u);
+}
+
+static uint32_t fuzz_range(uint32_t count)
+{
+    return fuzz_rand() % count;
+}
+
+static void fuzz_write16(uint8_t *mem, uint16_t offset, uint16_t value)
+{
+    mem[offset] = (uint8_t)(value & 0xFFu);
+    mem[offset + 1u] = (uint8_t)(value >> 8u);
+}
+
+static void fuzz_fill_sparse(uint8_t *dst, size_t size, uint32_t density)
+{
+    size_t i;
+
+    for (i = 0; i < size; ++i) {
+        dst[i] = (fuzz_range(16u) < density) ? (uint8_t)fuzz_rand() : 0u;
+    }
+}
+
+/* Random but valid GBA state: display registers in range, affine matrices near identity, OAM shapes 0-2. */
+static void fuzz_generate_mode1(FuzzCase *fuzz_case, int mode)
+{
+    Mode1Layout *layout = (Mode1Layout *)fuzz_case->state;
+    uint16_t dispcnt = (uint16_t)(fuzz_rand() & ~MODE1_DISP_FORCED_BLANK);
+    uint16_t offset;
+    int i;
+
+    fuzz_case->mode = mode;
+    fuzz_case->frame_width = MODE1_GBA_WIDTH;
+    fuzz_case->size = sizeof(Mode1Layout);
+    memset(layout, 0, sizeof(*layout));
+
+    if (fuzz_range(16u) == 0u) {
+        dispcnt |= MODE1_DISP_FORCED_BLANK;
+    }
+    fuzz_write16(layout->io_mem, MODE1_IO_DISPCNT, dispcnt);
+    for (offset = MODE1_IO_BG0CNT; offset < 0x20u; offset += 2u) {
+        fuzz_write16(layout->io_mem, offset, (uint16_t)fuzz_rand());
+    }
+    for (offset = 0x20u; offset < 0x40u; offset += 8u) {
+        fuzz_write16(layout->io_mem, offset, (uint16_t)(int16_t)((int)fuzz_range(1025u) - 512));
+        fuzz_write16(layout->io_mem, (uint16_t)(offset + 2u), (uint16_t)(int16_t)((int)fuzz_range(513u) - 256));
+        fuzz_write16(layout->io_mem, (uint16_t)(offset + 4u), (uint16_t)(int16_t)((int)fuzz_range(513u) - 256));
+        fuzz_write16(layout->io_mem, (uint16_t)(offset + 6u), (uint16_t)(int16_t)((int)fuzz_range(1025u) - 512));
+    }
+    for (offset = 0x28u; offset < 0x30u; offset += 4u) {
+        uint32_t ref = fuzz_rand() & 0x0FFFFFFFu;
+        fuzz_write16(layout->io_mem, offset, (uint16_t)(ref & 0xFFFFu));
+        fuzz_write16(layout->io_mem, (uint16_t)(offset + 2u), (uint16_t)(ref >> 16u));
+    }
+    for (offset = MODE1_IO_WIN0H; offset <= MODE1_IO_BLDY; offset += 2u) {
+        fuzz_write16(layout->io_mem, offset, (uint16_t)fuzz_rand());
+    }
+
+    fuzz_fill_sparse(layout->vram, sizeof(layout->vram), 1u + fuzz_range(16u));
+    for (i = 0; i < MODE1_PALETTE_COLORS; ++i) {
+        layout->bg_palette[i] = (uint16_t)(fuzz_rand() & 0x7FFFu);
+        layout->obj_palette[i] = (uint16_t)(fuzz_rand() & 0x7FFFu);
+    }
+    for (i = 0; i < MODE1_OAM_HALFWORDS; ++i) {
+        layout->oam_mem[i] = (uint16_t)fuzz_rand();
+    }
+    for (i = 0; i < MODE1_GBA_OAM_COUNT; ++i) {
+        if ((layout->oam_mem[i * 4] >> 14u) == 3u) {
+            layout->oam_mem[i * 4] = (uint16_t)((layout->oam_mem[i * 4] & 0x3FFFu) | (fuzz_range(3u) << 14u));
+        }
+        if (fuzz_range(4u) == 0u) {
+            layout->oam_mem[i * 4] = (uint16_t)((layout->oam_mem[i * 4] & ~0x0300u) | 0x0200u);
+        }
+    }
+}
+
+static void fuzz_generate_mode7(FuzzCase *fuzz_case)
+{
+    fuzz_case->mode = 7;
+    fuzz_case->frame_width = MODE7_GB_SCREEN_WIDTH;
+    fuzz_case->size = sizeof(Mode7Layout);
+    fuzz_fill_sparse(fuzz_case->state, sizeof(Mode7Layout), 1u + fuzz_range(16u));
+}
+
+static void fuzz_generate_mode0(FuzzCase *fuzz_case)
+{
+    fuzz_case->mode = 0;
+    fuzz_case->frame_width = 1u + fuzz_range(VIRTUAPPU_MAX_FRAME_WIDTH);
+    fuzz_case->size = sizeof(fuzz_case->state);
+    fuzz_fill_sparse(fuzz_case->state, sizeof(fuzz_case->state), fuzz_range(16u));
+}
+
+static uint32_t fuzz_frame_height(int mode)
+{
+    switch (mode) {
+    case 0:
+        return MODE0_MAX_LINES;
+    case 7:
+        return MODE7_GB_SCREEN_HEIGHT;
+    default:
+        return MODE1_GBA_HEIGHT;
+    }
+}
+
+static void fuzz_render_reference(FuzzRunner *runner, FuzzCase *fuzz_case)
+{
+    switch (fuzz_case->mode) {
+    case 0:
+        fuzz_reference_mode0(fuzz_case->frame_width, runner->expected);
+        break;
+    case 7:
+        fuzz_reference_mode7((const Mode7Layout *)fuzz_case->state, runner->expected);
+        break;
+    default:
+        fuzz_reference_mode1((Mode1Layout *)fuzz_case->state, fuzz_case->mode, runner->expected);
+        break;
+    }
+}
+
+static bool fuzz_compare_level(FuzzRunner *runner, const FuzzCase *fuzz_case, VirtuaPPUSimdLevel level, FuzzMismatch *mismatch)
+{
+    VirtuaPPUContext *ctx = runner->ctx;
+    size_t count = (size_t)fuzz_case->frame_width * fuzz_frame_height(fuzz_case->mode);
+    size_t i;
+    bool failed = false;
+
+    virtuappu_simd_set_level(level);
+    virtuappu_reset_ctx(ctx);
+    memcpy(ctx->vram, fuzz_case->state, fuzz_case->size);
+    ctx->registers->mode = (uint8_t)fuzz_case->mode;
+    ctx->registers->frame_width = (uint16_t)fuzz_case->frame_width;
+    virtuappu_render_frame_ctx(ctx);
+    ++runner->renders;
+
+    for (i = 0; i < count; ++i) {
+        if (ctx->frame_buffer[i] == runner->expected[i]) {
+            continue;
+        }
+        if (!failed) {
+            mismatch->level = level;
+            mismatch->x = (uint32_t)(i % fuzz_case->frame_width);
+            mismatch->y = (uint32_t)(i / fuzz_case->frame_width);
+            mismatch->expected = runner->expected[i];
+            mismatch->actual = ctx->frame_buffer[i];
+            mismatch->pixels = 0u;
+            failed = true;
+        }
+        ++mismatch->pixels;
+    }
+
+    return failed;
+}
+
+static bool fuzz_check(FuzzRunner *runner, FuzzCase *fuzz_case, FuzzMismatch *mismatch)
+{
+    int level;
+
+    fuzz_render_reference(runner, fuzz_case);
+    for (level = VIRTUAPPU_SIMD_SCALAR; level <= (int)runner->max_level; ++level) {
+        if (fuzz_compare_level(runner, fuzz_case, (VirtuaPPUSimdLevel)level, mismatch)) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static bool fuzz_still_fails(FuzzRunner *runner, FuzzCase *fuzz_case, VirtuaPPUSimdLevel level)
+{
+    FuzzMismatch mismatch;
+
+    fuzz_render_reference(runner, fuzz_case);
+    return fuzz_compare_level(runner, fuzz_case, level, &mismatch);
+}
+
+/* Zero ever smaller chunks of the state while the failure reproduces at the level that exposed it. */
+static void fuzz_minimize(FuzzRunner *runner, FuzzCase *fuzz_case, VirtuaPPUSimdLevel level)
+{
+    uint8_t saved[4096];
+    size_t chunk = 4096u;
+    uint32_t budget_end = runner->renders + FUZZ_MINIMIZE_BUDGET;
+
+    if (fuzz_case->mode == 0) {
+        return;
+    }
+
+    for (; chunk >= 2u && runner->renders < budget_end; chunk /= 2u) {
+        size_t offset;
+
+        for (offset = 0; offset < fuzz_case->size && runner->renders < budget_end; offset += chunk) {
+            size_t length = (offset + chunk <= fuzz_case->size) ? chunk : fuzz_case->size - offset;
+            size_t i;
+            bool any = false;
+
+            for (i = 0; i < length && !any; ++i) {
+                any = fuzz_case->state[offset + i] != 0u;
+            }
+            if (!any) {
+                continue;
+            }
+
+            memcpy(saved, &fuzz_case->state[offset], length);
+            memset(&fuzz_case->state[offset], 0, length);
+            if (!fuzz_still_fails(runner, fuzz_case, level)) {
+                memcpy(&fuzz_case->state[offset], saved, length);
+            }
+        }
+    }
+}
+
+static void fuzz_report_ranges(const char *name, const uint8_t *bytes, size_t size)
+{
+    size_t i = 0u;
+    uint32_t printed = 0u;
+    size_t nonzero = 0u;
+
+    for (i = 0; i < size; ++i) {
+        nonzero += bytes[i] != 0u;
+    }
+    fprintf(stderr, "  %s: %zu non-zero bytes", name, nonzero);
+
+    for (i = 0; i < size && printed < 8u; ++i) {
+        size_t end = i;
+
+        if (bytes[i] == 0u) {
+            continue;
+        }
+        while (end < size && bytes[end] != 0u) {
+            ++end;
+        }
+        fprintf(stderr, "%s0x%zx-0x%zx", printed == 0u ? " at " : ", ", i, end - 1u);
+        ++printed;
+        i = end;
+    }
+    fprintf(stderr, "%s\n", printed == 8u ? ", ..." : "");
+}
+
+static void fuzz_report_state(const FuzzCase *fuzz_case)
+{
+    if (fuzz_case->mode == 1 || fuzz_case->mode == 2) {
+        const Mode1Layout *layout = (const Mode1Layout *)fuzz_case->state;
+        int i;
+
+        fprintf(stderr, "  io:");
+        for (i = 0; i < 0x56; i += 2) {
+            uint16_t value = (uint16_t)(layout->io_mem[i] | (layout->io_mem[i + 1] << 8u));
+            if (value != 0u) {
+                fprintf(stderr, " [%02x]=%04x", i, value);
+            }
+        }
+        fprintf(stderr, "\n");
+        for (i = 0; i < MODE1_GBA_OAM_COUNT; ++i) {
+            const uint16_t *attr = &layout->oam_mem[i * 4];
+            if (attr[0] != 0u || attr[1] != 0u || attr[2] != 0u) {
+                fprintf(stderr, "  oam[%d]: %04x %04x %04x\n", i, attr[0], attr[1], attr[2]);
+            }
+        }
+        fuzz_report_ranges("vram", layout->vram, sizeof(layout->vram));
+        fuzz_report_ranges("bg_palette", (const uint8_t *)layout->bg_palette, sizeof(layout->bg_palette));
+        fuzz_report_ranges("obj_palette", (const uint8_t *)layout->obj_palette, sizeof(layout->obj_palette));
+    } else if (fuzz_case->mode == 7) {
+        const Mode7Layout *layout = (const Mode7Layout *)fuzz_case->state;
+
+        fprintf(stderr, "  regs: lcdc=%02x scy=%02x scx=%02x wy=%02x wx=%02x bgp=%02x obp0=%02x obp1=%02x\n",
+                layout->regs.lcdc, layout->regs.scy, layout->regs.scx, layout->regs.wy, layout->regs.wx,
+                layout->regs.bgp, layout->regs.obp0, layout->regs.obp1);
+        fuzz_report_ranges("vram", layout->vram, sizeof(layout->vram));
+        fuzz_report_ranges("oam", layout->oam, sizeof(layout->oam));
+    } else {
+        fprintf(stderr, "  frame_width=%u\n", fuzz_case->frame_width);
+    }
+}
+
+static bool fuzz_dump(const char *path, const FuzzCase *fuzz_case)
+{
+    uint32_t header[4] = {FUZZ_DUMP_MAGIC, (uint32_t)fuzz_case->mode, fuzz_case->frame_width, (uint32_t)fuzz_case->size};
+    FILE *file = fopen(path, "wb");
+    bool ok;
+
+    if (file == NULL) {
+        return false;
+    }
+
+    ok = fwrite(header, sizeof(header), 1u, file) == 1u && fwrite(fuzz_case->state, fuzz_case->size, 1u, file) == 1u;
+    return (fclose(file) == 0) && ok;
+}
+
+static bool fuzz_load(const char *path, FuzzCase *fuzz_case)
+{
+    uint32_t header[4];
+    FILE *file = fopen(path, "rb");
+    bool ok;
+
+    if (file == NULL) {
+        return false;
+    }
+
+    memset(fuzz_case, 0, sizeof(*fuzz_case));
+    ok = fread(header, sizeof(header), 1u, file) == 1u && header[0] == FUZZ_DUMP_MAGIC && header[3] <= FUZZ_STATE_BYTES &&
+         header[2] >= 1u && header[2] <= VIRTUAPPU_MAX_FRAME_WIDTH;
+    if (ok) {
+        fuzz_case->mode = (int)header[1];
+        fuzz_case->frame_width = header[2];
+        fuzz_case->size = header[3];
+        ok = (fuzz_case->mode == 0 || fuzz_case->mode == 1 || fuzz_case->mode == 2 || fuzz_case->mode == 7) &&
+             fread(fuzz_case->state, fuzz_case->size, 1u, file) == 1u;
+    }
+    fclose(file);
+    return ok;
+}
+
+static int fuzz_fail(FuzzRunner *runner, FuzzCase *fuzz_case, const FuzzMismatch *mismatch, const char *dump_path)
+{
+    FuzzMismatch minimized = *mismatch;
+
+    fprintf(stderr, "mode %d: %s differs from the reference in %u pixels, first at (%u, %u): expected %08x, got %08x\n",
+            fuzz_case->mode, virtuappu_simd_level_name(mismatch->level), mismatch->pixels, mismatch->x, mismatch->y,
+            mismatch->expected, mismatch->actual);
+
+    fuzz_minimize(runner, fuzz_case, mismatch->level);
+    fuzz_render_reference(runner, fuzz_case);
+    fuzz_compare_level(runner, fuzz_case, mismatch->level, &minimized);
+    fprintf(stderr, "minimized state (%u pixels, first at (%u, %u): expected %08x, got %08x):\n",
+            minimized.pixels, minimized.x, minimized.y, minimized.expected, minimized.actual);
+    fuzz_report_state(fuzz_case);
+
+    if (dump_path != NULL) {
+        if (fuzz_dump(dump_path, fuzz_case)) {
+            fprintf(stderr, "state written to %s; rerun with --replay=%s\n", dump_path, dump_path);
+        } else {
+            fprintf(stderr, "cannot write %s\n", dump_path);
+        }
+    }
+
+    return 1;
+}
+
+int main(int argc, char **argv)
+{
+    static FuzzCase fuzz_case;
+    const char *dump_path = NULL;
+    const char *replay_path = NULL;
+    const char *modes = "0,1,2,7";
+    uint32_t iterations = FUZZ_DEFAULT_ITERATIONS;
+    uint64_t seed = 1u;
+    FuzzRunner runner;
+    FuzzMismatch mismatch;
+    uint32_t iteration;
+    int result = 0;
+    int i;
+
+    for (i = 1; i < argc; ++i) {
+        if (strncmp(argv[i], "--iterations=", 13) == 0) {
+            iterations = (uint32_t)strtoul(argv[i] + 13, NULL, 10);
+        } else if (strncmp(argv[i], "--seed=", 7) == 0) {
+            seed = strtoull(argv[i] + 7, NULL, 10);
+        } else if (strncmp(argv[i], "--modes=", 8) == 0) {
+            modes = argv[i] + 8;
+        } else if (strncmp(argv[i], "--dump=", 7) == 0) {
+            dump_path = argv[i] + 7;
+        } else if (strncmp(argv[i], "--replay=", 9) == 0) {
+            replay_path = argv[i] + 9;
+        } else {
+            fprintf(stderr, "usage: %s [--iterations=N] [--seed=N] [--modes=0,1,2,7] [--dump=FILE] [--replay=FILE]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    runner.ctx = virtuappu_context_create();
+    runner.expected = (uint32_t *)malloc(VIRTUAPPU_FRAME_BUFFER_SIZE * sizeof(uint32_t));
+    runner.max_level = virtuappu_simd_detect();
+    runner.renders = 0u;
+    if (runner.ctx == NULL || runner.expected == NULL) {
+        fprintf(stderr, "out of memory\n");
+        free(runner.expected);
+        virtuappu_context_destroy(runner.ctx);
+        return 1;
+    }
+
+    if (replay_path != NULL) {
+        if (!fuzz_load(replay_path, &fuzz_case)) {
+            fprintf(stderr, "%s: cannot read fuzz state '%s'\n", argv[0], replay_path);
+            result = 1;
+        } else if (fuzz_check(&runner, &fuzz_case, &mismatch)) {
+            result = fuzz_fail(&runner, &fuzz_case, &mismatch, NULL);
+        } else {
+            fprintf(stderr, "mode %d: state matches the reference\n", fuzz_case.mode);
+        }
+    }
+
+    fuzz_rng_state = seed * 0x9E3779B97F4A7C15ull + 1u;
+    for (iteration = 0; replay_path == NULL && iteration < iterations && result == 0; ++iteration) {
+        const char *mode = modes;
+
+        for (; *mode != '\0' && result == 0; ++mode) {
+            switch (*mode) {
+            case '0':
+                fuzz_generate_mode0(&fuzz_case);
+                break;
+            case '1':
+            case '2':
+                fuzz_generate_mode1(&fuzz_case, *mode - '0');
+                break;
+            case '7':
+                fuzz_generate_mode7(&fuzz_case);
+                break;
+            default:
+                continue;
+            }
+
+            if (fuzz_check(&runner, &fuzz_case, &mismatch)) {
+                fprintf(stderr, "iteration %u (seed %llu) failed\n", iteration, (unsigned long long)seed);
+                result = fuzz_fail(&runner, &fuzz_case, &mismatch, dump_path);
+            }
+        }
+    }
+
+    if (replay_path == NULL && result == 0) {
+        printf("%u iterations of modes %s matched the reference up to %s (%u renders)\n",
+               iterations, modes, virtuappu_simd_level_name(runner.max_level), runner.renders);
+    }
+
+    free(runner.expected);
+    virtuappu_context_destroy(runner.ctx);
+    virtuappu_thread_pool_shutdown();
+    return result;
+}
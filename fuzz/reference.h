@@ -0,0 +1,18 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "modes_impl.h"
+#include "virtuappu.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void fuzz_reference_mode0(uint32_t frame_width, uint32_t *frame);
+void fuzz_reference_mode1(Mode1Layout *state, int mode, uint32_t *frame);
+void fuzz_reference_mode7(const Mode7Layout *layout, uint32_t *frame);
+
+#ifdef __cplusplus
+}
+#endif
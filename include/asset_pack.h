@@ -0,0 +1,82 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "cpu/mode0.h"
+#include "ppu_memory.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+enum {
+    VIRTUAPPU_ASSET_PACK_VERSION = 2,
+    VIRTUAPPU_ASSET_PACK_TILE_BYTES = 32,
+    VIRTUAPPU_ASSET_PACK_SECTION_ALIGN = 64,
+    VIRTUAPPU_ASSET_PACK_GFX_ALIGN = 4096,
+    VIRTUAPPU_ASSET_PACK_NAME_BYTES = 32
+};
+
+enum {
+    VIRTUAPPU_ASSET_SPRITE_CONTIGUOUS = 1u << 0
+};
+
+typedef struct VirtuaPPUAssetPackHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t header_bytes;
+    uint32_t file_bytes;
+    uint32_t tile_bytes;
+    uint32_t palette_offset;
+    uint32_t palette_count;
+    uint32_t sprite_offset;
+    uint32_t sprite_count;
+    uint32_t entry_offset;
+    uint32_t entry_count;
+    uint32_t gfx_offset;
+    uint32_t gfx_bytes;
+    uint32_t reserved[2];
+} VirtuaPPUAssetPackHeader;
+
+typedef struct VirtuaPPUAssetSprite {
+    char name[VIRTUAPPU_ASSET_PACK_NAME_BYTES];
+    uint16_t width;
+    uint16_t height;
+    uint8_t blocks_w;
+    uint8_t blocks_h;
+    uint8_t palette_index;
+    uint8_t flags;
+    uint32_t first_entry;
+    uint32_t entry_count;
+} VirtuaPPUAssetSprite;
+
+typedef struct VirtuaPPUAssetPack VirtuaPPUAssetPack;
+
+extern const char virtuappu_asset_pack_magic[8];
+
+VirtuaPPUAssetPack *virtuappu_asset_pack_open(const char *path);
+void virtuappu_asset_pack_close(VirtuaPPUAssetPack *pack);
+const VirtuaPPUAssetPackHeader *virtuappu_asset_pack_header(const VirtuaPPUAssetPack *pack);
+const uint8_t *virtuappu_asset_pack_gfx(const VirtuaPPUAssetPack *pack);
+const Mode0Palette16Rgb888 *virtuappu_asset_pack_palettes(const VirtuaPPUAssetPack *pack);
+const Mode0TileEntry *virtuappu_asset_pack_entries(const VirtuaPPUAssetPack *pack);
+const VirtuaPPUAssetSprite *virtuappu_asset_pack_sprite(const VirtuaPPUAssetPack *pack, uint32_t sprite_index);
+const VirtuaPPUAssetSprite *virtuappu_asset_pack_find_sprite(const VirtuaPPUAssetPack *pack, const char *name);
+
+bool virtuappu_asset_pack_load_mode0_ctx(
+    VirtuaPPUContext *ctx,
+    const VirtuaPPUAssetPack *pack,
+    size_t gfx_offset,
+    size_t palette_bank_index,
+    size_t palette_index_in_bank);
+bool virtuappu_asset_pack_load_mode0(
+    const VirtuaPPUAssetPack *pack,
+    size_t gfx_offset,
+    size_t palette_bank_index,
+    size_t palette_index_in_bank);
+
+#ifdef __cplusplus
+}
+#endif
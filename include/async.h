@@ -0,0 +1,35 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "ppu_memory.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+enum {
+    VIRTUAPPU_ASYNC_MIN_BUFFERS = 2,
+    VIRTUAPPU_ASYNC_MAX_BUFFERS = 3
+};
+
+typedef struct VirtuaPPUAsync VirtuaPPUAsync;
+
+typedef void (*VirtuaPPUFrameCallback)(void *user, uint64_t fence, const VirtuaPPUContext *frame);
+
+VirtuaPPUAsync *virtuappu_async_create(
+    VirtuaPPUContext *source,
+    uint32_t buffer_count,
+    VirtuaPPUFrameCallback on_frame,
+    void *user);
+void virtuappu_async_destroy(VirtuaPPUAsync *async);
+uint64_t virtuappu_async_submit(VirtuaPPUAsync *async);
+void virtuappu_async_wait(VirtuaPPUAsync *async, uint64_t fence);
+uint64_t virtuappu_async_completed_fence(VirtuaPPUAsync *async);
+const VirtuaPPUContext *virtuappu_async_acquire_frame(VirtuaPPUAsync *async, uint64_t *fence);
+void virtuappu_async_release_frame(VirtuaPPUAsync *async, const VirtuaPPUContext *frame);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "cpu/mode0.h"
+#include "ppu_memory.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+enum {
+    VIRTUAPPU_COMMAND_QUEUE_MIN_BYTES = 4096,
+    VIRTUAPPU_COMMAND_QUEUE_DEFAULT_BYTES = 256 * 1024
+};
+
+typedef struct VirtuaPPUCommandQueue VirtuaPPUCommandQueue;
+
+VirtuaPPUCommandQueue *virtuappu_command_queue_create(size_t capacity_bytes);
+void virtuappu_command_queue_destroy(VirtuaPPUCommandQueue *queue);
+void virtuappu_command_queue_commit(VirtuaPPUCommandQueue *queue);
+void virtuappu_command_queue_discard(VirtuaPPUCommandQueue *queue);
+size_t virtuappu_command_queue_apply_ctx(VirtuaPPUContext *ctx, VirtuaPPUCommandQueue *queue);
+size_t virtuappu_command_queue_apply(VirtuaPPUCommandQueue *queue);
+void virtuappu_set_command_queue_ctx(VirtuaPPUContext *ctx, VirtuaPPUCommandQueue *queue);
+void virtuappu_set_command_queue(VirtuaPPUCommandQueue *queue);
+
+bool virtuappu_command_queue_set_palette16(VirtuaPPUCommandQueue *queue, size_t palette_bank_index, size_t palette_index_in_bank, const Mode0Palette16Rgb888 *palette);
+bool virtuappu_command_queue_set_palette256(VirtuaPPUCommandQueue *queue, size_t palette_bank_index, const Mode0Palette256Rgb888 *palette);
+bool virtuappu_command_queue_set_gfx_data(VirtuaPPUCommandQueue *queue, const uint8_t *data, size_t size, size_t offset);
+bool virtuappu_command_queue_set_tilemap_entry(VirtuaPPUCommandQueue *queue, size_t bg_index, size_t entry_index, Mode0TileEntry entry);
+bool virtuappu_command_queue_set_bg_entry(VirtuaPPUCommandQueue *queue, size_t bg_index, const Mode0BgEntry *bg_entry);
+bool virtuappu_command_queue_set_oam_entry(VirtuaPPUCommandQueue *queue, size_t oam_index, const Mode0OAMEntry *oam_entry);
+bool virtuappu_command_queue_set_ppu_regs(VirtuaPPUCommandQueue *queue, const Mode0PPURegs *regs);
+bool virtuappu_command_queue_set_bg_line_scroll(VirtuaPPUCommandQueue *queue, size_t bg_index, size_t line_index, const Mode0LineScroll *line_scroll);
+bool virtuappu_command_queue_set_bg_line_affine_tx_ty(VirtuaPPUCommandQueue *queue, size_t bg_index, size_t line_index, const Mode0LineAffineTxTy *line_affine);
+bool virtuappu_command_queue_set_bg_ring(VirtuaPPUCommandQueue *queue, size_t bg_index, const Mode0BgRing *ring);
+bool virtuappu_command_queue_set_bg_world_origin(VirtuaPPUCommandQueue *queue, size_t bg_index, int32_t world_x, int32_t world_y);
+bool virtuappu_command_queue_set_ring_row(
+    VirtuaPPUCommandQueue *queue,
+    size_t bg_index,
+    int32_t tile_x,
+    int32_t tile_y,
+    const Mode0TileEntry *entries,
+    size_t count);
+bool virtuappu_command_queue_set_ring_column(
+    VirtuaPPUCommandQueue *queue,
+    size_t bg_index,
+    int32_t tile_x,
+    int32_t tile_y,
+    const Mode0TileEntry *entries,
+    size_t count);
+
+#ifdef __cplusplus
+}
+#endif
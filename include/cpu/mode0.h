@@ -48,7 +48,8 @@ enum {
     MODE0_BG_FLAG_WRAP_X = 1u << 2,
     MODE0_BG_FLAG_WRAP_Y = 1u << 3,
     MODE0_BG_FLAG_AFFINE = 1u << 4,
-    MODE0_BG_FLAG_MOSAIC = 1u << 5
+    MODE0_BG_FLAG_MOSAIC = 1u << 5,
+    MODE0_BG_FLAG_RING = 1u << 6
 };
 
 typedef struct Mode0Affine2x2_8_8 {
@@ -73,6 +74,13 @@ typedef struct Mode0BgEntry {
     int32_t ty;
 } Mode0BgEntry;
 
+typedef struct Mode0BgRing {
+    uint16_t width_tiles;
+    uint16_t height_tiles;
+    int32_t world_x;
+    int32_t world_y;
+} Mode0BgRing;
+
 enum {
     MODE0_OAM_FLAG_ENABLED = 1u << 0,
     MODE0_OAM_FLAG_BPP8 = 1u << 1,
@@ -166,6 +174,7 @@ typedef struct Mode0Layout {
     Mode0OAMEntry oam[MODE0_OAM_COUNT];
     Mode0LineScroll bg_line_scroll[MODE0_BG_COUNT][MODE0_MAX_LINES];
     Mode0LineAffineTxTy bg_line_affine[MODE0_BG_COUNT][MODE0_MAX_LINES];
+    Mode0BgRing bg_ring[MODE0_BG_COUNT];
 } Mode0Layout;
 
 Mode0TileEntry mode0_make_tile_entry(
@@ -175,6 +184,7 @@ Mode0TileEntry mode0_make_tile_entry(
     bool hflip,
     bool vflip,
     bool mosaic_enable);
+size_t mode0_ring_entry_index(const Mode0BgRing *ring, int32_t tile_x, int32_t tile_y);
 
 void virtuappu_mode0_set_palette16(size_t palette_bank_index, size_t palette_index_in_bank, const Mode0Palette16Rgb888 *palette);
 void virtuappu_mode0_set_palette256(size_t palette_bank_index, const Mode0Palette256Rgb888 *palette);
@@ -185,8 +195,40 @@ void virtuappu_mode0_set_oam_entry(size_t oam_index, const Mode0OAMEntry *oam_en
 void virtuappu_mode0_set_ppu_regs(const Mode0PPURegs *regs);
 void virtuappu_mode0_set_bg_line_scroll(size_t bg_index, size_t line_index, const Mode0LineScroll *line_scroll);
 void virtuappu_mode0_set_bg_line_affine_tx_ty(size_t bg_index, size_t line_index, const Mode0LineAffineTxTy *line_affine);
+void virtuappu_mode0_set_bg_ring(size_t bg_index, const Mode0BgRing *ring);
+void virtuappu_mode0_set_bg_world_origin(size_t bg_index, int32_t world_x, int32_t world_y);
+void virtuappu_mode0_set_ring_row(size_t bg_index, int32_t tile_x, int32_t tile_y, const Mode0TileEntry *entries, size_t count);
+void virtuappu_mode0_set_ring_column(size_t bg_index, int32_t tile_x, int32_t tile_y, const Mode0TileEntry *entries, size_t count);
 void virtuappu_mode0_render_frame(const PPUMemory *ppu);
 
+void virtuappu_mode0_set_palette16_ctx(VirtuaPPUContext *ctx, size_t palette_bank_index, size_t palette_index_in_bank, const Mode0Palette16Rgb888 *palette);
+void virtuappu_mode0_set_palette256_ctx(VirtuaPPUContext *ctx, size_t palette_bank_index, const Mode0Palette256Rgb888 *palette);
+void virtuappu_mode0_set_gfx_data_ctx(VirtuaPPUContext *ctx, const uint8_t *data, size_t size, size_t offset);
+void virtuappu_mode0_set_tilemap_entry_ctx(VirtuaPPUContext *ctx, size_t bg_index, size_t entry_index, Mode0TileEntry entry);
+void virtuappu_mode0_set_bg_entry_ctx(VirtuaPPUContext *ctx, size_t bg_index, const Mode0BgEntry *bg_entry);
+void virtuappu_mode0_set_oam_entry_ctx(VirtuaPPUContext *ctx, size_t oam_index, const Mode0OAMEntry *oam_entry);
+void virtuappu_mode0_set_ppu_regs_ctx(VirtuaPPUContext *ctx, const Mode0PPURegs *regs);
+void virtuappu_mode0_set_bg_line_scroll_ctx(VirtuaPPUContext *ctx, size_t bg_index, size_t line_index, const Mode0LineScroll *line_scroll);
+void virtuappu_mode0_set_bg_line_affine_tx_ty_ctx(VirtuaPPUContext *ctx, size_t bg_index, size_t line_index, const Mode0LineAffineTxTy *line_affine);
+void virtuappu_mode0_set_bg_ring_ctx(VirtuaPPUContext *ctx, size_t bg_index, const Mode0BgRing *ring);
+void virtuappu_mode0_set_bg_world_origin_ctx(VirtuaPPUContext *ctx, size_t bg_index, int32_t world_x, int32_t world_y);
+void virtuappu_mode0_set_ring_row_ctx(
+    VirtuaPPUContext *ctx,
+    size_t bg_index,
+    int32_t tile_x,
+    int32_t tile_y,
+    const Mode0TileEntry *entries,
+    size_t count);
+void virtuappu_mode0_set_ring_column_ctx(
+    VirtuaPPUContext *ctx,
+    size_t bg_index,
+    int32_t tile_x,
+    int32_t tile_y,
+    const Mode0TileEntry *entries,
+    size_t count);
+void virtuappu_mode0_render_frame_ctx(VirtuaPPUContext *ctx);
+void virtuappu_mode0_render_lines_ctx(VirtuaPPUContext *ctx, size_t first_line, size_t end_line);
+
 #ifdef __cplusplus
 }
 #endif
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 
 #include "../ppu_memory.h"
@@ -20,6 +21,11 @@ enum {
     MODE1_OAM_HALFWORDS = 512
 };
 
+enum {
+    MODE1_INDEX_OBJ = 0x0100,
+    MODE1_INDEX_COLORS = 0x0200
+};
+
 enum {
     MODE1_IO_DISPCNT = 0x00,
     MODE1_IO_BG0CNT = 0x08,
@@ -66,6 +72,14 @@ typedef struct VirtuaPPUMode1GbaMemory {
     uint16_t *oam_mem;
 } VirtuaPPUMode1GbaMemory;
 
+typedef struct Mode1Layout {
+    uint8_t io_mem[MODE1_IO_MEM_SIZE];
+    uint8_t vram[MODE1_VRAM_SIZE];
+    uint16_t bg_palette[MODE1_PALETTE_COLORS];
+    uint16_t obj_palette[MODE1_PALETTE_COLORS];
+    uint16_t oam_mem[MODE1_OAM_HALFWORDS];
+} Mode1Layout;
+
 void virtuappu_mode1_bind_gba_memory(const VirtuaPPUMode1GbaMemory *memory);
 void virtuappu_mode1_get_bound_gba_memory(VirtuaPPUMode1GbaMemory *memory);
 uint16_t virtuappu_mode1_io_read16(uint16_t offset);
@@ -82,6 +96,50 @@ void virtuappu_mode1_composite_line(
     uint16_t dispcnt);
 void virtuappu_mode1_render_frame(const PPUMemory *ppu);
 
+void virtuappu_mode1_bind_gba_memory_ctx(VirtuaPPUContext *ctx, const VirtuaPPUMode1GbaMemory *memory);
+void virtuappu_mode1_get_bound_gba_memory_ctx(const VirtuaPPUContext *ctx, VirtuaPPUMode1GbaMemory *memory);
+uint16_t virtuappu_mode1_io_read16_ctx(const VirtuaPPUContext *ctx, uint16_t offset);
+uint32_t virtuappu_mode1_io_read32_ctx(const VirtuaPPUContext *ctx, uint16_t offset);
+void virtuappu_mode1_render_text_bg_line_ctx(
+    const VirtuaPPUContext *ctx,
+    int bg_index,
+    int line,
+    uint32_t *line_buffer,
+    uint8_t *priority_buffer);
+void virtuappu_mode1_render_obj_line_ctx(
+    const VirtuaPPUContext *ctx,
+    int line,
+    bool obj_1d,
+    uint32_t *line_buffer,
+    uint8_t *priority_buffer);
+void virtuappu_mode1_composite_line_ctx(
+    VirtuaPPUContext *ctx,
+    int line,
+    uint32_t bg_layers[MODE1_GBA_BG_COUNT][MODE1_GBA_WIDTH],
+    uint8_t bg_priority[MODE1_GBA_BG_COUNT][MODE1_GBA_WIDTH],
+    uint32_t obj_layer[MODE1_GBA_WIDTH],
+    uint8_t obj_priority[MODE1_GBA_WIDTH],
+    uint16_t dispcnt);
+void virtuappu_mode1_render_text_bg_indices_ctx(const VirtuaPPUContext *ctx, int bg_index, int line, uint16_t *index_buffer);
+void virtuappu_mode1_render_obj_indices_ctx(
+    const VirtuaPPUContext *ctx,
+    int line,
+    bool obj_1d,
+    uint16_t *index_buffer,
+    uint8_t *priority_buffer);
+void virtuappu_mode1_composite_indices_ctx(
+    VirtuaPPUContext *ctx,
+    int line,
+    uint16_t bg_indices[MODE1_GBA_BG_COUNT][MODE1_GBA_WIDTH],
+    const uint16_t obj_indices[MODE1_GBA_WIDTH],
+    const uint8_t obj_priority[MODE1_GBA_WIDTH],
+    uint16_t dispcnt,
+    const uint32_t *palette);
+void virtuappu_mode1_build_palette_ctx(const VirtuaPPUContext *ctx, uint32_t palette[MODE1_INDEX_COLORS]);
+void virtuappu_mode1_begin_lines_ctx(VirtuaPPUContext *ctx);
+void virtuappu_mode1_render_lines_ctx(VirtuaPPUContext *ctx, size_t first_line, size_t end_line);
+void virtuappu_mode1_render_frame_ctx(VirtuaPPUContext *ctx);
+
 #ifdef __cplusplus
 }
 #endif
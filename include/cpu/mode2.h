@@ -1,5 +1,7 @@
 #pragma once
 
+#include <stddef.h>
+
 #include "../ppu_memory.h"
 
 #ifdef __cplusplus
@@ -7,6 +9,8 @@ extern "C" {
 #endif
 
 void virtuappu_mode2_render_frame(const PPUMemory *ppu);
+void virtuappu_mode2_render_lines_ctx(VirtuaPPUContext *ctx, size_t first_line, size_t end_line);
+void virtuappu_mode2_render_frame_ctx(VirtuaPPUContext *ctx);
 
 #ifdef __cplusplus
 }
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <stddef.h>
 #include <stdint.h>
 
 #include "../ppu_memory.h"
@@ -41,6 +42,8 @@ typedef struct Mode7Layout {
 } Mode7Layout;
 
 void virtuappu_mode7_render_frame(const PPUMemory *ppu);
+void virtuappu_mode7_render_lines_ctx(VirtuaPPUContext *ctx, size_t first_line, size_t end_line);
+void virtuappu_mode7_render_frame_ctx(VirtuaPPUContext *ctx);
 
 #ifdef __cplusplus
 }
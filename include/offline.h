@@ -0,0 +1,28 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "ppu_memory.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+enum {
+    VIRTUAPPU_OFFLINE_DEFAULT_FRAMES_IN_FLIGHT = 8,
+    VIRTUAPPU_OFFLINE_MAX_FRAMES_IN_FLIGHT = 64
+};
+
+typedef bool (*VirtuaPPUOfflineSourceFn)(void *user, uint64_t frame_index, VirtuaPPUContext *frame);
+typedef void (*VirtuaPPUOfflineSinkFn)(void *user, uint64_t frame_index, const VirtuaPPUContext *frame);
+
+uint64_t virtuappu_render_offline(
+    VirtuaPPUOfflineSourceFn source,
+    VirtuaPPUOfflineSinkFn sink,
+    void *user,
+    uint32_t frames_in_flight);
+
+#ifdef __cplusplus
+}
+#endif
@@ -2,8 +2,22 @@
 
 #include <stdint.h>
 
+#ifndef VIRTUAPPU_MAX_FRAME_WIDTH
+#define VIRTUAPPU_MAX_FRAME_WIDTH 1280
+#endif
+
+#ifndef VIRTUAPPU_MAX_FRAME_HEIGHT
+#define VIRTUAPPU_MAX_FRAME_HEIGHT 360
+#endif
+
+#ifndef VIRTUAPPU_VRAM_SIZE
+#define VIRTUAPPU_VRAM_SIZE (4 * 1024 * 1024)
+#endif
+
 typedef struct PPUMemory {
     uint16_t frame_width;
     uint8_t mode;
     uint8_t reserved;
 } PPUMemory;
+
+typedef struct VirtuaPPUContext VirtuaPPUContext;
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "ppu_memory.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum VirtuaPPUPixelFormat {
+    VIRTUAPPU_FORMAT_ABGR8888 = 0,
+    VIRTUAPPU_FORMAT_ARGB8888 = 1,
+    VIRTUAPPU_FORMAT_RGB565 = 2,
+    VIRTUAPPU_FORMAT_XRGB1555 = 3,
+    VIRTUAPPU_FORMAT_INDEX8 = 4,
+    VIRTUAPPU_FORMAT_INDEX16 = 5
+} VirtuaPPUPixelFormat;
+
+enum {
+    VIRTUAPPU_MAX_OUTPUT_SCALE = 6
+};
+
+enum {
+    VIRTUAPPU_DIRTY_BLOCK_SIZE = 16,
+    VIRTUAPPU_DIRTY_WORDS_PER_ROW = (VIRTUAPPU_MAX_FRAME_WIDTH + VIRTUAPPU_DIRTY_BLOCK_SIZE * 64 - 1) / (VIRTUAPPU_DIRTY_BLOCK_SIZE * 64),
+    VIRTUAPPU_DIRTY_MAX_ROWS = (VIRTUAPPU_MAX_FRAME_HEIGHT + VIRTUAPPU_DIRTY_BLOCK_SIZE - 1) / VIRTUAPPU_DIRTY_BLOCK_SIZE
+};
+
+enum {
+    VIRTUAPPU_OUTPUT_PALETTE_MAX = 4096,
+    VIRTUAPPU_OUTPUT_PALETTE_HASH = 8192,
+    VIRTUAPPU_OUTPUT_PALETTE_NEAREST_CELLS = 4096
+};
+
+typedef struct VirtuaPPURenderTarget {
+    void *pixels;
+    size_t pitch;
+    VirtuaPPUPixelFormat format;
+    uint8_t scale;
+    bool scanlines;
+} VirtuaPPURenderTarget;
+
+typedef struct VirtuaPPUDirtyMap {
+    uint32_t width;
+    uint32_t height;
+    uint32_t blocks_x;
+    uint32_t blocks_y;
+    uint32_t dirty_blocks;
+    uint64_t rows[VIRTUAPPU_DIRTY_MAX_ROWS][VIRTUAPPU_DIRTY_WORDS_PER_ROW];
+} VirtuaPPUDirtyMap;
+
+/* Indexed output is a lossy quantizer: once a frame fills the palette, further colours get the entry nearest
+ * their 4-bit-per-channel cell. */
+typedef struct VirtuaPPUOutputPalette {
+    uint32_t colors[VIRTUAPPU_OUTPUT_PALETTE_MAX];
+    uint32_t count;
+    uint32_t hash_used;
+    uint32_t keys[VIRTUAPPU_OUTPUT_PALETTE_HASH];
+    uint16_t slots[VIRTUAPPU_OUTPUT_PALETTE_HASH];
+    uint16_t nearest_cells[VIRTUAPPU_OUTPUT_PALETTE_NEAREST_CELLS];
+} VirtuaPPUOutputPalette;
+
+size_t virtuappu_pixel_format_bytes(VirtuaPPUPixelFormat format);
+bool virtuappu_pixel_format_is_indexed(VirtuaPPUPixelFormat format);
+void virtuappu_set_render_target_ctx(VirtuaPPUContext *ctx, const VirtuaPPURenderTarget *target);
+void virtuappu_set_render_target(const VirtuaPPURenderTarget *target);
+void virtuappu_write_line(VirtuaPPUContext *ctx, size_t line, const uint32_t *pixels, size_t width);
+void virtuappu_set_dirty_tracking_ctx(VirtuaPPUContext *ctx, bool enabled);
+void virtuappu_set_dirty_tracking(bool enabled);
+bool virtuappu_get_dirty_map_ctx(const VirtuaPPUContext *ctx, VirtuaPPUDirtyMap *map);
+bool virtuappu_get_dirty_map(VirtuaPPUDirtyMap *map);
+void virtuappu_reset_output_palette(VirtuaPPUContext *ctx);
+uint32_t virtuappu_get_output_palette_ctx(const VirtuaPPUContext *ctx, uint32_t *abgr, uint32_t capacity);
+uint32_t virtuappu_get_output_palette(uint32_t *abgr, uint32_t capacity);
+void virtuappu_fill_lines(VirtuaPPUContext *ctx, size_t first_line, size_t line_count, size_t width, uint32_t abgr);
+
+#ifdef __cplusplus
+}
+#endif
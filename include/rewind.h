@@ -0,0 +1,40 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "ppu_memory.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+enum {
+    VIRTUAPPU_REWIND_PAGE_BYTES = 4096,
+    VIRTUAPPU_REWIND_DEFAULT_BUDGET = 32 * 1024 * 1024,
+    VIRTUAPPU_REWIND_DEFAULT_SNAPSHOTS = 600
+};
+
+typedef struct VirtuaPPURewind VirtuaPPURewind;
+
+typedef struct VirtuaPPURewindInfo {
+    uint32_t snapshots;
+    size_t delta_bytes;
+    size_t budget_bytes;
+    uint32_t last_changed_pages;
+    size_t last_delta_bytes;
+} VirtuaPPURewindInfo;
+
+VirtuaPPURewind *virtuappu_rewind_create(size_t budget_bytes, uint32_t max_snapshots);
+void virtuappu_rewind_destroy(VirtuaPPURewind *rewind);
+void virtuappu_rewind_clear(VirtuaPPURewind *rewind);
+bool virtuappu_rewind_push(VirtuaPPURewind *rewind, const VirtuaPPUContext *ctx);
+bool virtuappu_rewind_restore(const VirtuaPPURewind *rewind, VirtuaPPUContext *ctx);
+bool virtuappu_rewind_step_back(VirtuaPPURewind *rewind, VirtuaPPUContext *ctx);
+uint32_t virtuappu_rewind_snapshot_count(const VirtuaPPURewind *rewind);
+void virtuappu_rewind_get_info(const VirtuaPPURewind *rewind, VirtuaPPURewindInfo *info);
+
+#ifdef __cplusplus
+}
+#endif
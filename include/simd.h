@@ -0,0 +1,37 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum VirtuaPPUSimdLevel {
+    VIRTUAPPU_SIMD_SCALAR = 0,
+    VIRTUAPPU_SIMD_SSE2 = 1,
+    VIRTUAPPU_SIMD_AVX2 = 2,
+    VIRTUAPPU_SIMD_AVX512 = 3
+} VirtuaPPUSimdLevel;
+
+typedef struct VirtuaPPUSimdKernels {
+    VirtuaPPUSimdLevel level;
+    void (*fill32)(uint32_t *dst, uint32_t value, size_t count);
+    void (*decode_4bpp)(uint8_t *dst, const uint8_t *src, size_t bytes);
+    void (*lookup32)(uint32_t *dst, const uint16_t *indices, const uint32_t *palette, size_t count);
+    void (*blend_alpha)(uint32_t *dst, const uint32_t *bottom, const uint8_t *mask, int eva, int evb, size_t count);
+    void (*brighten)(uint32_t *dst, const uint8_t *mask, int evy, size_t count);
+    void (*darken)(uint32_t *dst, const uint8_t *mask, int evy, size_t count);
+} VirtuaPPUSimdKernels;
+
+VirtuaPPUSimdLevel virtuappu_simd_detect(void);
+VirtuaPPUSimdLevel virtuappu_simd_select(void);
+VirtuaPPUSimdLevel virtuappu_simd_set_level(VirtuaPPUSimdLevel level);
+VirtuaPPUSimdLevel virtuappu_simd_level(void);
+const char *virtuappu_simd_level_name(VirtuaPPUSimdLevel level);
+const VirtuaPPUSimdKernels *virtuappu_simd_kernels(void);
+
+#ifdef __cplusplus
+}
+#endif
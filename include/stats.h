@@ -0,0 +1,105 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "ppu_memory.h"
+
+#ifdef VIRTUAPPU_ENABLE_STATS
+#include <time.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum VirtuaPPUStatsStage {
+    VIRTUAPPU_STATS_STAGE_BG = 0,
+    VIRTUAPPU_STATS_STAGE_OBJ = 1,
+    VIRTUAPPU_STATS_STAGE_COMPOSITE = 2,
+    VIRTUAPPU_STATS_STAGE_OUTPUT = 3,
+    VIRTUAPPU_STATS_STAGE_COUNT = 4
+} VirtuaPPUStatsStage;
+
+enum {
+    VIRTUAPPU_STATS_MAX_LINES = VIRTUAPPU_MAX_FRAME_HEIGHT,
+    VIRTUAPPU_STATS_HISTOGRAM_BUCKETS = 32
+};
+
+typedef struct VirtuaPPUStats {
+    uint64_t frame_cycles;
+    uint64_t stage_cycles[VIRTUAPPU_STATS_STAGE_COUNT];
+    uint64_t tiles_fetched;
+    uint64_t opaque_blocks_skipped;
+    uint64_t sprites_drawn;
+    uint64_t pixels_blended;
+    uint32_t line_count;
+    uint64_t line_cycles[VIRTUAPPU_STATS_MAX_LINES];
+    uint32_t line_histogram[VIRTUAPPU_STATS_HISTOGRAM_BUCKETS];
+} VirtuaPPUStats;
+
+typedef struct VirtuaPPULineStats {
+    uint64_t stage_cycles[VIRTUAPPU_STATS_STAGE_COUNT];
+    uint32_t tiles_fetched;
+    uint32_t opaque_blocks_skipped;
+    uint32_t sprites_drawn;
+    uint32_t pixels_blended;
+} VirtuaPPULineStats;
+
+typedef struct VirtuaPPUStatsState {
+    uint64_t frame_begin;
+    uint64_t frame_cycles;
+    uint32_t line_count;
+    VirtuaPPULineStats lines[VIRTUAPPU_STATS_MAX_LINES];
+} VirtuaPPUStatsState;
+
+bool virtuappu_get_stats_ctx(const VirtuaPPUContext *ctx, VirtuaPPUStats *stats);
+bool virtuappu_get_stats(VirtuaPPUStats *stats);
+
+#ifdef VIRTUAPPU_ENABLE_STATS
+
+static inline uint64_t virtuappu_stats_now(void)
+{
+#if defined(_MSC_VER) || defined(__x86_64__) || defined(__i386__)
+    return (uint64_t)__rdtsc();
+#else
+    struct timespec ts;
+
+    timespec_get(&ts, TIME_UTC);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+#endif
+}
+
+void virtuappu_stats_begin_frame(VirtuaPPUContext *ctx, uint32_t line_count);
+void virtuappu_stats_end_frame(VirtuaPPUContext *ctx);
+
+#define VIRTUAPPU_STATS_TIMER(name) uint64_t name = virtuappu_stats_now()
+#define VIRTUAPPU_STATS_LAP(ctx, line, stage, timer)                                           \
+    do {                                                                                       \
+        uint64_t virtuappu_stats_lap_now = virtuappu_stats_now();                              \
+        (ctx)->stats->lines[(line)].stage_cycles[(stage)] += virtuappu_stats_lap_now - (timer); \
+        (timer) = virtuappu_stats_lap_now;                                                     \
+    } while (0)
+#define VIRTUAPPU_STATS_ADD(ctx, line, counter, amount) ((ctx)->stats->lines[(line)].counter += (uint32_t)(amount))
+#define VIRTUAPPU_STATS_BEGIN_FRAME(ctx, line_count) virtuappu_stats_begin_frame((ctx), (line_count))
+#define VIRTUAPPU_STATS_END_FRAME(ctx) virtuappu_stats_end_frame(ctx)
+
+#else
+
+#define VIRTUAPPU_STATS_TIMER(name)
+#define VIRTUAPPU_STATS_LAP(ctx, line, stage, timer) ((void)0)
+#define VIRTUAPPU_STATS_ADD(ctx, line, counter, amount) ((void)0)
+#define VIRTUAPPU_STATS_BEGIN_FRAME(ctx, line_count) ((void)0)
+#define VIRTUAPPU_STATS_END_FRAME(ctx) ((void)0)
+
+#endif
+
+#ifdef __cplusplus
+}
+#endif
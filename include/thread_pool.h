@@ -0,0 +1,35 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+enum {
+    VIRTUAPPU_THREAD_POOL_MAX_THREADS = 256
+};
+
+typedef void (*VirtuaPPUTaskFn)(void *user, size_t begin, size_t end);
+
+typedef struct VirtuaPPUThreadConfig {
+    uint32_t thread_count;
+    const int32_t *cpu_affinity;
+} VirtuaPPUThreadConfig;
+
+typedef struct VirtuaPPUTaskHooks {
+    void (*parallel_for)(void *hook_user, size_t count, size_t grain, VirtuaPPUTaskFn task, void *task_user);
+    void *hook_user;
+} VirtuaPPUTaskHooks;
+
+bool virtuappu_thread_pool_configure(const VirtuaPPUThreadConfig *config);
+void virtuappu_thread_pool_shutdown(void);
+uint32_t virtuappu_thread_pool_size(void);
+void virtuappu_set_task_hooks(const VirtuaPPUTaskHooks *hooks);
+void virtuappu_parallel_for(size_t count, size_t grain, VirtuaPPUTaskFn task, void *user);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "offline.h"
+#include "ppu_memory.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+enum {
+    VIRTUAPPU_TRACE_VERSION = 1,
+    VIRTUAPPU_TRACE_BLOCK_BYTES = 64
+};
+
+typedef struct VirtuaPPUTraceRecorder VirtuaPPUTraceRecorder;
+typedef struct VirtuaPPUTraceReader VirtuaPPUTraceReader;
+
+VirtuaPPUTraceRecorder *virtuappu_trace_recorder_create(const char *path);
+bool virtuappu_trace_record_frame(VirtuaPPUTraceRecorder *recorder, const VirtuaPPUContext *ctx);
+uint64_t virtuappu_trace_recorder_frame_count(const VirtuaPPUTraceRecorder *recorder);
+bool virtuappu_trace_recorder_close(VirtuaPPUTraceRecorder *recorder);
+
+VirtuaPPUTraceReader *virtuappu_trace_reader_open(const char *path);
+void virtuappu_trace_reader_close(VirtuaPPUTraceReader *reader);
+uint64_t virtuappu_trace_reader_frame_count(const VirtuaPPUTraceReader *reader);
+void virtuappu_trace_reader_rewind(VirtuaPPUTraceReader *reader);
+bool virtuappu_trace_read_frame(VirtuaPPUTraceReader *reader, VirtuaPPUContext *ctx);
+uint64_t virtuappu_trace_render_offline(
+    VirtuaPPUTraceReader *reader,
+    VirtuaPPUOfflineSinkFn sink,
+    void *user,
+    uint32_t frames_in_flight);
+
+#ifdef __cplusplus
+}
+#endif
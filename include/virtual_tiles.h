@@ -0,0 +1,58 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "ppu_memory.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define VIRTUAPPU_VIRTUAL_TILE_NONE UINT32_MAX
+
+typedef struct VirtuaPPUVirtualTiles VirtuaPPUVirtualTiles;
+
+typedef bool (*VirtuaPPUTileSourceFn)(void *user, uint32_t logical_tile, uint8_t *dst, size_t tile_bytes);
+
+typedef struct VirtuaPPUVirtualTilesConfig {
+    uint32_t tile_bytes;
+    uint32_t gfx_offset;
+    uint32_t resident_slots;
+    uint16_t obj_tile_bank;
+    VirtuaPPUTileSourceFn source;
+    void *user;
+} VirtuaPPUVirtualTilesConfig;
+
+typedef struct VirtuaPPUVirtualTileStats {
+    uint32_t tiles_referenced;
+    uint32_t hits;
+    uint32_t misses;
+    uint32_t evictions;
+    uint32_t overflows;
+    uint32_t source_failures;
+    uint32_t resident;
+    uint32_t capacity;
+} VirtuaPPUVirtualTileStats;
+
+bool virtuappu_virtual_tiles_enable_ctx(VirtuaPPUContext *ctx, const VirtuaPPUVirtualTilesConfig *config);
+void virtuappu_virtual_tiles_disable_ctx(VirtuaPPUContext *ctx);
+void virtuappu_virtual_tiles_flush_ctx(VirtuaPPUContext *ctx);
+void virtuappu_virtual_tiles_invalidate_ctx(VirtuaPPUContext *ctx, uint32_t logical_tile);
+uint32_t virtuappu_virtual_tiles_prefetch_ctx(VirtuaPPUContext *ctx, const uint32_t *logical_tiles, size_t count);
+void virtuappu_virtual_tiles_begin_frame_ctx(VirtuaPPUContext *ctx);
+uint32_t virtuappu_virtual_tiles_lookup_ctx(const VirtuaPPUContext *ctx, uint32_t logical_tile);
+bool virtuappu_get_virtual_tile_stats_ctx(const VirtuaPPUContext *ctx, VirtuaPPUVirtualTileStats *stats);
+
+bool virtuappu_virtual_tiles_enable(const VirtuaPPUVirtualTilesConfig *config);
+void virtuappu_virtual_tiles_disable(void);
+void virtuappu_virtual_tiles_flush(void);
+void virtuappu_virtual_tiles_invalidate(uint32_t logical_tile);
+uint32_t virtuappu_virtual_tiles_prefetch(const uint32_t *logical_tiles, size_t count);
+uint32_t virtuappu_virtual_tiles_lookup(uint32_t logical_tile);
+bool virtuappu_get_virtual_tile_stats(VirtuaPPUVirtualTileStats *stats);
+
+#ifdef __cplusplus
+}
+#endif
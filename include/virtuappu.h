@@ -1,26 +1,100 @@
 #pragma once
 
+#include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 
+#include "command_queue.h"
+#include "cpu/mode1.h"
 #include "ppu_memory.h"
+#include "render_target.h"
+#include "stats.h"
+#include "virtual_tiles.h"
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
 enum {
-    VIRTUAPPU_MAX_FRAME_WIDTH = 1280,
-    VIRTUAPPU_MAX_FRAME_HEIGHT = 360,
     VIRTUAPPU_FRAME_BUFFER_SIZE = VIRTUAPPU_MAX_FRAME_WIDTH * VIRTUAPPU_MAX_FRAME_HEIGHT,
-    VIRTUAPPU_VRAM_SIZE = 4 * 1024 * 1024
+    VIRTUAPPU_VRAM_PAGE_BYTES = 4096,
+    VIRTUAPPU_RESET_MADVISE_BYTES = 64 * 1024
+};
+
+enum {
+    VIRTUAPPU_CONTEXT_EXTERNAL_GBA_MEMORY = 1u << 0
+};
+
+enum {
+    VIRTUAPPU_BATCH_SPLIT_PIXELS = 64 * 1024,
+    VIRTUAPPU_BATCH_CHUNK_PIXELS = 32 * 1024
+};
+
+typedef enum VirtuaPPURenderStatus {
+    VIRTUAPPU_RENDER_UPDATED = 0,
+    VIRTUAPPU_RENDER_UNCHANGED = 1,
+    VIRTUAPPU_RENDER_INVALID = 2
+} VirtuaPPURenderStatus;
+
+typedef struct VirtuaPPUFrameSetup {
+    bool active;
+    uint8_t mode;
+    uint16_t dispcnt;
+    uint32_t palette[MODE1_INDEX_COLORS];
+} VirtuaPPUFrameSetup;
+
+struct VirtuaPPUContext {
+    uint32_t *frame_buffer;
+    size_t frame_buffer_pixels;
+    uint8_t *vram;
+    size_t vram_size;
+    PPUMemory *registers;
+    VirtuaPPUMode1GbaMemory mode1_memory;
+    VirtuaPPURenderTarget target;
+    PPUMemory owned_registers;
+    uint64_t input_hash;
+    bool input_hash_valid;
+    bool dirty_tracking;
+    bool dirty_primed;
+    uint16_t dirty_width;
+    uint64_t dirty_lines[VIRTUAPPU_MAX_FRAME_HEIGHT][VIRTUAPPU_DIRTY_WORDS_PER_ROW];
+    VirtuaPPUOutputPalette *output_palette;
+    VirtuaPPUFrameSetup frame_setup;
+    VirtuaPPUVirtualTiles *virtual_tiles;
+    VirtuaPPUCommandQueue *command_queue;
+    bool owns_storage;
+#ifdef VIRTUAPPU_ENABLE_STATS
+    VirtuaPPUStatsState *stats;
+#endif
 };
 
 extern uint32_t virtuappu_frame_buffer[VIRTUAPPU_FRAME_BUFFER_SIZE];
 extern uint8_t virtuappu_vram[VIRTUAPPU_VRAM_SIZE];
 extern PPUMemory virtuappu_registers;
 
+VirtuaPPUContext *virtuappu_context_create(void);
+VirtuaPPUContext *virtuappu_context_create_for_mode(uint8_t mode, uint16_t max_frame_width, uint32_t flags);
+void virtuappu_context_destroy(VirtuaPPUContext *ctx);
+VirtuaPPUContext *virtuappu_get_default_context(void);
+
+size_t virtuappu_mode_vram_footprint(uint8_t mode);
+bool virtuappu_context_supports_mode(const VirtuaPPUContext *ctx, uint8_t mode);
+void virtuappu_context_copy_state(VirtuaPPUContext *dst, const VirtuaPPUContext *src);
+
+void virtuappu_reset_ctx(VirtuaPPUContext *ctx);
+void virtuappu_reset_mode_ctx(VirtuaPPUContext *ctx, uint8_t mode);
+void virtuappu_render_frame_ctx(VirtuaPPUContext *ctx);
+void virtuappu_render_lines_ctx(VirtuaPPUContext *ctx, uint32_t first_line, uint32_t end_line);
+void virtuappu_render_batch(VirtuaPPUContext *const *contexts, size_t count);
+bool virtuappu_get_frame_size_ctx(const VirtuaPPUContext *ctx, uint32_t *width, uint32_t *height);
+uint64_t virtuappu_frame_input_hash(const VirtuaPPUContext *ctx);
+VirtuaPPURenderStatus virtuappu_render_frame_if_changed_ctx(VirtuaPPUContext *ctx);
+
 void virtuappu_reset(void);
+void virtuappu_reset_mode(uint8_t mode);
 void virtuappu_render_frame(void);
+void virtuappu_render_lines(uint32_t first_line, uint32_t end_line);
+VirtuaPPURenderStatus virtuappu_render_frame_if_changed(void);
 uint32_t *virtuappu_get_frame_buffer(void);
 uint8_t *virtuappu_get_vram(void);
 PPUMemory *virtuappu_get_registers(void);
@@ -0,0 +1,212 @@
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "command_queue.h"
+#include "modes_impl.h"
+#include "virtuappu.h"
+
+enum {
+    STRESS_DEFAULT_BATCHES = 20000,
+    STRESS_DEFAULT_QUEUE_BYTES = 64 * 1024,
+    STRESS_OAM_PER_BATCH = 64,
+    STRESS_MAX_GFX_BYTES = 2048,
+    STRESS_RING_BG = 1,
+    STRESS_RING_WIDTH = 64,
+    STRESS_RING_HEIGHT = 32,
+    STRESS_RING_ROW = 37,
+    STRESS_POISON = 0xFFFF,
+    STRESS_RENDER_EVERY = 16
+};
+
+typedef struct StressProducer {
+    VirtuaPPUCommandQueue *queue;
+    uint32_t batches;
+    uint64_t rng_state;
+    uint32_t full_retries;
+    uint32_t discarded_batches;
+    atomic_bool done;
+} StressProducer;
+
+static uint32_t stress_rand(uint64_t *state)
+{
+    *state ^= *state << 13u;
+    *state ^= *state >> 7u;
+    *state ^= *state << 17u;
+    return (uint32_t)(*state >> 16u);
+}
+
+/* One batch stamps every command with the same value; gfx and ring-row sizes vary so commands land at
+ * every offset of the ring and pad records get exercised. */
+static bool stress_enqueue_batch(StressProducer *producer, uint16_t value)
+{
+    Mode0TileEntry row[STRESS_RING_ROW];
+    uint8_t gfx[STRESS_MAX_GFX_BYTES];
+    Mode0OAMEntry obj;
+    size_t gfx_bytes = 1u + stress_rand(&producer->rng_state) % STRESS_MAX_GFX_BYTES;
+    size_t row_count = 1u + stress_rand(&producer->rng_state) % STRESS_RING_ROW;
+    size_t i;
+
+    memset(&obj, 0, sizeof(obj));
+    obj.tile_index = value;
+    obj.x = (int16_t)value;
+    for (i = 0; i < STRESS_OAM_PER_BATCH; ++i) {
+        if (!virtuappu_command_queue_set_oam_entry(producer->queue, i, &obj)) {
+            return false;
+        }
+    }
+
+    memset(gfx, value & 0xFFu, gfx_bytes);
+    for (i = 0; i < row_count; ++i) {
+        row[i] = (Mode0TileEntry)value;
+    }
+
+    return virtuappu_command_queue_set_gfx_data(producer->queue, gfx, gfx_bytes, 0u) &&
+           virtuappu_command_queue_set_ring_row(producer->queue, STRESS_RING_BG, 0, 0, row, row_count);
+}
+
+static void *stress_producer_main(void *user)
+{
+    StressProducer *producer = (StressProducer *)user;
+    uint32_t batch = 1u;
+
+    while (batch <= producer->batches) {
+        /* Now and then a half-written batch of poison is dropped; the consumer must never see it. */
+        if (stress_rand(&producer->rng_state) % 8u == 0u) {
+            Mode0OAMEntry poison;
+
+            memset(&poison, 0, sizeof(poison));
+            poison.tile_index = STRESS_POISON;
+            virtuappu_command_queue_set_oam_entry(producer->queue, 0u, &poison);
+            virtuappu_command_queue_discard(producer->queue);
+            ++producer->discarded_batches;
+        }
+
+        if (!stress_enqueue_batch(producer, (uint16_t)batch)) {
+            virtuappu_command_queue_discard(producer->queue);
+            ++producer->full_retries;
+            sched_yield();
+            continue;
+        }
+
+        virtuappu_command_queue_commit(producer->queue);
+        ++batch;
+    }
+
+    atomic_store_explicit(&producer->done, true, memory_order_release);
+    return NULL;
+}
+
+/* Every field a batch writes must carry one value, and values never go backwards. */
+static bool stress_frame_is_whole(const Mode0Layout *layout, uint16_t *last_value)
+{
+    uint16_t value = layout->oam[0].tile_index;
+    size_t i;
+
+    if (value == STRESS_POISON || value < *last_value) {
+        return false;
+    }
+    for (i = 1; i < STRESS_OAM_PER_BATCH; ++i) {
+        if (layout->oam[i].tile_index != value || layout->oam[i].x != (int16_t)value) {
+            return false;
+        }
+    }
+    if (value != 0u && (layout->gfx_data[0] != (value & 0xFFu) || layout->tilemaps[STRESS_RING_BG][0] != value)) {
+        return false;
+    }
+
+    *last_value = value;
+    return true;
+}
+
+int main(int argc, char **argv)
+{
+    static StressProducer producer;
+    size_t queue_bytes = STRESS_DEFAULT_QUEUE_BYTES;
+    const Mode0Layout *layout;
+    VirtuaPPUContext *ctx;
+    Mode0BgRing ring = {STRESS_RING_WIDTH, STRESS_RING_HEIGHT, 0, 0};
+    pthread_t thread;
+    uint16_t last_value = 0u;
+    uint32_t frames = 0u;
+    uint32_t torn = 0u;
+    int i;
+
+    producer.batches = STRESS_DEFAULT_BATCHES;
+    producer.rng_state = 1u;
+    for (i = 1; i < argc; ++i) {
+        if (strncmp(argv[i], "--batches=", 10) == 0) {
+            producer.batches = (uint32_t)strtoul(argv[i] + 10, NULL, 10);
+        } else if (strncmp(argv[i], "--queue-bytes=", 14) == 0) {
+            queue_bytes = (size_t)strtoul(argv[i] + 14, NULL, 10);
+        } else if (strncmp(argv[i], "--seed=", 7) == 0) {
+            producer.rng_state = strtoull(argv[i] + 7, NULL, 10) | 1u;
+        } else {
+            fprintf(stderr, "usage: %s [--batches=N] [--queue-bytes=N] [--seed=N]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (producer.batches >= STRESS_POISON) {
+        fprintf(stderr, "--batches must be below %d\n", STRESS_POISON);
+        return 1;
+    }
+
+    ctx = virtuappu_context_create_for_mode(0, 320, 0u);
+    producer.queue = virtuappu_command_queue_create(queue_bytes);
+    if (ctx == NULL || producer.queue == NULL) {
+        fprintf(stderr, "out of memory\n");
+        virtuappu_command_queue_destroy(producer.queue);
+        virtuappu_context_destroy(ctx);
+        return 1;
+    }
+
+    ctx->registers->mode = 0u;
+    ctx->registers->frame_width = 320u;
+    virtuappu_mode0_set_bg_ring_ctx(ctx, STRESS_RING_BG, &ring);
+    virtuappu_set_command_queue_ctx(ctx, producer.queue);
+    layout = (const Mode0Layout *)ctx->vram;
+    atomic_init(&producer.done, false);
+
+    if (pthread_create(&thread, NULL, stress_producer_main, &producer) != 0) {
+        fprintf(stderr, "cannot start the producer thread\n");
+        virtuappu_set_command_queue_ctx(ctx, NULL);
+        virtuappu_command_queue_destroy(producer.queue);
+        virtuappu_context_destroy(ctx);
+        return 1;
+    }
+
+    /* The consumer alternates explicit applies with renders, which apply the attached queue themselves. */
+    for (;;) {
+        bool done = atomic_load_explicit(&producer.done, memory_order_acquire);
+
+        if (frames % STRESS_RENDER_EVERY == 0u) {
+            virtuappu_render_frame_ctx(ctx);
+        } else {
+            virtuappu_command_queue_apply_ctx(ctx, producer.queue);
+        }
+        ++frames;
+        if (!stress_frame_is_whole(layout, &last_value)) {
+            ++torn;
+        }
+        if (done) {
+            break;
+        }
+    }
+
+    pthread_join(thread, NULL);
+    virtuappu_command_queue_apply_ctx(ctx, producer.queue);
+    if (!stress_frame_is_whole(layout, &last_value) || layout->oam[0].tile_index != producer.batches) {
+        ++torn;
+    }
+
+    virtuappu_set_command_queue_ctx(ctx, NULL);
+    virtuappu_command_queue_destroy(producer.queue);
+    virtuappu_context_destroy(ctx);
+
+    printf("%u batches through a %zu-byte queue over %u frames: %u full retries, %u discarded, %u torn frames\n",
+           producer.batches, queue_bytes, frames, producer.full_retries, producer.discarded_batches, torn);
+    return (torn == 0u) ? 0 : 1;
+}
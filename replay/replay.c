@@ -0,0 +1,176 @@
+#if !defined(_WIN32) && !defined(_POSIX_C_SOURCE)
+#define _POSIX_C_SOURCE 199309L
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+#include "thread_pool.h"
+#include "trace.h"
+#include "virtuappu.h"
+
+static uint64_t replay_now_ns(void)
+{
+#if defined(_WIN32)
+    LARGE_INTEGER counter;
+    LARGE_INTEGER frequency;
+
+    QueryPerformanceCounter(&counter);
+    QueryPerformanceFrequency(&frequency);
+    return (uint64_t)((double)counter.QuadPart * 1e9 / (double)frequency.QuadPart);
+#else
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+#endif
+}
+
+static int replay_compare_u64(const void *a, const void *b)
+{
+    uint64_t lhs = *(const uint64_t *)a;
+    uint64_t rhs = *(const uint64_t *)b;
+
+    return (lhs > rhs) - (lhs < rhs);
+}
+
+static int replay_sequential(const char *path, VirtuaPPUTraceReader *reader, uint32_t repeat)
+{
+    uint64_t frame_count = virtuappu_trace_reader_frame_count(reader);
+    VirtuaPPUContext *ctx = virtuappu_context_create();
+    uint64_t *render_ns = (uint64_t *)malloc((size_t)(frame_count * repeat + 1u) * sizeof(uint64_t));
+    uint64_t apply_total = 0u;
+    uint64_t render_total = 0u;
+    uint64_t sample_count = 0u;
+    double apply_mean;
+    double render_mean;
+    uint32_t pass;
+
+    if (ctx == NULL || render_ns == NULL) {
+        fprintf(stderr, "out of memory\n");
+        free(render_ns);
+        virtuappu_context_destroy(ctx);
+        return 1;
+    }
+
+    for (pass = 0; pass < repeat; ++pass) {
+        virtuappu_trace_reader_rewind(reader);
+        for (;;) {
+            uint64_t start = replay_now_ns();
+            uint64_t applied;
+
+            if (!virtuappu_trace_read_frame(reader, ctx)) {
+                break;
+            }
+            applied = replay_now_ns();
+            virtuappu_render_frame_ctx(ctx);
+            render_ns[sample_count] = replay_now_ns() - applied;
+            apply_total += applied - start;
+            render_total += render_ns[sample_count];
+            ++sample_count;
+        }
+    }
+
+    qsort(render_ns, (size_t)sample_count, sizeof(uint64_t), replay_compare_u64);
+    apply_mean = sample_count ? (double)apply_total / (double)sample_count : 0.0;
+    render_mean = sample_count ? (double)render_total / (double)sample_count : 0.0;
+
+    printf("{\n  \"format\": 1,\n  \"trace\": \"%s\",\n  \"frames\": %llu,\n  \"repeat\": %u,\n  \"threads\": %u,\n",
+           path, (unsigned long long)frame_count, repeat, virtuappu_thread_pool_size());
+    printf("  \"apply_ns_per_frame\": %.1f,\n  \"render_ns_per_frame\": %.1f,\n", apply_mean, render_mean);
+    printf("  \"render_ns_min\": %llu,\n  \"render_ns_p50\": %llu,\n  \"render_ns_p99\": %llu,\n  \"render_ns_max\": %llu\n}\n",
+           (unsigned long long)(sample_count ? render_ns[0] : 0u),
+           (unsigned long long)(sample_count ? render_ns[sample_count / 2u] : 0u),
+           (unsigned long long)(sample_count ? render_ns[(sample_count * 99u) / 100u] : 0u),
+           (unsigned long long)(sample_count ? render_ns[sample_count - 1u] : 0u));
+    fprintf(stderr, "%llu frames x %u: apply %.0f ns/frame, render %.0f ns/frame\n",
+            (unsigned long long)frame_count, repeat, apply_mean, render_mean);
+
+    free(render_ns);
+    virtuappu_context_destroy(ctx);
+    return 0;
+}
+
+static int replay_offline(const char *path, VirtuaPPUTraceReader *reader, uint32_t repeat, uint32_t frames_in_flight)
+{
+    uint64_t frame_count = virtuappu_trace_reader_frame_count(reader);
+    uint64_t start = replay_now_ns();
+    uint64_t rendered = 0u;
+    double mean;
+    uint32_t pass;
+
+    for (pass = 0; pass < repeat; ++pass) {
+        rendered += virtuappu_trace_render_offline(reader, NULL, NULL, frames_in_flight);
+    }
+    mean = rendered ? (double)(replay_now_ns() - start) / (double)rendered : 0.0;
+
+    printf("{\n  \"format\": 1,\n  \"trace\": \"%s\",\n  \"frames\": %llu,\n  \"repeat\": %u,\n  \"threads\": %u,\n",
+           path, (unsigned long long)frame_count, repeat, virtuappu_thread_pool_size());
+    printf("  \"frames_in_flight\": %u,\n  \"offline_ns_per_frame\": %.1f\n}\n", frames_in_flight, mean);
+    fprintf(stderr, "%llu frames x %u: offline %.0f ns/frame with %u frames in flight\n",
+            (unsigned long long)frame_count, repeat, mean, frames_in_flight);
+
+    return (rendered == frame_count * repeat) ? 0 : 1;
+}
+
+int main(int argc, char **argv)
+{
+    const char *path = NULL;
+    uint32_t repeat = 1u;
+    uint32_t threads = 0u;
+    uint32_t offline = 0u;
+    VirtuaPPUTraceReader *reader;
+    int result;
+    int i;
+
+    for (i = 1; i < argc; ++i) {
+        if (strncmp(argv[i], "--repeat=", 9) == 0) {
+            repeat = (uint32_t)strtoul(argv[i] + 9, NULL, 10);
+        } else if (strncmp(argv[i], "--threads=", 10) == 0) {
+            threads = (uint32_t)strtoul(argv[i] + 10, NULL, 10);
+        } else if (strncmp(argv[i], "--offline=", 10) == 0) {
+            offline = (uint32_t)strtoul(argv[i] + 10, NULL, 10);
+        } else if (path == NULL && argv[i][0] != '-') {
+            path = argv[i];
+        } else {
+            path = NULL;
+            break;
+        }
+    }
+
+    if (path == NULL) {
+        fprintf(stderr, "usage: %s <trace> [--repeat=N] [--threads=N] [--offline=FRAMES_IN_FLIGHT]\n", argv[0]);
+        return 1;
+    }
+    if (repeat == 0u) {
+        repeat = 1u;
+    }
+
+    reader = virtuappu_trace_reader_open(path);
+    if (reader == NULL) {
+        fprintf(stderr, "%s: cannot read trace '%s'\n", argv[0], path);
+        return 1;
+    }
+
+    if (threads != 0u) {
+        VirtuaPPUThreadConfig config = {threads, NULL};
+        virtuappu_thread_pool_configure(&config);
+    }
+
+    if (offline != 0u) {
+        result = replay_offline(path, reader, repeat, offline);
+    } else {
+        result = replay_sequential(path, reader, repeat);
+    }
+
+    virtuappu_trace_reader_close(reader);
+    virtuappu_thread_pool_shutdown();
+    return result;
+}
@@ -0,0 +1,294 @@
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE
+#endif
+
+#include "asset_pack.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "virtuappu.h"
+
+_Static_assert(sizeof(VirtuaPPUAssetPackHeader) == 64u, "asset pack header must stay 64 bytes");
+_Static_assert(sizeof(VirtuaPPUAssetSprite) == 48u, "asset pack sprite records must stay 48 bytes");
+_Static_assert(sizeof(Mode0Palette16Rgb888) == 48u, "asset pack palettes are stored as Mode0Palette16Rgb888");
+
+struct VirtuaPPUAssetPack {
+    const uint8_t *data;
+    size_t size;
+    bool mapped;
+};
+
+const char virtuappu_asset_pack_magic[8] = {'V', 'P', 'P', 'U', 'P', 'A', 'C', 'K'};
+
+static bool asset_pack_section_fits(size_t file_size, uint32_t offset, uint32_t count, size_t element_bytes)
+{
+    return (uint64_t)offset + (uint64_t)count * element_bytes <= (uint64_t)file_size;
+}
+
+static bool asset_pack_is_valid(const uint8_t *data, size_t size)
+{
+    const VirtuaPPUAssetPackHeader *header = (const VirtuaPPUAssetPackHeader *)data;
+    const VirtuaPPUAssetSprite *sprites;
+    const Mode0TileEntry *entries;
+    uint32_t tile_count;
+    uint32_t i;
+
+    if (size < sizeof(*header) || memcmp(header->magic, virtuappu_asset_pack_magic, sizeof(header->magic)) != 0 ||
+        header->version != VIRTUAPPU_ASSET_PACK_VERSION || header->header_bytes != sizeof(*header) ||
+        header->file_bytes != size || header->tile_bytes != VIRTUAPPU_ASSET_PACK_TILE_BYTES ||
+        header->gfx_bytes % VIRTUAPPU_ASSET_PACK_TILE_BYTES != 0u ||
+        header->gfx_offset % VIRTUAPPU_ASSET_PACK_GFX_ALIGN != 0u ||
+        header->palette_offset % VIRTUAPPU_ASSET_PACK_SECTION_ALIGN != 0u ||
+        header->sprite_offset % VIRTUAPPU_ASSET_PACK_SECTION_ALIGN != 0u ||
+        header->entry_offset % VIRTUAPPU_ASSET_PACK_SECTION_ALIGN != 0u) {
+        return false;
+    }
+
+    if (!asset_pack_section_fits(size, header->palette_offset, header->palette_count, sizeof(Mode0Palette16Rgb888)) ||
+        !asset_pack_section_fits(size, header->sprite_offset, header->sprite_count, sizeof(VirtuaPPUAssetSprite)) ||
+        !asset_pack_section_fits(size, header->entry_offset, header->entry_count, sizeof(Mode0TileEntry)) ||
+        !asset_pack_section_fits(size, header->gfx_offset, header->gfx_bytes, 1u)) {
+        return false;
+    }
+
+    /* Records are checked once here so lookups and loads can trust them. */
+    sprites = (const VirtuaPPUAssetSprite *)(data + header->sprite_offset);
+    for (i = 0; i < header->sprite_count; ++i) {
+        if (sprites[i].name[VIRTUAPPU_ASSET_PACK_NAME_BYTES - 1u] != '\0' ||
+            (uint64_t)sprites[i].first_entry + sprites[i].entry_count > header->entry_count ||
+            sprites[i].palette_index >= header->palette_count) {
+            return false;
+        }
+    }
+
+    entries = (const Mode0TileEntry *)(data + header->entry_offset);
+    tile_count = header->gfx_bytes / VIRTUAPPU_ASSET_PACK_TILE_BYTES;
+    for (i = 0; i < header->entry_count; ++i) {
+        if ((entries[i] & 0xFFFFu) >= tile_count) {
+            return false;
+        }
+    }
+
+    /* Hosts point OAM at a contiguous sprite's first tile, so the flag has to hold for every entry. */
+    for (i = 0; i < header->sprite_count; ++i) {
+        const Mode0TileEntry *sprite_entries = entries + sprites[i].first_entry;
+        uint32_t j;
+
+        if ((sprites[i].flags & VIRTUAPPU_ASSET_SPRITE_CONTIGUOUS) == 0u) {
+            continue;
+        }
+        for (j = 0; j < sprites[i].entry_count; ++j) {
+            if ((sprite_entries[j] & 0xFFFFu) != (sprite_entries[0] & 0xFFFFu) + j ||
+                (sprite_entries[j] & (MODE0_TILE_HFLIP | MODE0_TILE_VFLIP)) != 0u) {
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+static bool asset_pack_map(VirtuaPPUAssetPack *pack, const char *path)
+{
+#if defined(_WIN32)
+    FILE *file = fopen(path, "rb");
+    long size;
+    uint8_t *data;
+
+    if (file == NULL) {
+        return false;
+    }
+    if (fseek(file, 0, SEEK_END) != 0 || (size = ftell(file)) <= 0 || fseek(file, 0, SEEK_SET) != 0) {
+        fclose(file);
+        return false;
+    }
+
+    data = (uint8_t *)malloc((size_t)size);
+    if (data == NULL || fread(data, 1u, (size_t)size, file) != (size_t)size) {
+        free(data);
+        fclose(file);
+        return false;
+    }
+
+    fclose(file);
+    pack->data = data;
+    pack->size = (size_t)size;
+    pack->mapped = false;
+    return true;
+#else
+    int fd = open(path, O_RDONLY);
+    struct stat st;
+    void *data;
+
+    if (fd < 0) {
+        return false;
+    }
+    if (fstat(fd, &st) != 0 || st.st_size <= 0) {
+        close(fd);
+        return false;
+    }
+
+    data = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        return false;
+    }
+
+    pack->data = (const uint8_t *)data;
+    pack->size = (size_t)st.st_size;
+    pack->mapped = true;
+    return true;
+#endif
+}
+
+VirtuaPPUAssetPack *virtuappu_asset_pack_open(const char *path)
+{
+    VirtuaPPUAssetPack *pack;
+
+    if (path == NULL) {
+        return NULL;
+    }
+
+    pack = (VirtuaPPUAssetPack *)calloc(1u, sizeof(*pack));
+    if (pack == NULL) {
+        return NULL;
+    }
+
+    if (!asset_pack_map(pack, path)) {
+        free(pack);
+        return NULL;
+    }
+    if (!asset_pack_is_valid(pack->data, pack->size)) {
+        virtuappu_asset_pack_close(pack);
+        return NULL;
+    }
+
+    return pack;
+}
+
+void virtuappu_asset_pack_close(VirtuaPPUAssetPack *pack)
+{
+    if (pack == NULL) {
+        return;
+    }
+
+#if !defined(_WIN32)
+    if (pack->mapped) {
+        munmap((void *)pack->data, pack->size);
+        free(pack);
+        return;
+    }
+#endif
+    free((void *)pack->data);
+    free(pack);
+}
+
+const VirtuaPPUAssetPackHeader *virtuappu_asset_pack_header(const VirtuaPPUAssetPack *pack)
+{
+    return (pack != NULL) ? (const VirtuaPPUAssetPackHeader *)pack->data : NULL;
+}
+
+const uint8_t *virtuappu_asset_pack_gfx(const VirtuaPPUAssetPack *pack)
+{
+    return (pack != NULL) ? pack->data + virtuappu_asset_pack_header(pack)->gfx_offset : NULL;
+}
+
+const Mode0Palette16Rgb888 *virtuappu_asset_pack_palettes(const VirtuaPPUAssetPack *pack)
+{
+    if (pack == NULL) {
+        return NULL;
+    }
+
+    return (const Mode0Palette16Rgb888 *)(pack->data + virtuappu_asset_pack_header(pack)->palette_offset);
+}
+
+const Mode0TileEntry *virtuappu_asset_pack_entries(const VirtuaPPUAssetPack *pack)
+{
+    if (pack == NULL) {
+        return NULL;
+    }
+
+    return (const Mode0TileEntry *)(pack->data + virtuappu_asset_pack_header(pack)->entry_offset);
+}
+
+const VirtuaPPUAssetSprite *virtuappu_asset_pack_sprite(const VirtuaPPUAssetPack *pack, uint32_t sprite_index)
+{
+    const VirtuaPPUAssetPackHeader *header = virtuappu_asset_pack_header(pack);
+
+    if (header == NULL || sprite_index >= header->sprite_count) {
+        return NULL;
+    }
+
+    return (const VirtuaPPUAssetSprite *)(pack->data + header->sprite_offset) + sprite_index;
+}
+
+const VirtuaPPUAssetSprite *virtuappu_asset_pack_find_sprite(const VirtuaPPUAssetPack *pack, const char *name)
+{
+    const VirtuaPPUAssetPackHeader *header = virtuappu_asset_pack_header(pack);
+    uint32_t i;
+
+    if (header == NULL || name == NULL) {
+        return NULL;
+    }
+
+    for (i = 0; i < header->sprite_count; ++i) {
+        const VirtuaPPUAssetSprite *sprite = virtuappu_asset_pack_sprite(pack, i);
+
+        if (strcmp(sprite->name, name) == 0) {
+            return sprite;
+        }
+    }
+
+    return NULL;
+}
+
+bool virtuappu_asset_pack_load_mode0_ctx(
+    VirtuaPPUContext *ctx,
+    const VirtuaPPUAssetPack *pack,
+    size_t gfx_offset,
+    size_t palette_bank_index,
+    size_t palette_index_in_bank)
+{
+    const VirtuaPPUAssetPackHeader *header = virtuappu_asset_pack_header(pack);
+    const Mode0Palette16Rgb888 *palettes;
+    size_t slot;
+    uint32_t i;
+
+    if (ctx == NULL || header == NULL || ctx->vram_size < sizeof(Mode0Layout) ||
+        gfx_offset + header->gfx_bytes > sizeof(((Mode0Layout *)0)->gfx_data) || palette_index_in_bank >= 16u) {
+        return false;
+    }
+
+    slot = palette_bank_index * 16u + palette_index_in_bank;
+    if (slot + header->palette_count > (size_t)MODE0_PALETTE_256_BANKS * 16u) {
+        return false;
+    }
+
+    /* The tile block is already in gfx_data order, so it lands with a single copy out of the mapping. */
+    virtuappu_mode0_set_gfx_data_ctx(ctx, virtuappu_asset_pack_gfx(pack), header->gfx_bytes, gfx_offset);
+    palettes = virtuappu_asset_pack_palettes(pack);
+    for (i = 0; i < header->palette_count; ++i, ++slot) {
+        virtuappu_mode0_set_palette16_ctx(ctx, slot / 16u, slot % 16u, &palettes[i]);
+    }
+
+    ctx->input_hash_valid = false;
+    return true;
+}
+
+bool virtuappu_asset_pack_load_mode0(
+    const VirtuaPPUAssetPack *pack,
+    size_t gfx_offset,
+    size_t palette_bank_index,
+    size_t palette_index_in_bank)
+{
+    return virtuappu_asset_pack_load_mode0_ctx(virtuappu_get_default_context(), pack, gfx_offset, palette_bank_index, palette_index_in_bank);
+}
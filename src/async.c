@@ -0,0 +1,297 @@
+#include "async.h"
+
+#include <pthread.h>
+#include <stdlib.h>
+
+#include "virtuappu.h"
+
+typedef enum AsyncSlotState {
+    ASYNC_SLOT_FREE = 0,
+    ASYNC_SLOT_PENDING = 1,
+    ASYNC_SLOT_READY = 2,
+    ASYNC_SLOT_ACQUIRED = 3
+} AsyncSlotState;
+
+typedef struct AsyncSlot {
+    VirtuaPPUContext *ctx;
+    uint64_t fence;
+    AsyncSlotState state;
+} AsyncSlot;
+
+struct VirtuaPPUAsync {
+    VirtuaPPUContext *source;
+    VirtuaPPUFrameCallback on_frame;
+    void *user;
+    AsyncSlot slots[VIRTUAPPU_ASYNC_MAX_BUFFERS];
+    uint32_t slot_count;
+    uint64_t next_fence;
+    uint64_t completed_fence;
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t work;
+    pthread_cond_t progress;
+    bool stopping;
+};
+
+static AsyncSlot *async_next_pending(VirtuaPPUAsync *async)
+{
+    AsyncSlot *oldest = NULL;
+    uint32_t i;
+
+    for (i = 0; i < async->slot_count; ++i) {
+        AsyncSlot *slot = &async->slots[i];
+        if (slot->state == ASYNC_SLOT_PENDING && (oldest == NULL || slot->fence < oldest->fence)) {
+            oldest = slot;
+        }
+    }
+
+    return oldest;
+}
+
+static AsyncSlot *async_newest_ready(VirtuaPPUAsync *async)
+{
+    AsyncSlot *newest = NULL;
+    uint32_t i;
+
+    for (i = 0; i < async->slot_count; ++i) {
+        AsyncSlot *slot = &async->slots[i];
+        if (slot->state == ASYNC_SLOT_READY && (newest == NULL || slot->fence > newest->fence)) {
+            newest = slot;
+        }
+    }
+
+    return newest;
+}
+
+static AsyncSlot *async_claim_slot(VirtuaPPUAsync *async)
+{
+    AsyncSlot *newest = async_newest_ready(async);
+    uint32_t i;
+
+    for (i = 0; i < async->slot_count; ++i) {
+        if (async->slots[i].state == ASYNC_SLOT_FREE) {
+            return &async->slots[i];
+        }
+    }
+
+    /* Ready frames that were superseded and never acquired are recycled, keeping the newest one. */
+    for (i = 0; i < async->slot_count; ++i) {
+        AsyncSlot *slot = &async->slots[i];
+        if (slot->state == ASYNC_SLOT_READY && slot != newest) {
+            return slot;
+        }
+    }
+
+    /* With nothing in flight the newest frame is about to be superseded anyway. */
+    if (newest != NULL && async_next_pending(async) == NULL) {
+        return newest;
+    }
+
+    return NULL;
+}
+
+static void *async_render_main(void *arg)
+{
+    VirtuaPPUAsync *async = (VirtuaPPUAsync *)arg;
+
+    pthread_mutex_lock(&async->lock);
+    for (;;) {
+        AsyncSlot *slot;
+
+        while ((slot = async_next_pending(async)) == NULL && !async->stopping) {
+            pthread_cond_wait(&async->work, &async->lock);
+        }
+        if (slot == NULL) {
+            break;
+        }
+        pthread_mutex_unlock(&async->lock);
+
+        virtuappu_render_frame_ctx(slot->ctx);
+        if (async->on_frame != NULL) {
+            async->on_frame(async->user, slot->fence, slot->ctx);
+        }
+
+        pthread_mutex_lock(&async->lock);
+        slot->state = ASYNC_SLOT_READY;
+        async->completed_fence = slot->fence;
+        pthread_cond_broadcast(&async->progress);
+    }
+    pthread_mutex_unlock(&async->lock);
+
+    return NULL;
+}
+
+VirtuaPPUAsync *virtuappu_async_create(
+    VirtuaPPUContext *source,
+    uint32_t buffer_count,
+    VirtuaPPUFrameCallback on_frame,
+    void *user)
+{
+    VirtuaPPUAsync *async;
+    uint32_t i;
+
+    if (source == NULL || buffer_count < VIRTUAPPU_ASYNC_MIN_BUFFERS || buffer_count > VIRTUAPPU_ASYNC_MAX_BUFFERS) {
+        return NULL;
+    }
+
+    async = (VirtuaPPUAsync *)calloc(1u, sizeof(*async));
+    if (async == NULL) {
+        return NULL;
+    }
+
+    async->source = source;
+    async->on_frame = on_frame;
+    async->user = user;
+    async->slot_count = buffer_count;
+    for (i = 0; i < buffer_count; ++i) {
+        async->slots[i].ctx = virtuappu_context_create();
+        if (async->slots[i].ctx == NULL) {
+            while (i-- > 0u) {
+                virtuappu_context_destroy(async->slots[i].ctx);
+            }
+            free(async);
+            return NULL;
+        }
+    }
+
+    pthread_mutex_init(&async->lock, NULL);
+    pthread_cond_init(&async->work, NULL);
+    pthread_cond_init(&async->progress, NULL);
+    if (pthread_create(&async->thread, NULL, async_render_main, async) != 0) {
+        for (i = 0; i < buffer_count; ++i) {
+            virtuappu_context_destroy(async->slots[i].ctx);
+        }
+        pthread_cond_destroy(&async->progress);
+        pthread_cond_destroy(&async->work);
+        pthread_mutex_destroy(&async->lock);
+        free(async);
+        return NULL;
+    }
+
+    return async;
+}
+
+void virtuappu_async_destroy(VirtuaPPUAsync *async)
+{
+    uint32_t i;
+
+    if (async == NULL) {
+        return;
+    }
+
+    pthread_mutex_lock(&async->lock);
+    async->stopping = true;
+    pthread_cond_broadcast(&async->work);
+    pthread_mutex_unlock(&async->lock);
+    pthread_join(async->thread, NULL);
+
+    for (i = 0; i < async->slot_count; ++i) {
+        virtuappu_context_destroy(async->slots[i].ctx);
+    }
+    pthread_cond_destroy(&async->progress);
+    pthread_cond_destroy(&async->work);
+    pthread_mutex_destroy(&async->lock);
+    free(async);
+}
+
+uint64_t virtuappu_async_submit(VirtuaPPUAsync *async)
+{
+    AsyncSlot *slot;
+    uint64_t fence;
+
+    if (async == NULL) {
+        return 0u;
+    }
+
+    pthread_mutex_lock(&async->lock);
+    while ((slot = async_claim_slot(async)) == NULL) {
+        pthread_cond_wait(&async->progress, &async->lock);
+    }
+    slot->state = ASYNC_SLOT_ACQUIRED;
+    pthread_mutex_unlock(&async->lock);
+
+    /* The slot is owned by the submitting thread while the snapshot is taken; committed batches land in the
+     * source first, as they would at the start of a synchronous render. */
+    virtuappu_command_queue_apply_ctx(async->source, async->source->command_queue);
+    virtuappu_context_copy_state(slot->ctx, async->source);
+
+    pthread_mutex_lock(&async->lock);
+    fence = ++async->next_fence;
+    slot->fence = fence;
+    slot->state = ASYNC_SLOT_PENDING;
+    pthread_cond_signal(&async->work);
+    pthread_mutex_unlock(&async->lock);
+
+    return fence;
+}
+
+void virtuappu_async_wait(VirtuaPPUAsync *async, uint64_t fence)
+{
+    if (async == NULL) {
+        return;
+    }
+
+    pthread_mutex_lock(&async->lock);
+    if (fence > async->next_fence) {
+        fence = async->next_fence;
+    }
+    while (async->completed_fence < fence) {
+        pthread_cond_wait(&async->progress, &async->lock);
+    }
+    pthread_mutex_unlock(&async->lock);
+}
+
+uint64_t virtuappu_async_completed_fence(VirtuaPPUAsync *async)
+{
+    uint64_t fence;
+
+    if (async == NULL) {
+        return 0u;
+    }
+
+    pthread_mutex_lock(&async->lock);
+    fence = async->completed_fence;
+    pthread_mutex_unlock(&async->lock);
+
+    return fence;
+}
+
+const VirtuaPPUContext *virtuappu_async_acquire_frame(VirtuaPPUAsync *async, uint64_t *fence)
+{
+    AsyncSlot *slot;
+
+    if (async == NULL) {
+        return NULL;
+    }
+
+    pthread_mutex_lock(&async->lock);
+    slot = async_newest_ready(async);
+    if (slot != NULL) {
+        slot->state = ASYNC_SLOT_ACQUIRED;
+        if (fence != NULL) {
+            *fence = slot->fence;
+        }
+    }
+    pthread_mutex_unlock(&async->lock);
+
+    return (slot != NULL) ? slot->ctx : NULL;
+}
+
+void virtuappu_async_release_frame(VirtuaPPUAsync *async, const VirtuaPPUContext *frame)
+{
+    uint32_t i;
+
+    if (async == NULL || frame == NULL) {
+        return;
+    }
+
+    pthread_mutex_lock(&async->lock);
+    for (i = 0; i < async->slot_count; ++i) {
+        if (async->slots[i].ctx == frame && async->slots[i].state == ASYNC_SLOT_ACQUIRED) {
+            async->slots[i].state = ASYNC_SLOT_FREE;
+            pthread_cond_broadcast(&async->progress);
+            break;
+        }
+    }
+    pthread_mutex_unlock(&async->lock);
+}
@@ -0,0 +1,388 @@
+#include "command_queue.h"
+
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "virtuappu.h"
+
+enum {
+    COMMAND_QUEUE_ALIGN = 8u,
+    COMMAND_QUEUE_CACHE_LINE = 64u
+};
+
+typedef enum CommandType {
+    COMMAND_PAD,
+    COMMAND_PALETTE16,
+    COMMAND_PALETTE256,
+    COMMAND_GFX_DATA,
+    COMMAND_TILEMAP_ENTRY,
+    COMMAND_BG_ENTRY,
+    COMMAND_OAM_ENTRY,
+    COMMAND_PPU_REGS,
+    COMMAND_BG_LINE_SCROLL,
+    COMMAND_BG_LINE_AFFINE,
+    COMMAND_BG_RING,
+    COMMAND_BG_WORLD_ORIGIN,
+    COMMAND_RING_ROW,
+    COMMAND_RING_COLUMN
+} CommandType;
+
+typedef struct CommandHeader {
+    uint32_t type;
+    uint32_t size;
+} CommandHeader;
+
+typedef struct CommandIndexed {
+    uint32_t index;
+    uint32_t sub_index;
+} CommandIndexed;
+
+typedef struct CommandWorldOrigin {
+    uint32_t bg_index;
+    int32_t world_x;
+    int32_t world_y;
+} CommandWorldOrigin;
+
+typedef struct CommandRingLine {
+    uint32_t bg_index;
+    int32_t tile_x;
+    int32_t tile_y;
+    uint32_t count;
+} CommandRingLine;
+
+/* The producer and consumer cursors sit on separate cache lines so neither side bounces the other's. */
+struct VirtuaPPUCommandQueue {
+    uint8_t *buffer;
+    size_t capacity;
+    size_t write;
+    uint8_t pad0[COMMAND_QUEUE_CACHE_LINE];
+    atomic_size_t committed;
+    uint8_t pad1[COMMAND_QUEUE_CACHE_LINE - sizeof(atomic_size_t)];
+    atomic_size_t read;
+    uint8_t pad2[COMMAND_QUEUE_CACHE_LINE - sizeof(atomic_size_t)];
+};
+
+static uint32_t command_queue_index(size_t index)
+{
+    /* Out-of-range indices stay out of range, so the setter rejects them when the command is applied. */
+    return (index > UINT32_MAX) ? UINT32_MAX : (uint32_t)index;
+}
+
+static bool command_queue_push(
+    VirtuaPPUCommandQueue *queue,
+    CommandType type,
+    const void *args,
+    size_t args_size,
+    const void *data,
+    size_t data_size)
+{
+    size_t size = (sizeof(CommandHeader) + args_size + data_size + COMMAND_QUEUE_ALIGN - 1u) & ~(size_t)(COMMAND_QUEUE_ALIGN - 1u);
+    size_t offset;
+    size_t tail_room;
+    size_t needed;
+    CommandHeader *header;
+
+    if (queue == NULL || size > queue->capacity) {
+        return false;
+    }
+
+    /* A command never wraps: when it does not fit before the end, the tail is skipped with a pad. */
+    offset = queue->write & (queue->capacity - 1u);
+    tail_room = queue->capacity - offset;
+    needed = size + ((tail_room < size) ? tail_room : 0u);
+    if (queue->write - atomic_load_explicit(&queue->read, memory_order_acquire) + needed > queue->capacity) {
+        return false;
+    }
+
+    if (tail_room < size) {
+        header = (CommandHeader *)(queue->buffer + offset);
+        header->type = COMMAND_PAD;
+        header->size = (uint32_t)tail_room;
+        queue->write += tail_room;
+        offset = 0u;
+    }
+
+    header = (CommandHeader *)(queue->buffer + offset);
+    header->type = (uint32_t)type;
+    header->size = (uint32_t)size;
+    memcpy(header + 1, args, args_size);
+    if (data_size != 0u) {
+        memcpy((uint8_t *)(header + 1) + args_size, data, data_size);
+    }
+    queue->write += size;
+    return true;
+}
+
+static void command_queue_execute(VirtuaPPUContext *ctx, const CommandHeader *header)
+{
+    const uint8_t *args = (const uint8_t *)(header + 1);
+    const CommandIndexed *indexed = (const CommandIndexed *)args;
+    const uint8_t *value = args + sizeof(CommandIndexed);
+
+    switch ((CommandType)header->type) {
+    case COMMAND_PALETTE16:
+        virtuappu_mode0_set_palette16_ctx(ctx, indexed->index, indexed->sub_index, (const Mode0Palette16Rgb888 *)value);
+        break;
+    case COMMAND_PALETTE256:
+        virtuappu_mode0_set_palette256_ctx(ctx, indexed->index, (const Mode0Palette256Rgb888 *)value);
+        break;
+    case COMMAND_GFX_DATA:
+        virtuappu_mode0_set_gfx_data_ctx(ctx, value, indexed->sub_index, indexed->index);
+        break;
+    case COMMAND_TILEMAP_ENTRY:
+        virtuappu_mode0_set_tilemap_entry_ctx(ctx, indexed->index, indexed->sub_index, *(const Mode0TileEntry *)value);
+        break;
+    case COMMAND_BG_ENTRY:
+        virtuappu_mode0_set_bg_entry_ctx(ctx, indexed->index, (const Mode0BgEntry *)value);
+        break;
+    case COMMAND_OAM_ENTRY:
+        virtuappu_mode0_set_oam_entry_ctx(ctx, indexed->index, (const Mode0OAMEntry *)value);
+        break;
+    case COMMAND_PPU_REGS:
+        virtuappu_mode0_set_ppu_regs_ctx(ctx, (const Mode0PPURegs *)value);
+        break;
+    case COMMAND_BG_LINE_SCROLL:
+        virtuappu_mode0_set_bg_line_scroll_ctx(ctx, indexed->index, indexed->sub_index, (const Mode0LineScroll *)value);
+        break;
+    case COMMAND_BG_LINE_AFFINE:
+        virtuappu_mode0_set_bg_line_affine_tx_ty_ctx(ctx, indexed->index, indexed->sub_index, (const Mode0LineAffineTxTy *)value);
+        break;
+    case COMMAND_BG_RING:
+        virtuappu_mode0_set_bg_ring_ctx(ctx, indexed->index, (const Mode0BgRing *)value);
+        break;
+    case COMMAND_BG_WORLD_ORIGIN: {
+        const CommandWorldOrigin *origin = (const CommandWorldOrigin *)args;
+
+        virtuappu_mode0_set_bg_world_origin_ctx(ctx, origin->bg_index, origin->world_x, origin->world_y);
+        break;
+    }
+    case COMMAND_RING_ROW:
+    case COMMAND_RING_COLUMN: {
+        const CommandRingLine *line = (const CommandRingLine *)args;
+        const Mode0TileEntry *entries = (const Mode0TileEntry *)(args + sizeof(CommandRingLine));
+
+        if (header->type == COMMAND_RING_ROW) {
+            virtuappu_mode0_set_ring_row_ctx(ctx, line->bg_index, line->tile_x, line->tile_y, entries, line->count);
+        } else {
+            virtuappu_mode0_set_ring_column_ctx(ctx, line->bg_index, line->tile_x, line->tile_y, entries, line->count);
+        }
+        break;
+    }
+    case COMMAND_PAD:
+    default:
+        break;
+    }
+}
+
+VirtuaPPUCommandQueue *virtuappu_command_queue_create(size_t capacity_bytes)
+{
+    VirtuaPPUCommandQueue *queue;
+    size_t capacity = VIRTUAPPU_COMMAND_QUEUE_MIN_BYTES;
+
+    if (capacity_bytes == 0u) {
+        capacity_bytes = VIRTUAPPU_COMMAND_QUEUE_DEFAULT_BYTES;
+    }
+    if (capacity_bytes > UINT32_MAX) {
+        return NULL;
+    }
+    while (capacity < capacity_bytes) {
+        capacity <<= 1u;
+    }
+
+    queue = (VirtuaPPUCommandQueue *)calloc(1u, sizeof(*queue));
+    if (queue == NULL) {
+        return NULL;
+    }
+
+    queue->buffer = (uint8_t *)malloc(capacity);
+    if (queue->buffer == NULL) {
+        free(queue);
+        return NULL;
+    }
+
+    queue->capacity = capacity;
+    atomic_init(&queue->committed, 0u);
+    atomic_init(&queue->read, 0u);
+    return queue;
+}
+
+void virtuappu_command_queue_destroy(VirtuaPPUCommandQueue *queue)
+{
+    if (queue == NULL) {
+        return;
+    }
+
+    free(queue->buffer);
+    free(queue);
+}
+
+void virtuappu_command_queue_commit(VirtuaPPUCommandQueue *queue)
+{
+    if (queue == NULL) {
+        return;
+    }
+
+    atomic_store_explicit(&queue->committed, queue->write, memory_order_release);
+}
+
+void virtuappu_command_queue_discard(VirtuaPPUCommandQueue *queue)
+{
+    if (queue == NULL) {
+        return;
+    }
+
+    /* Only the producer moves committed, so it can be read back without ordering. */
+    queue->write = atomic_load_explicit(&queue->committed, memory_order_relaxed);
+}
+
+size_t virtuappu_command_queue_apply_ctx(VirtuaPPUContext *ctx, VirtuaPPUCommandQueue *queue)
+{
+    size_t end;
+    size_t read;
+    size_t applied = 0u;
+
+    if (ctx == NULL || queue == NULL) {
+        return 0u;
+    }
+
+    /* Only whole committed batches are visible here, so a render never sees half of a game update. */
+    end = atomic_load_explicit(&queue->committed, memory_order_acquire);
+    read = atomic_load_explicit(&queue->read, memory_order_relaxed);
+    while (read != end) {
+        const CommandHeader *header = (const CommandHeader *)(queue->buffer + (read & (queue->capacity - 1u)));
+
+        if (header->type != COMMAND_PAD) {
+            command_queue_execute(ctx, header);
+            ++applied;
+        }
+        read += header->size;
+    }
+
+    atomic_store_explicit(&queue->read, read, memory_order_release);
+    return applied;
+}
+
+size_t virtuappu_command_queue_apply(VirtuaPPUCommandQueue *queue)
+{
+    return virtuappu_command_queue_apply_ctx(virtuappu_get_default_context(), queue);
+}
+
+void virtuappu_set_command_queue_ctx(VirtuaPPUContext *ctx, VirtuaPPUCommandQueue *queue)
+{
+    if (ctx == NULL) {
+        return;
+    }
+
+    ctx->command_queue = queue;
+}
+
+void virtuappu_set_command_queue(VirtuaPPUCommandQueue *queue)
+{
+    virtuappu_set_command_queue_ctx(virtuappu_get_default_context(), queue);
+}
+
+bool virtuappu_command_queue_set_palette16(VirtuaPPUCommandQueue *queue, size_t palette_bank_index, size_t palette_index_in_bank, const Mode0Palette16Rgb888 *palette)
+{
+    CommandIndexed args = {command_queue_index(palette_bank_index), command_queue_index(palette_index_in_bank)};
+
+    return palette != NULL && command_queue_push(queue, COMMAND_PALETTE16, &args, sizeof(args), palette, sizeof(*palette));
+}
+
+bool virtuappu_command_queue_set_palette256(VirtuaPPUCommandQueue *queue, size_t palette_bank_index, const Mode0Palette256Rgb888 *palette)
+{
+    CommandIndexed args = {command_queue_index(palette_bank_index), 0u};
+
+    return palette != NULL && command_queue_push(queue, COMMAND_PALETTE256, &args, sizeof(args), palette, sizeof(*palette));
+}
+
+bool virtuappu_command_queue_set_gfx_data(VirtuaPPUCommandQueue *queue, const uint8_t *data, size_t size, size_t offset)
+{
+    CommandIndexed args = {command_queue_index(offset), command_queue_index(size)};
+
+    return data != NULL && size <= UINT32_MAX && command_queue_push(queue, COMMAND_GFX_DATA, &args, sizeof(args), data, size);
+}
+
+bool virtuappu_command_queue_set_tilemap_entry(VirtuaPPUCommandQueue *queue, size_t bg_index, size_t entry_index, Mode0TileEntry entry)
+{
+    CommandIndexed args = {command_queue_index(bg_index), command_queue_index(entry_index)};
+
+    return command_queue_push(queue, COMMAND_TILEMAP_ENTRY, &args, sizeof(args), &entry, sizeof(entry));
+}
+
+bool virtuappu_command_queue_set_bg_entry(VirtuaPPUCommandQueue *queue, size_t bg_index, const Mode0BgEntry *bg_entry)
+{
+    CommandIndexed args = {command_queue_index(bg_index), 0u};
+
+    return bg_entry != NULL && command_queue_push(queue, COMMAND_BG_ENTRY, &args, sizeof(args), bg_entry, sizeof(*bg_entry));
+}
+
+bool virtuappu_command_queue_set_oam_entry(VirtuaPPUCommandQueue *queue, size_t oam_index, const Mode0OAMEntry *oam_entry)
+{
+    CommandIndexed args = {command_queue_index(oam_index), 0u};
+
+    return oam_entry != NULL && command_queue_push(queue, COMMAND_OAM_ENTRY, &args, sizeof(args), oam_entry, sizeof(*oam_entry));
+}
+
+bool virtuappu_command_queue_set_ppu_regs(VirtuaPPUCommandQueue *queue, const Mode0PPURegs *regs)
+{
+    CommandIndexed args = {0u, 0u};
+
+    return regs != NULL && command_queue_push(queue, COMMAND_PPU_REGS, &args, sizeof(args), regs, sizeof(*regs));
+}
+
+bool virtuappu_command_queue_set_bg_line_scroll(VirtuaPPUCommandQueue *queue, size_t bg_index, size_t line_index, const Mode0LineScroll *line_scroll)
+{
+    CommandIndexed args = {command_queue_index(bg_index), command_queue_index(line_index)};
+
+    return line_scroll != NULL && command_queue_push(queue, COMMAND_BG_LINE_SCROLL, &args, sizeof(args), line_scroll, sizeof(*line_scroll));
+}
+
+bool virtuappu_command_queue_set_bg_line_affine_tx_ty(VirtuaPPUCommandQueue *queue, size_t bg_index, size_t line_index, const Mode0LineAffineTxTy *line_affine)
+{
+    CommandIndexed args = {command_queue_index(bg_index), command_queue_index(line_index)};
+
+    return line_affine != NULL && command_queue_push(queue, COMMAND_BG_LINE_AFFINE, &args, sizeof(args), line_affine, sizeof(*line_affine));
+}
+
+bool virtuappu_command_queue_set_bg_ring(VirtuaPPUCommandQueue *queue, size_t bg_index, const Mode0BgRing *ring)
+{
+    CommandIndexed args = {command_queue_index(bg_index), 0u};
+
+    return ring != NULL && command_queue_push(queue, COMMAND_BG_RING, &args, sizeof(args), ring, sizeof(*ring));
+}
+
+bool virtuappu_command_queue_set_bg_world_origin(VirtuaPPUCommandQueue *queue, size_t bg_index, int32_t world_x, int32_t world_y)
+{
+    CommandWorldOrigin args = {command_queue_index(bg_index), world_x, world_y};
+
+    return command_queue_push(queue, COMMAND_BG_WORLD_ORIGIN, &args, sizeof(args), NULL, 0u);
+}
+
+bool virtuappu_command_queue_set_ring_row(
+    VirtuaPPUCommandQueue *queue,
+    size_t bg_index,
+    int32_t tile_x,
+    int32_t tile_y,
+    const Mode0TileEntry *entries,
+    size_t count)
+{
+    CommandRingLine args = {command_queue_index(bg_index), tile_x, tile_y, command_queue_index(count)};
+
+    return entries != NULL && count <= MODE0_TILEMAP_ENTRIES_PER_BG &&
+           command_queue_push(queue, COMMAND_RING_ROW, &args, sizeof(args), entries, count * sizeof(*entries));
+}
+
+bool virtuappu_command_queue_set_ring_column(
+    VirtuaPPUCommandQueue *queue,
+    size_t bg_index,
+    int32_t tile_x,
+    int32_t tile_y,
+    const Mode0TileEntry *entries,
+    size_t count)
+{
+    CommandRingLine args = {command_queue_index(bg_index), tile_x, tile_y, command_queue_index(count)};
+
+    return entries != NULL && count <= MODE0_TILEMAP_ENTRIES_PER_BG &&
+           command_queue_push(queue, COMMAND_RING_COLUMN, &args, sizeof(args), entries, count * sizeof(*entries));
+}
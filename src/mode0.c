@@ -2,14 +2,25 @@
 
 #include <string.h>
 
+#include "thread_pool.h"
 #include "virtuappu.h"
 
+enum {
+    MODE0_LINE_GRAIN = 8u
+};
+
+typedef struct Mode0LineRangeTask {
+    VirtuaPPUContext *ctx;
+    const PPUMemory *ppu;
+    size_t first_line;
+} Mode0LineRangeTask;
+
 _Static_assert(sizeof(Mode0Layout) <= MODE0_VRAM_MAX_BYTES, "Mode0Layout exceeds 4MB");
 _Static_assert(sizeof(Mode0TileEntry) == 4u, "Mode0TileEntry must stay 32-bit");
 
-static Mode0Layout *mode0_get_layout(void)
+static Mode0Layout *mode0_get_layout(const VirtuaPPUContext *ctx)
 {
-    return (Mode0Layout *)virtuappu_vram;
+    return (ctx->vram_size >= sizeof(Mode0Layout)) ? (Mode0Layout *)ctx->vram : NULL;
 }
 
 Mode0TileEntry mode0_make_tile_entry(
@@ -28,108 +39,168 @@ Mode0TileEntry mode0_make_tile_entry(
            (mosaic_enable ? MODE0_TILE_MOSAIC : 0u);
 }
 
-void virtuappu_mode0_set_palette16(size_t palette_bank_index, size_t palette_index_in_bank, const Mode0Palette16Rgb888 *palette)
+static size_t mode0_ring_wrap(int32_t value, uint16_t size)
+{
+    int32_t wrapped = value % (int32_t)size;
+
+    return (size_t)((wrapped < 0) ? wrapped + (int32_t)size : wrapped);
+}
+
+/* Ring maps are a torus: world tile coordinates wrap on the map size, so a scrolling camera only ever
+ * rewrites the column or row it just exposed. */
+size_t mode0_ring_entry_index(const Mode0BgRing *ring, int32_t tile_x, int32_t tile_y)
+{
+    if (ring == NULL || ring->width_tiles == 0u || ring->height_tiles == 0u) {
+        return 0u;
+    }
+
+    return mode0_ring_wrap(tile_y, ring->height_tiles) * ring->width_tiles + mode0_ring_wrap(tile_x, ring->width_tiles);
+}
+
+static bool mode0_ring_is_valid(const Mode0BgRing *ring)
+{
+    return ring->width_tiles != 0u && ring->height_tiles != 0u &&
+           (size_t)ring->width_tiles * ring->height_tiles <= MODE0_TILEMAP_ENTRIES_PER_BG;
+}
+
+void virtuappu_mode0_set_palette16_ctx(VirtuaPPUContext *ctx, size_t palette_bank_index, size_t palette_index_in_bank, const Mode0Palette16Rgb888 *palette)
 {
-    Mode0Layout *layout = mode0_get_layout();
+    Mode0Layout *layout;
 
-    if (palette == NULL || palette_bank_index >= MODE0_PALETTE_256_BANKS || palette_index_in_bank >= 16u) {
+    if (ctx == NULL || palette == NULL || palette_bank_index >= MODE0_PALETTE_256_BANKS || palette_index_in_bank >= 16u) {
         return;
     }
 
+    layout = mode0_get_layout(ctx);
+    if (layout == NULL) {
+        return;
+    }
     layout->palettes[palette_bank_index].palettes[palette_index_in_bank] = *palette;
 }
 
-void virtuappu_mode0_set_palette256(size_t palette_bank_index, const Mode0Palette256Rgb888 *palette)
+void virtuappu_mode0_set_palette256_ctx(VirtuaPPUContext *ctx, size_t palette_bank_index, const Mode0Palette256Rgb888 *palette)
 {
-    Mode0Layout *layout = mode0_get_layout();
+    Mode0Layout *layout;
 
-    if (palette == NULL || palette_bank_index >= MODE0_PALETTE_256_BANKS) {
+    if (ctx == NULL || palette == NULL || palette_bank_index >= MODE0_PALETTE_256_BANKS) {
         return;
     }
 
+    layout = mode0_get_layout(ctx);
+    if (layout == NULL) {
+        return;
+    }
     layout->palettes[palette_bank_index] = *palette;
 }
 
-void virtuappu_mode0_set_gfx_data(const uint8_t *data, size_t size, size_t offset)
+void virtuappu_mode0_set_gfx_data_ctx(VirtuaPPUContext *ctx, const uint8_t *data, size_t size, size_t offset)
 {
-    Mode0Layout *layout = mode0_get_layout();
+    Mode0Layout *layout;
 
-    if (data == NULL || offset + size > sizeof(layout->gfx_data)) {
+    if (ctx == NULL || data == NULL || offset + size > sizeof(layout->gfx_data)) {
         return;
     }
 
+    layout = mode0_get_layout(ctx);
+    if (layout == NULL) {
+        return;
+    }
     memcpy(&layout->gfx_data[offset], data, size);
 }
 
-void virtuappu_mode0_set_tilemap_entry(size_t bg_index, size_t entry_index, Mode0TileEntry entry)
+void virtuappu_mode0_set_tilemap_entry_ctx(VirtuaPPUContext *ctx, size_t bg_index, size_t entry_index, Mode0TileEntry entry)
 {
-    Mode0Layout *layout = mode0_get_layout();
+    Mode0Layout *layout;
 
-    if (bg_index >= MODE0_BG_COUNT || entry_index >= MODE0_TILEMAP_ENTRIES_PER_BG) {
+    if (ctx == NULL || bg_index >= MODE0_BG_COUNT || entry_index >= MODE0_TILEMAP_ENTRIES_PER_BG) {
         return;
     }
 
+    layout = mode0_get_layout(ctx);
+    if (layout == NULL) {
+        return;
+    }
     layout->tilemaps[bg_index][entry_index] = entry;
 }
 
-void virtuappu_mode0_set_bg_entry(size_t bg_index, const Mode0BgEntry *bg_entry)
+void virtuappu_mode0_set_bg_entry_ctx(VirtuaPPUContext *ctx, size_t bg_index, const Mode0BgEntry *bg_entry)
 {
-    Mode0Layout *layout = mode0_get_layout();
+    Mode0Layout *layout;
 
-    if (bg_entry == NULL || bg_index >= MODE0_BG_COUNT) {
+    if (ctx == NULL || bg_entry == NULL || bg_index >= MODE0_BG_COUNT) {
         return;
     }
 
+    layout = mode0_get_layout(ctx);
+    if (layout == NULL) {
+        return;
+    }
     layout->bg[bg_index] = *bg_entry;
 }
 
-void virtuappu_mode0_set_oam_entry(size_t oam_index, const Mode0OAMEntry *oam_entry)
+void virtuappu_mode0_set_oam_entry_ctx(VirtuaPPUContext *ctx, size_t oam_index, const Mode0OAMEntry *oam_entry)
 {
-    Mode0Layout *layout = mode0_get_layout();
+    Mode0Layout *layout;
 
-    if (oam_entry == NULL || oam_index >= MODE0_OAM_COUNT) {
+    if (ctx == NULL || oam_entry == NULL || oam_index >= MODE0_OAM_COUNT) {
         return;
     }
 
+    layout = mode0_get_layout(ctx);
+    if (layout == NULL) {
+        return;
+    }
     layout->oam[oam_index] = *oam_entry;
 }
 
-void virtuappu_mode0_set_ppu_regs(const Mode0PPURegs *regs)
+void virtuappu_mode0_set_ppu_regs_ctx(VirtuaPPUContext *ctx, const Mode0PPURegs *regs)
 {
-    Mode0Layout *layout = mode0_get_layout();
+    Mode0Layout *layout;
 
-    if (regs == NULL) {
+    if (ctx == NULL || regs == NULL) {
         return;
     }
 
+    layout = mode0_get_layout(ctx);
+    if (layout == NULL) {
+        return;
+    }
     layout->regs = *regs;
 }
 
-void virtuappu_mode0_set_bg_line_scroll(size_t bg_index, size_t line_index, const Mode0LineScroll *line_scroll)
+void virtuappu_mode0_set_bg_line_scroll_ctx(VirtuaPPUContext *ctx, size_t bg_index, size_t line_index, const Mode0LineScroll *line_scroll)
 {
-    Mode0Layout *layout = mode0_get_layout();
+    Mode0Layout *layout;
 
-    if (line_scroll == NULL || bg_index >= MODE0_BG_COUNT || line_index >= MODE0_MAX_LINES) {
+    if (ctx == NULL || line_scroll == NULL || bg_index >= MODE0_BG_COUNT || line_index >= MODE0_MAX_LINES) {
         return;
     }
 
+    layout = mode0_get_layout(ctx);
+    if (layout == NULL) {
+        return;
+    }
     layout->bg_line_scroll[bg_index][line_index] = *line_scroll;
 }
 
-void virtuappu_mode0_set_bg_line_affine_tx_ty(size_t bg_index, size_t line_index, const Mode0LineAffineTxTy *line_affine)
+void virtuappu_mode0_set_bg_line_affine_tx_ty_ctx(VirtuaPPUContext *ctx, size_t bg_index, size_t line_index, const Mode0LineAffineTxTy *line_affine)
 {
-    Mode0Layout *layout = mode0_get_layout();
+    Mode0Layout *layout;
 
-    if (line_affine == NULL || bg_index >= MODE0_BG_COUNT || line_index >= MODE0_MAX_LINES) {
+    if (ctx == NULL || line_affine == NULL || bg_index >= MODE0_BG_COUNT || line_index >= MODE0_MAX_LINES) {
         return;
     }
 
+    layout = mode0_get_layout(ctx);
+    if (layout == NULL) {
+        return;
+    }
     layout->bg_line_affine[bg_index][line_index] = *line_affine;
 }
 
-static void mode0_get_bg_32px(uint8_t bg_index, size_t line, size_t x_pixel_offset, uint32_t *out_pixels)
+static void mode0_get_bg_32px(const VirtuaPPUContext *ctx, uint8_t bg_index, size_t line, size_t x_pixel_offset, uint32_t *out_pixels)
 {
-    Mode0Layout *layout = mode0_get_layout();
+    const Mode0Layout *layout = mode0_get_layout(ctx);
     int32_t sx;
     int32_t sy;
     size_t i;
@@ -149,7 +220,7 @@ static void mode0_get_bg_32px(uint8_t bg_index, size_t line, size_t x_pixel_offs
     }
 }
 
-static void mode0_render_bg(uint8_t index, uint64_t *opaque_mask, uint32_t *scanline_layers, const PPUMemory *ppu, size_t line)
+static void mode0_render_bg(const VirtuaPPUContext *ctx, uint8_t index, uint64_t *opaque_mask, uint32_t *scanline_layers, const PPUMemory *ppu, size_t line)
 {
     const size_t width = (size_t)ppu->frame_width;
     const size_t block_count = (width + 31u) / 32u;
@@ -165,10 +236,12 @@ static void mode0_render_bg(uint8_t index, uint64_t *opaque_mask, uint32_t *scan
         size_t i;
 
         if (block < 64u && ((*opaque_mask & bit) != 0u)) {
+            VIRTUAPPU_STATS_ADD(ctx, line, opaque_blocks_skipped, 1u);
             continue;
         }
 
-        mode0_get_bg_32px(index, line, x0, dst);
+        mode0_get_bg_32px(ctx, index, line, x0, dst);
+        VIRTUAPPU_STATS_ADD(ctx, line, tiles_fetched, (count + 7u) / 8u);
 
         for (i = 0; i < count; ++i) {
             any_not_opaque |= (dst[i] & 0xFF000000u) ^ 0xFF000000u;
@@ -180,45 +253,284 @@ static void mode0_render_bg(uint8_t index, uint64_t *opaque_mask, uint32_t *scan
     }
 }
 
-static void mode0_composite_and_oam(const uint32_t *scanline_layers, const PPUMemory *ppu, size_t line)
+static void mode0_composite_and_oam(VirtuaPPUContext *ctx, const uint32_t *scanline_layers, const PPUMemory *ppu, size_t line)
 {
     const size_t width = (size_t)ppu->frame_width;
     const uint32_t *bg0 = &scanline_layers[0];
-    size_t x;
 
-    for (x = 0; x < width; ++x) {
-        virtuappu_frame_buffer[line * width + x] = bg0[x];
+    virtuappu_write_line(ctx, line, bg0, width);
+}
+
+static bool mode0_frame_is_valid(const VirtuaPPUContext *ctx, const PPUMemory *ppu)
+{
+    return ppu != NULL && ppu->frame_width != 0u && ppu->frame_width <= VIRTUAPPU_MAX_FRAME_WIDTH &&
+           virtuappu_context_supports_mode(ctx, 0u);
+}
+
+static void mode0_render_line(VirtuaPPUContext *ctx, const PPUMemory *ppu, size_t line)
+{
+    const size_t width = (size_t)ppu->frame_width;
+    const size_t padded_width = width + (width % 32u);
+    uint32_t scanline_layers[MODE0_BG_COUNT * (VIRTUAPPU_MAX_FRAME_WIDTH + 31u)];
+    uint64_t opaque_mask = 0u;
+    uint8_t bg_index;
+    VIRTUAPPU_STATS_TIMER(timer);
+
+    memset(scanline_layers, 0, sizeof(uint32_t) * MODE0_BG_COUNT * padded_width);
+
+    for (bg_index = 0; bg_index < MODE0_BG_COUNT; ++bg_index) {
+        mode0_render_bg(ctx, bg_index, &opaque_mask, scanline_layers, ppu, line);
     }
+    VIRTUAPPU_STATS_LAP(ctx, line, VIRTUAPPU_STATS_STAGE_BG, timer);
+
+    mode0_composite_and_oam(ctx, scanline_layers, ppu, line);
 }
 
-void virtuappu_mode0_render_frame(const PPUMemory *ppu)
+static void mode0_render_line_range(void *user, size_t begin, size_t end)
+{
+    const Mode0LineRangeTask *task = (const Mode0LineRangeTask *)user;
+    size_t line;
+
+    for (line = task->first_line + begin; line < task->first_line + end; ++line) {
+        mode0_render_line(task->ctx, task->ppu, line);
+    }
+}
+
+static void mode0_render_task_lines(Mode0LineRangeTask *task, size_t line_count)
+{
+    /* Indexed targets assign palette slots in scanline order, so their lines are written serially. */
+    if (virtuappu_pixel_format_is_indexed(task->ctx->target.format)) {
+        mode0_render_line_range(task, 0u, line_count);
+    } else {
+        virtuappu_parallel_for(line_count, MODE0_LINE_GRAIN, mode0_render_line_range, task);
+    }
+}
+
+static void mode0_render_frame(VirtuaPPUContext *ctx, const PPUMemory *ppu)
+{
+    Mode0LineRangeTask task;
+
+    if (!mode0_frame_is_valid(ctx, ppu)) {
+        return;
+    }
+
+    task.ctx = ctx;
+    task.ppu = ppu;
+    task.first_line = 0u;
+    VIRTUAPPU_STATS_BEGIN_FRAME(ctx, MODE0_MAX_LINES);
+    virtuappu_virtual_tiles_begin_frame_ctx(ctx);
+    mode0_render_task_lines(&task, MODE0_MAX_LINES);
+    VIRTUAPPU_STATS_END_FRAME(ctx);
+}
+
+void virtuappu_mode0_render_lines_ctx(VirtuaPPUContext *ctx, size_t first_line, size_t end_line)
+{
+    Mode0LineRangeTask task;
+
+    if (ctx == NULL || !mode0_frame_is_valid(ctx, ctx->registers)) {
+        return;
+    }
+
+    if (end_line > MODE0_MAX_LINES) {
+        end_line = MODE0_MAX_LINES;
+    }
+    if (first_line >= end_line) {
+        return;
+    }
+
+    task.ctx = ctx;
+    task.ppu = ctx->registers;
+    task.first_line = first_line;
+    mode0_render_task_lines(&task, end_line - first_line);
+}
+
+void virtuappu_mode0_render_frame_ctx(VirtuaPPUContext *ctx)
+{
+    if (ctx == NULL) {
+        return;
+    }
+
+    mode0_render_frame(ctx, ctx->registers);
+}
+
+void virtuappu_mode0_set_bg_ring_ctx(VirtuaPPUContext *ctx, size_t bg_index, const Mode0BgRing *ring)
+{
+    Mode0Layout *layout;
+
+    if (ctx == NULL || ring == NULL || bg_index >= MODE0_BG_COUNT || !mode0_ring_is_valid(ring)) {
+        return;
+    }
+
+    layout = mode0_get_layout(ctx);
+    if (layout == NULL) {
+        return;
+    }
+    layout->bg_ring[bg_index] = *ring;
+}
+
+void virtuappu_mode0_set_bg_world_origin_ctx(VirtuaPPUContext *ctx, size_t bg_index, int32_t world_x, int32_t world_y)
 {
-    size_t width;
-    size_t padded_width;
-    int line;
+    Mode0Layout *layout;
+
+    if (ctx == NULL || bg_index >= MODE0_BG_COUNT) {
+        return;
+    }
 
-    if (ppu == NULL || ppu->frame_width == 0u || ppu->frame_width > VIRTUAPPU_MAX_FRAME_WIDTH) {
+    layout = mode0_get_layout(ctx);
+    if (layout == NULL) {
         return;
     }
+    layout->bg_ring[bg_index].world_x = world_x;
+    layout->bg_ring[bg_index].world_y = world_y;
+}
 
-    width = (size_t)ppu->frame_width;
-    padded_width = width + (width % 32u);
+void virtuappu_mode0_set_ring_row_ctx(
+    VirtuaPPUContext *ctx,
+    size_t bg_index,
+    int32_t tile_x,
+    int32_t tile_y,
+    const Mode0TileEntry *entries,
+    size_t count)
+{
+    Mode0Layout *layout;
+    const Mode0BgRing *ring;
+    size_t row_base;
+    size_t column;
+    size_t i;
 
-#ifdef USE_OPENMP
-#pragma omp parallel for
-#endif
-    for (line = 0; line < MODE0_MAX_LINES; ++line) {
-        uint32_t scanline_layers[MODE0_BG_COUNT * (VIRTUAPPU_MAX_FRAME_WIDTH + 31u)];
-        uint64_t opaque_mask = 0u;
-        uint8_t bg_index;
-        size_t scanline = (size_t)line;
+    if (ctx == NULL || entries == NULL || bg_index >= MODE0_BG_COUNT) {
+        return;
+    }
 
-        memset(scanline_layers, 0, sizeof(uint32_t) * MODE0_BG_COUNT * padded_width);
+    layout = mode0_get_layout(ctx);
+    if (layout == NULL || !mode0_ring_is_valid(&layout->bg_ring[bg_index])) {
+        return;
+    }
+
+    /* A row longer than the ring would overwrite itself; only the last width_tiles entries survive anyway. */
+    ring = &layout->bg_ring[bg_index];
+    if (count > ring->width_tiles) {
+        entries += count - ring->width_tiles;
+        tile_x += (int32_t)(count - ring->width_tiles);
+        count = ring->width_tiles;
+    }
 
-        for (bg_index = 0; bg_index < MODE0_BG_COUNT; ++bg_index) {
-            mode0_render_bg(bg_index, &opaque_mask, scanline_layers, ppu, scanline);
+    row_base = mode0_ring_wrap(tile_y, ring->height_tiles) * ring->width_tiles;
+    column = mode0_ring_wrap(tile_x, ring->width_tiles);
+    for (i = 0; i < count; ++i) {
+        layout->tilemaps[bg_index][row_base + column] = entries[i];
+        if (++column == ring->width_tiles) {
+            column = 0u;
         }
+    }
+}
 
-        mode0_composite_and_oam(scanline_layers, ppu, scanline);
+void virtuappu_mode0_set_ring_column_ctx(
+    VirtuaPPUContext *ctx,
+    size_t bg_index,
+    int32_t tile_x,
+    int32_t tile_y,
+    const Mode0TileEntry *entries,
+    size_t count)
+{
+    Mode0Layout *layout;
+    const Mode0BgRing *ring;
+    size_t column;
+    size_t row;
+    size_t i;
+
+    if (ctx == NULL || entries == NULL || bg_index >= MODE0_BG_COUNT) {
+        return;
     }
+
+    layout = mode0_get_layout(ctx);
+    if (layout == NULL || !mode0_ring_is_valid(&layout->bg_ring[bg_index])) {
+        return;
+    }
+
+    ring = &layout->bg_ring[bg_index];
+    if (count > ring->height_tiles) {
+        entries += count - ring->height_tiles;
+        tile_y += (int32_t)(count - ring->height_tiles);
+        count = ring->height_tiles;
+    }
+
+    column = mode0_ring_wrap(tile_x, ring->width_tiles);
+    row = mode0_ring_wrap(tile_y, ring->height_tiles);
+    for (i = 0; i < count; ++i) {
+        layout->tilemaps[bg_index][row * ring->width_tiles + column] = entries[i];
+        if (++row == ring->height_tiles) {
+            row = 0u;
+        }
+    }
+}
+
+void virtuappu_mode0_set_palette16(size_t palette_bank_index, size_t palette_index_in_bank, const Mode0Palette16Rgb888 *palette)
+{
+    virtuappu_mode0_set_palette16_ctx(virtuappu_get_default_context(), palette_bank_index, palette_index_in_bank, palette);
+}
+
+void virtuappu_mode0_set_palette256(size_t palette_bank_index, const Mode0Palette256Rgb888 *palette)
+{
+    virtuappu_mode0_set_palette256_ctx(virtuappu_get_default_context(), palette_bank_index, palette);
+}
+
+void virtuappu_mode0_set_gfx_data(const uint8_t *data, size_t size, size_t offset)
+{
+    virtuappu_mode0_set_gfx_data_ctx(virtuappu_get_default_context(), data, size, offset);
+}
+
+void virtuappu_mode0_set_tilemap_entry(size_t bg_index, size_t entry_index, Mode0TileEntry entry)
+{
+    virtuappu_mode0_set_tilemap_entry_ctx(virtuappu_get_default_context(), bg_index, entry_index, entry);
+}
+
+void virtuappu_mode0_set_bg_entry(size_t bg_index, const Mode0BgEntry *bg_entry)
+{
+    virtuappu_mode0_set_bg_entry_ctx(virtuappu_get_default_context(), bg_index, bg_entry);
+}
+
+void virtuappu_mode0_set_oam_entry(size_t oam_index, const Mode0OAMEntry *oam_entry)
+{
+    virtuappu_mode0_set_oam_entry_ctx(virtuappu_get_default_context(), oam_index, oam_entry);
+}
+
+void virtuappu_mode0_set_ppu_regs(const Mode0PPURegs *regs)
+{
+    virtuappu_mode0_set_ppu_regs_ctx(virtuappu_get_default_context(), regs);
+}
+
+void virtuappu_mode0_set_bg_line_scroll(size_t bg_index, size_t line_index, const Mode0LineScroll *line_scroll)
+{
+    virtuappu_mode0_set_bg_line_scroll_ctx(virtuappu_get_default_context(), bg_index, line_index, line_scroll);
+}
+
+void virtuappu_mode0_set_bg_line_affine_tx_ty(size_t bg_index, size_t line_index, const Mode0LineAffineTxTy *line_affine)
+{
+    virtuappu_mode0_set_bg_line_affine_tx_ty_ctx(virtuappu_get_default_context(), bg_index, line_index, line_affine);
+}
+
+void virtuappu_mode0_set_bg_ring(size_t bg_index, const Mode0BgRing *ring)
+{
+    virtuappu_mode0_set_bg_ring_ctx(virtuappu_get_default_context(), bg_index, ring);
+}
+
+void virtuappu_mode0_set_bg_world_origin(size_t bg_index, int32_t world_x, int32_t world_y)
+{
+    virtuappu_mode0_set_bg_world_origin_ctx(virtuappu_get_default_context(), bg_index, world_x, world_y);
+}
+
+void virtuappu_mode0_set_ring_row(size_t bg_index, int32_t tile_x, int32_t tile_y, const Mode0TileEntry *entries, size_t count)
+{
+    virtuappu_mode0_set_ring_row_ctx(virtuappu_get_default_context(), bg_index, tile_x, tile_y, entries, count);
+}
+
+void virtuappu_mode0_set_ring_column(size_t bg_index, int32_t tile_x, int32_t tile_y, const Mode0TileEntry *entries, size_t count)
+{
+    virtuappu_mode0_set_ring_column_ctx(virtuappu_get_default_context(), bg_index, tile_x, tile_y, entries, count);
+}
+
+void virtuappu_mode0_render_frame(const PPUMemory *ppu)
+{
+    mode0_render_frame(virtuappu_get_default_context(), ppu);
 }
@@ -2,6 +2,7 @@
 
 #include <string.h>
 
+#include "simd.h"
 #include "virtuappu.h"
 
 typedef struct Mode1TilemapEntry {
@@ -21,20 +22,57 @@ typedef enum Mode1BlendEffect {
     MODE1_BLEND_DARKEN = 3
 } Mode1BlendEffect;
 
-static uint8_t mode1_default_io_mem[MODE1_IO_MEM_SIZE];
-static uint8_t mode1_default_vram[MODE1_VRAM_SIZE];
-static uint16_t mode1_default_bg_palette[MODE1_PALETTE_COLORS];
-static uint16_t mode1_default_obj_palette[MODE1_PALETTE_COLORS];
-static uint16_t mode1_default_oam_mem[MODE1_OAM_HALFWORDS];
-
-static VirtuaPPUMode1GbaMemory mode1_memory = {
-    mode1_default_io_mem,
-    mode1_default_vram,
-    mode1_default_bg_palette,
-    mode1_default_obj_palette,
-    mode1_default_oam_mem
+typedef struct Mode1LayerColors {
+    const uint32_t (*bg)[MODE1_GBA_WIDTH];
+    const uint32_t *obj;
+} Mode1LayerColors;
+
+typedef struct Mode1TextLine {
+    const uint8_t *vram;
+    uint32_t char_base;
+    uint32_t map_row_base;
+    int map_width_tiles;
+    int first_tile_col;
+    int fine_x;
+    int tile_count;
+    int pixel_y;
+} Mode1TextLine;
+
+typedef struct Mode1ObjSpan {
+    const uint8_t *vram;
+    int obj_x;
+    int first_sx;
+    int last_sx;
+    int obj_width;
+    int obj_height;
+    uint32_t base_tile;
+    uint32_t row_stride;
+    uint32_t col_stride;
+    int tex_y;
+    int half_width;
+    int input_rel_y;
+    int16_t pa;
+    int16_t pb;
+    int16_t pc;
+    int16_t pd;
+    uint16_t palette_base;
+    uint8_t priority;
+} Mode1ObjSpan;
+
+typedef void (*Mode1TextKernel)(const Mode1TextLine *setup, uint16_t *index_buffer);
+typedef void (*Mode1ObjKernel)(const Mode1ObjSpan *span, uint16_t *index_buffer, uint8_t *priority_buffer);
+
+enum {
+    MODE1_TEXT_TILES_PER_LINE = MODE1_GBA_WIDTH / 8 + 1
 };
 
+#if defined(_MSC_VER)
+#define MODE1_FORCE_INLINE __forceinline
+#else
+#define MODE1_FORCE_INLINE inline __attribute__((always_inline))
+#endif
+
+
 static const uint8_t mode1_obj_widths[3][4] = {
     {8, 16, 32, 64},
     {16, 32, 32, 64},
@@ -147,212 +185,308 @@ static bool mode1_is_second_target(uint16_t bldcnt, int layer_id)
     return ((bldcnt >> (layer_id + 8)) & 1u) != 0u;
 }
 
-static uint32_t mode1_alpha_blend(uint32_t top_abgr, uint32_t bottom_abgr, int eva, int evb)
+static Mode1Layout *mode1_get_default_layout(const VirtuaPPUContext *ctx)
 {
-    int top_r = (int)((top_abgr >> 0u) & 0xFFu);
-    int top_g = (int)((top_abgr >> 8u) & 0xFFu);
-    int top_b = (int)((top_abgr >> 16u) & 0xFFu);
-    int bottom_r = (int)((bottom_abgr >> 0u) & 0xFFu);
-    int bottom_g = (int)((bottom_abgr >> 8u) & 0xFFu);
-    int bottom_b = (int)((bottom_abgr >> 16u) & 0xFFu);
-    int out_r = (top_r * eva + bottom_r * evb) / 16;
-    int out_g = (top_g * eva + bottom_g * evb) / 16;
-    int out_b = (top_b * eva + bottom_b * evb) / 16;
+    return (ctx->vram_size >= sizeof(Mode1Layout)) ? (Mode1Layout *)ctx->vram : NULL;
+}
 
-    if (out_r > 255) {
-        out_r = 255;
-    }
-    if (out_g > 255) {
-        out_g = 255;
+void virtuappu_mode1_bind_gba_memory_ctx(VirtuaPPUContext *ctx, const VirtuaPPUMode1GbaMemory *memory)
+{
+    Mode1Layout *defaults;
+
+    if (ctx == NULL) {
+        return;
     }
-    if (out_b > 255) {
-        out_b = 255;
+
+    /* Contexts sized without the fallback layout leave unbound regions NULL; rendering then waits for a full binding. */
+    defaults = mode1_get_default_layout(ctx);
+    if (defaults == NULL) {
+        ctx->mode1_memory.io_mem = (memory != NULL) ? memory->io_mem : NULL;
+        ctx->mode1_memory.vram = (memory != NULL) ? memory->vram : NULL;
+        ctx->mode1_memory.bg_palette = (memory != NULL) ? memory->bg_palette : NULL;
+        ctx->mode1_memory.obj_palette = (memory != NULL) ? memory->obj_palette : NULL;
+        ctx->mode1_memory.oam_mem = (memory != NULL) ? memory->oam_mem : NULL;
+        return;
     }
 
-    return 0xFF000000u | ((uint32_t)out_b << 16u) | ((uint32_t)out_g << 8u) | (uint32_t)out_r;
+    ctx->mode1_memory.io_mem = (memory != NULL && memory->io_mem != NULL) ? memory->io_mem : defaults->io_mem;
+    ctx->mode1_memory.vram = (memory != NULL && memory->vram != NULL) ? memory->vram : defaults->vram;
+    ctx->mode1_memory.bg_palette = (memory != NULL && memory->bg_palette != NULL) ? memory->bg_palette : defaults->bg_palette;
+    ctx->mode1_memory.obj_palette = (memory != NULL && memory->obj_palette != NULL) ? memory->obj_palette : defaults->obj_palette;
+    ctx->mode1_memory.oam_mem = (memory != NULL && memory->oam_mem != NULL) ? memory->oam_mem : defaults->oam_mem;
 }
 
-static uint32_t mode1_brighten(uint32_t abgr, int evy)
+void virtuappu_mode1_get_bound_gba_memory_ctx(const VirtuaPPUContext *ctx, VirtuaPPUMode1GbaMemory *memory)
 {
-    int r = (int)((abgr >> 0u) & 0xFFu);
-    int g = (int)((abgr >> 8u) & 0xFFu);
-    int b = (int)((abgr >> 16u) & 0xFFu);
-
-    r = r + ((255 - r) * evy) / 16;
-    g = g + ((255 - g) * evy) / 16;
-    b = b + ((255 - b) * evy) / 16;
-
-    if (r > 255) {
-        r = 255;
-    }
-    if (g > 255) {
-        g = 255;
-    }
-    if (b > 255) {
-        b = 255;
+    if (ctx == NULL || memory == NULL) {
+        return;
     }
 
-    return 0xFF000000u | ((uint32_t)b << 16u) | ((uint32_t)g << 8u) | (uint32_t)r;
+    *memory = ctx->mode1_memory;
 }
 
-static uint32_t mode1_darken(uint32_t abgr, int evy)
+uint16_t virtuappu_mode1_io_read16_ctx(const VirtuaPPUContext *ctx, uint16_t offset)
 {
-    int r = (int)((abgr >> 0u) & 0xFFu);
-    int g = (int)((abgr >> 8u) & 0xFFu);
-    int b = (int)((abgr >> 16u) & 0xFFu);
-
-    r -= (r * evy) / 16;
-    g -= (g * evy) / 16;
-    b -= (b * evy) / 16;
+    const uint8_t *io_mem = ctx->mode1_memory.io_mem;
 
-    if (r < 0) {
-        r = 0;
-    }
-    if (g < 0) {
-        g = 0;
-    }
-    if (b < 0) {
-        b = 0;
-    }
+    return (uint16_t)io_mem[offset] | ((uint16_t)io_mem[offset + 1u] << 8u);
+}
 
-    return 0xFF000000u | ((uint32_t)b << 16u) | ((uint32_t)g << 8u) | (uint32_t)r;
+uint32_t virtuappu_mode1_io_read32_ctx(const VirtuaPPUContext *ctx, uint16_t offset)
+{
+    return (uint32_t)virtuappu_mode1_io_read16_ctx(ctx, offset) |
+           ((uint32_t)virtuappu_mode1_io_read16_ctx(ctx, (uint16_t)(offset + 2u)) << 16u);
 }
 
-void virtuappu_mode1_bind_gba_memory(const VirtuaPPUMode1GbaMemory *memory)
+uint32_t virtuappu_mode1_rgb555_to_abgr8888(uint16_t color)
 {
-    mode1_memory.io_mem = (memory != NULL && memory->io_mem != NULL) ? memory->io_mem : mode1_default_io_mem;
-    mode1_memory.vram = (memory != NULL && memory->vram != NULL) ? memory->vram : mode1_default_vram;
-    mode1_memory.bg_palette = (memory != NULL && memory->bg_palette != NULL) ? memory->bg_palette : mode1_default_bg_palette;
-    mode1_memory.obj_palette = (memory != NULL && memory->obj_palette != NULL) ? memory->obj_palette : mode1_default_obj_palette;
-    mode1_memory.oam_mem = (memory != NULL && memory->oam_mem != NULL) ? memory->oam_mem : mode1_default_oam_mem;
+    uint8_t r = (uint8_t)((color & 0x1Fu) << 3u);
+    uint8_t g = (uint8_t)(((color >> 5u) & 0x1Fu) << 3u);
+    uint8_t b = (uint8_t)(((color >> 10u) & 0x1Fu) << 3u);
+
+    return 0xFF000000u | ((uint32_t)b << 16u) | ((uint32_t)g << 8u) | (uint32_t)r;
 }
 
-void virtuappu_mode1_get_bound_gba_memory(VirtuaPPUMode1GbaMemory *memory)
+static uint32_t mode1_index_color(const VirtuaPPUContext *ctx, uint16_t index)
 {
-    if (memory == NULL) {
-        return;
-    }
+    const uint16_t *palette = (index & MODE1_INDEX_OBJ) ? ctx->mode1_memory.obj_palette : ctx->mode1_memory.bg_palette;
 
-    *memory = mode1_memory;
+    return virtuappu_mode1_rgb555_to_abgr8888(palette[index & 0xFFu]);
 }
 
-uint16_t virtuappu_mode1_io_read16(uint16_t offset)
+static uint32_t mode1_layer_color(const Mode1LayerColors *colors, int layer, int x)
 {
-    return (uint16_t)mode1_memory.io_mem[offset] | ((uint16_t)mode1_memory.io_mem[offset + 1u] << 8u);
+    return (layer == 4) ? colors->obj[x] : colors->bg[layer][x];
 }
 
-uint32_t virtuappu_mode1_io_read32(uint16_t offset)
+/* Text BG rows are gathered one tile at a time; the per-line loops below are instantiated once per colour
+ * depth so the dispatcher resolves bpp8 before any pixel work. */
+static MODE1_FORCE_INLINE void mode1_text_bg_kernel(const Mode1TextLine *setup, uint16_t *index_buffer, const bool bpp8)
 {
-    return (uint32_t)virtuappu_mode1_io_read16(offset) |
-           ((uint32_t)virtuappu_mode1_io_read16((uint16_t)(offset + 2u)) << 16u);
+    const uint8_t *vram = setup->vram;
+    const uint32_t row_bytes = bpp8 ? 8u : 4u;
+    uint8_t packed[MODE1_TEXT_TILES_PER_LINE * 8];
+    uint8_t pixels[MODE1_TEXT_TILES_PER_LINE * 8];
+    uint8_t palettes[MODE1_TEXT_TILES_PER_LINE];
+    const uint8_t *row_pixels = bpp8 ? packed : pixels;
+    int t;
+    int x;
+
+    for (t = 0; t < setup->tile_count; ++t) {
+        int tile_col = (setup->first_tile_col + t) % setup->map_width_tiles;
+        uint32_t map_addr = setup->map_row_base + (uint32_t)(tile_col / 32) * 0x800u + (uint32_t)(tile_col % 32) * 2u;
+        Mode1TilemapEntry tile_entry;
+        int tile_pixel_y;
+        uint32_t addr;
+        uint8_t *row = &packed[(uint32_t)t * row_bytes];
+        uint32_t i;
+
+        tile_entry.raw = (uint16_t)vram[map_addr] | ((uint16_t)vram[map_addr + 1u] << 8u);
+        tile_pixel_y = mode1_tile_vflip(tile_entry) ? (7 - setup->pixel_y) : setup->pixel_y;
+        addr = setup->char_base + (uint32_t)mode1_tile_index(tile_entry) * row_bytes * 8u + (uint32_t)tile_pixel_y * row_bytes;
+        palettes[t] = mode1_tile_palette(tile_entry);
+
+        /* Rows are row_bytes-aligned, so a row is either wholly inside VRAM or wholly past it. */
+        if (addr >= MODE1_VRAM_SIZE) {
+            memset(row, 0, row_bytes);
+        } else if (!mode1_tile_hflip(tile_entry)) {
+            memcpy(row, &vram[addr], row_bytes);
+        } else {
+            for (i = 0; i < row_bytes; ++i) {
+                uint8_t value = vram[addr + row_bytes - 1u - i];
+                row[i] = bpp8 ? value : (uint8_t)((value << 4u) | (value >> 4u));
+            }
+        }
+    }
+
+    if (!bpp8) {
+        virtuappu_simd_kernels()->decode_4bpp(pixels, packed, (size_t)setup->tile_count * 4u);
+    }
+
+    for (x = 0; x < MODE1_GBA_WIDTH; ++x) {
+        int src_x = x + setup->fine_x;
+        uint8_t color_index = row_pixels[src_x];
+
+        if (color_index != 0u) {
+            index_buffer[x] = bpp8 ? color_index : (uint16_t)(palettes[src_x / 8] * 16u + color_index);
+        }
+    }
 }
 
-uint32_t virtuappu_mode1_rgb555_to_abgr8888(uint16_t color)
+static void mode1_text_bg_4bpp(const Mode1TextLine *setup, uint16_t *index_buffer)
 {
-    uint8_t r = (uint8_t)((color & 0x1Fu) << 3u);
-    uint8_t g = (uint8_t)(((color >> 5u) & 0x1Fu) << 3u);
-    uint8_t b = (uint8_t)(((color >> 10u) & 0x1Fu) << 3u);
+    mode1_text_bg_kernel(setup, index_buffer, false);
+}
 
-    return 0xFF000000u | ((uint32_t)b << 16u) | ((uint32_t)g << 8u) | (uint32_t)r;
+static void mode1_text_bg_8bpp(const Mode1TextLine *setup, uint16_t *index_buffer)
+{
+    mode1_text_bg_kernel(setup, index_buffer, true);
 }
 
-void virtuappu_mode1_render_text_bg_line(int bg_index, int line, uint32_t *line_buffer, uint8_t *priority_buffer)
+static const Mode1TextKernel mode1_text_bg_kernels[2] = {mode1_text_bg_4bpp, mode1_text_bg_8bpp};
+
+void virtuappu_mode1_render_text_bg_indices_ctx(const VirtuaPPUContext *ctx, int bg_index, int line, uint16_t *index_buffer)
 {
-    uint16_t bgcnt = virtuappu_mode1_io_read16((uint16_t)(MODE1_IO_BG0CNT + bg_index * 2));
-    uint8_t priority = (uint8_t)(bgcnt & 3u);
-    uint32_t char_base = (uint32_t)((bgcnt >> 2u) & 3u) * 0x4000u;
-    bool bpp8 = ((bgcnt >> 7u) & 1u) != 0u;
+    uint16_t bgcnt = virtuappu_mode1_io_read16_ctx(ctx, (uint16_t)(MODE1_IO_BG0CNT + bg_index * 2));
     uint32_t screen_base = (uint32_t)((bgcnt >> 8u) & 0x1Fu) * 0x800u;
     uint16_t size_flag = (uint16_t)((bgcnt >> 14u) & 3u);
-    int map_width_tiles = (size_flag & 1u) ? 64 : 32;
     int map_height_tiles = (size_flag & 2u) ? 64 : 32;
-    int scroll_x = virtuappu_mode1_io_read16((uint16_t)(MODE1_IO_BG0HOFS + bg_index * 4)) & 0x1FF;
-    int scroll_y = virtuappu_mode1_io_read16((uint16_t)(MODE1_IO_BG0VOFS + bg_index * 4)) & 0x1FF;
+    int scroll_x = virtuappu_mode1_io_read16_ctx(ctx, (uint16_t)(MODE1_IO_BG0HOFS + bg_index * 4)) & 0x1FF;
+    int scroll_y = virtuappu_mode1_io_read16_ctx(ctx, (uint16_t)(MODE1_IO_BG0VOFS + bg_index * 4)) & 0x1FF;
     int src_y = (line + scroll_y) % (map_height_tiles * 8);
     int tile_row = src_y / 8;
-    int pixel_y = src_y % 8;
+    Mode1TextLine setup;
+
+    setup.vram = ctx->mode1_memory.vram;
+    setup.char_base = (uint32_t)((bgcnt >> 2u) & 3u) * 0x4000u;
+    setup.map_width_tiles = (size_flag & 1u) ? 64 : 32;
+    setup.map_row_base = screen_base + (uint32_t)((tile_row / 32) * (setup.map_width_tiles / 32)) * 0x800u +
+                         (uint32_t)(tile_row % 32) * 64u;
+    setup.first_tile_col = scroll_x / 8;
+    setup.fine_x = scroll_x & 7;
+    setup.tile_count = (setup.fine_x + MODE1_GBA_WIDTH + 7) / 8;
+    setup.pixel_y = src_y % 8;
+
+    VIRTUAPPU_STATS_ADD(ctx, line, tiles_fetched, setup.tile_count);
+    mode1_text_bg_kernels[((bgcnt >> 7u) & 1u) != 0u](&setup, index_buffer);
+}
+
+void virtuappu_mode1_render_text_bg_line_ctx(
+    const VirtuaPPUContext *ctx,
+    int bg_index,
+    int line,
+    uint32_t *line_buffer,
+    uint8_t *priority_buffer)
+{
+    uint16_t indices[MODE1_GBA_WIDTH];
+    uint8_t priority = (uint8_t)(virtuappu_mode1_io_read16_ctx(ctx, (uint16_t)(MODE1_IO_BG0CNT + bg_index * 2)) & 3u);
     int x;
 
+    memset(indices, 0, sizeof(indices));
+    virtuappu_mode1_render_text_bg_indices_ctx(ctx, bg_index, line, indices);
+
     for (x = 0; x < MODE1_GBA_WIDTH; ++x) {
-        int src_x = (x + scroll_x) % (map_width_tiles * 8);
-        int tile_col = src_x / 8;
-        int pixel_x = src_x % 8;
-        int screen_block_x = tile_col / 32;
-        int screen_block_y = tile_row / 32;
-        int screen_block_index = screen_block_x + screen_block_y * (map_width_tiles / 32);
-        int local_col = tile_col % 32;
-        int local_row = tile_row % 32;
-        uint32_t map_addr = screen_base + (uint32_t)screen_block_index * 0x800u + (uint32_t)(local_row * 32 + local_col) * 2u;
-        Mode1TilemapEntry tile_entry;
-        int tile_pixel_x;
-        int tile_pixel_y;
-        uint8_t color_index;
-        uint16_t rgb555;
+        if (indices[x] != 0u) {
+            line_buffer[x] = mode1_index_color(ctx, indices[x]);
+            priority_buffer[x] = priority;
+        }
+    }
+}
 
-        tile_entry.raw = (uint16_t)mode1_memory.vram[map_addr] | ((uint16_t)mode1_memory.vram[map_addr + 1u] << 8u);
-        tile_pixel_x = mode1_tile_hflip(tile_entry) ? (7 - pixel_x) : pixel_x;
-        tile_pixel_y = mode1_tile_vflip(tile_entry) ? (7 - pixel_y) : pixel_y;
+/* OBJ kernels are instantiated per colour depth and, for regular sprites, per horizontal flip; vflip, obj_1d
+ * and screen clipping are folded into the span before the loop. */
+static MODE1_FORCE_INLINE uint8_t mode1_obj_texel(const uint8_t *vram, uint32_t tile_index, int pixel_x, int pixel_y, const bool bpp8)
+{
+    uint32_t addr = 0x10000u + (tile_index & 0xFFFFu) * 32u;
 
-        if (bpp8) {
-            uint32_t addr = char_base + (uint32_t)mode1_tile_index(tile_entry) * 64u +
-                            (uint32_t)tile_pixel_y * 8u + (uint32_t)tile_pixel_x;
-            color_index = (addr < MODE1_VRAM_SIZE) ? mode1_memory.vram[addr] : 0u;
-        } else {
-            uint32_t addr = char_base + (uint32_t)mode1_tile_index(tile_entry) * 32u +
-                            (uint32_t)tile_pixel_y * 4u + (uint32_t)(tile_pixel_x / 2);
-            uint8_t packed = (addr < MODE1_VRAM_SIZE) ? mode1_memory.vram[addr] : 0u;
-            color_index = (tile_pixel_x & 1) ? (packed >> 4u) : (packed & 0x0Fu);
-        }
+    if (bpp8) {
+        addr += (uint32_t)pixel_y * 8u + (uint32_t)pixel_x;
+        return (addr < MODE1_VRAM_SIZE) ? vram[addr] : 0u;
+    }
 
-        if (color_index == 0u) {
-            continue;
-        }
+    addr += (uint32_t)pixel_y * 4u + (uint32_t)(pixel_x / 2);
+    return (addr < MODE1_VRAM_SIZE) ? (uint8_t)((vram[addr] >> ((pixel_x & 1) * 4)) & 0x0Fu) : 0u;
+}
 
-        if (bpp8) {
-            rgb555 = mode1_memory.bg_palette[color_index];
-        } else {
-            rgb555 = mode1_memory.bg_palette[(size_t)mode1_tile_palette(tile_entry) * 16u + color_index];
+static MODE1_FORCE_INLINE void mode1_obj_plot(const Mode1ObjSpan *span, uint16_t *index_buffer, uint8_t *priority_buffer, int screen_x, uint8_t color_index)
+{
+    if (color_index == 0u) {
+        return;
+    }
+    if (index_buffer[screen_x] != 0u && priority_buffer[screen_x] < span->priority) {
+        return;
+    }
+
+    index_buffer[screen_x] = (uint16_t)(span->palette_base + color_index);
+    priority_buffer[screen_x] = span->priority;
+}
+
+static MODE1_FORCE_INLINE void mode1_obj_regular_kernel(const Mode1ObjSpan *span, uint16_t *index_buffer, uint8_t *priority_buffer, const bool bpp8, const bool hflip)
+{
+    uint32_t row_tile = span->base_tile + (uint32_t)(span->tex_y / 8) * span->row_stride;
+    int pixel_y = span->tex_y % 8;
+    int sx;
+
+    for (sx = span->first_sx; sx < span->last_sx; ++sx) {
+        int tex_x = hflip ? (span->obj_width - 1 - sx) : sx;
+        uint8_t color_index = mode1_obj_texel(span->vram, row_tile + (uint32_t)(tex_x / 8) * span->col_stride, tex_x % 8, pixel_y, bpp8);
+
+        mode1_obj_plot(span, index_buffer, priority_buffer, span->obj_x + sx, color_index);
+    }
+}
+
+static MODE1_FORCE_INLINE void mode1_obj_affine_kernel(const Mode1ObjSpan *span, uint16_t *index_buffer, uint8_t *priority_buffer, const bool bpp8)
+{
+    int sprite_half_width = span->obj_width / 2;
+    int sprite_half_height = span->obj_height / 2;
+    int sx;
+
+    for (sx = span->first_sx; sx < span->last_sx; ++sx) {
+        int input_rel_x = sx - span->half_width;
+        int tex_x = ((span->pa * input_rel_x + span->pb * span->input_rel_y) >> 8) + sprite_half_width;
+        int tex_y = ((span->pc * input_rel_x + span->pd * span->input_rel_y) >> 8) + sprite_half_height;
+        uint8_t color_index;
+
+        if (tex_x < 0 || tex_x >= span->obj_width || tex_y < 0 || tex_y >= span->obj_height) {
+            continue;
         }
 
-        line_buffer[x] = virtuappu_mode1_rgb555_to_abgr8888(rgb555);
-        priority_buffer[x] = priority;
+        color_index = mode1_obj_texel(span->vram, span->base_tile + (uint32_t)(tex_y / 8) * span->row_stride + (uint32_t)(tex_x / 8) * span->col_stride,
+                                      tex_x % 8, tex_y % 8, bpp8);
+        mode1_obj_plot(span, index_buffer, priority_buffer, span->obj_x + sx, color_index);
     }
 }
 
-void virtuappu_mode1_render_obj_line(int line, bool obj_1d, uint32_t *line_buffer, uint8_t *priority_buffer)
+#define MODE1_OBJ_REGULAR_KERNEL(name, bpp8, hflip) \
+    static void name(const Mode1ObjSpan *span, uint16_t *index_buffer, uint8_t *priority_buffer) \
+    { \
+        mode1_obj_regular_kernel(span, index_buffer, priority_buffer, bpp8, hflip); \
+    }
+
+#define MODE1_OBJ_AFFINE_KERNEL(name, bpp8) \
+    static void name(const Mode1ObjSpan *span, uint16_t *index_buffer, uint8_t *priority_buffer) \
+    { \
+        mode1_obj_affine_kernel(span, index_buffer, priority_buffer, bpp8); \
+    }
+
+MODE1_OBJ_REGULAR_KERNEL(mode1_obj_4bpp, false, false)
+MODE1_OBJ_REGULAR_KERNEL(mode1_obj_4bpp_hflip, false, true)
+MODE1_OBJ_REGULAR_KERNEL(mode1_obj_8bpp, true, false)
+MODE1_OBJ_REGULAR_KERNEL(mode1_obj_8bpp_hflip, true, true)
+MODE1_OBJ_AFFINE_KERNEL(mode1_obj_affine_4bpp, false)
+MODE1_OBJ_AFFINE_KERNEL(mode1_obj_affine_8bpp, true)
+
+static const Mode1ObjKernel mode1_obj_regular_kernels[2][2] = {
+    {mode1_obj_4bpp, mode1_obj_4bpp_hflip},
+    {mode1_obj_8bpp, mode1_obj_8bpp_hflip}
+};
+
+static const Mode1ObjKernel mode1_obj_affine_kernels[2] = {mode1_obj_affine_4bpp, mode1_obj_affine_8bpp};
+
+void virtuappu_mode1_render_obj_indices_ctx(
+    const VirtuaPPUContext *ctx,
+    int line,
+    bool obj_1d,
+    uint16_t *index_buffer,
+    uint8_t *priority_buffer)
 {
-    const uint32_t obj_tile_base = 0x10000u;
+    const VirtuaPPUMode1GbaMemory *memory = &ctx->mode1_memory;
     int i;
 
     for (i = MODE1_GBA_OAM_COUNT - 1; i >= 0; --i) {
         Mode1OAMAttr attr;
+        Mode1ObjSpan span;
         uint8_t shape;
         uint8_t size;
-        int obj_width;
-        int obj_height;
         bool is_affine;
+        bool bpp8;
         int bounds_width;
         int bounds_height;
         int obj_y;
-        int obj_x;
-        bool bpp8;
-        uint8_t priority;
-        uint16_t base_tile;
-        int tiles_w;
-        int16_t pa = 0x100;
-        int16_t pb = 0;
-        int16_t pc = 0;
-        int16_t pd = 0x100;
-        int half_width;
-        int half_height;
-        int sprite_half_width;
-        int sprite_half_height;
-        int input_rel_y;
-        int sx;
-
-        attr.attr0 = mode1_memory.oam_mem[i * 4];
-        attr.attr1 = mode1_memory.oam_mem[i * 4 + 1];
-        attr.attr2 = mode1_memory.oam_mem[i * 4 + 2];
+
+        attr.attr0 = memory->oam_mem[i * 4];
+        attr.attr1 = memory->oam_mem[i * 4 + 1];
+        attr.attr2 = memory->oam_mem[i * 4 + 2];
 
         if (mode1_oam_hidden(attr)) {
             continue;
@@ -360,11 +494,11 @@ void virtuappu_mode1_render_obj_line(int line, bool obj_1d, uint32_t *line_buffe
 
         shape = mode1_oam_shape(attr);
         size = mode1_oam_size(attr);
-        obj_width = mode1_obj_widths[shape][size];
-        obj_height = mode1_obj_heights[shape][size];
+        span.obj_width = mode1_obj_widths[shape][size];
+        span.obj_height = mode1_obj_heights[shape][size];
         is_affine = mode1_oam_affine(attr);
-        bounds_width = obj_width;
-        bounds_height = obj_height;
+        bounds_width = span.obj_width;
+        bounds_height = span.obj_height;
 
         if (is_affine && mode1_oam_double_size(attr)) {
             bounds_width *= 2;
@@ -378,119 +512,81 @@ void virtuappu_mode1_render_obj_line(int line, bool obj_1d, uint32_t *line_buffe
         if (line < obj_y || line >= obj_y + bounds_height) {
             continue;
         }
+        VIRTUAPPU_STATS_ADD(ctx, line, sprites_drawn, 1u);
 
-        obj_x = mode1_oam_x(attr);
-        if (obj_x >= MODE1_GBA_WIDTH) {
-            obj_x -= 512;
+        span.obj_x = mode1_oam_x(attr);
+        if (span.obj_x >= MODE1_GBA_WIDTH) {
+            span.obj_x -= 512;
+        }
+        span.first_sx = (span.obj_x < 0) ? -span.obj_x : 0;
+        span.last_sx = (span.obj_x + bounds_width > MODE1_GBA_WIDTH) ? MODE1_GBA_WIDTH - span.obj_x : bounds_width;
+        if (span.first_sx >= span.last_sx) {
+            continue;
         }
 
         bpp8 = mode1_oam_bpp8(attr);
-        priority = mode1_oam_priority(attr);
-        base_tile = mode1_oam_tile_index(attr);
-        tiles_w = obj_width / 8;
+        span.vram = memory->vram;
+        span.priority = mode1_oam_priority(attr);
+        span.palette_base = (uint16_t)(MODE1_INDEX_OBJ | (bpp8 ? 0u : mode1_oam_palette(attr) * 16u));
+        span.base_tile = mode1_oam_tile_index(attr);
+        span.col_stride = bpp8 ? 2u : 1u;
+        span.row_stride = obj_1d ? (uint32_t)(span.obj_width / 8) * span.col_stride : 32u;
 
         if (is_affine) {
             int affine_group = mode1_oam_affine_index(attr);
-            pa = (int16_t)mode1_memory.oam_mem[affine_group * 16 + 3];
-            pb = (int16_t)mode1_memory.oam_mem[affine_group * 16 + 7];
-            pc = (int16_t)mode1_memory.oam_mem[affine_group * 16 + 11];
-            pd = (int16_t)mode1_memory.oam_mem[affine_group * 16 + 15];
-        }
-
-        half_width = bounds_width / 2;
-        half_height = bounds_height / 2;
-        sprite_half_width = obj_width / 2;
-        sprite_half_height = obj_height / 2;
-        input_rel_y = line - obj_y - half_height;
-
-        for (sx = 0; sx < bounds_width; ++sx) {
-            int screen_x = obj_x + sx;
-            int tex_x;
-            int tex_y;
-            int tile_row;
-            int pixel_y;
-            int tile_col;
-            int pixel_x;
-            uint16_t tile_index;
-            uint8_t color_index;
-            uint16_t rgb555;
-
-            if (screen_x < 0 || screen_x >= MODE1_GBA_WIDTH) {
-                continue;
-            }
-
-            if (is_affine) {
-                int input_rel_x = sx - half_width;
-                tex_x = ((pa * input_rel_x + pb * input_rel_y) >> 8) + sprite_half_width;
-                tex_y = ((pc * input_rel_x + pd * input_rel_y) >> 8) + sprite_half_height;
-                if (tex_x < 0 || tex_x >= obj_width || tex_y < 0 || tex_y >= obj_height) {
-                    continue;
-                }
-            } else {
-                int draw_x = mode1_oam_hflip(attr) ? (obj_width - 1 - sx) : sx;
-                int draw_y = line - obj_y;
-                if (mode1_oam_vflip(attr)) {
-                    draw_y = obj_height - 1 - draw_y;
-                }
-                tex_x = draw_x;
-                tex_y = draw_y;
-            }
-
-            tile_row = tex_y / 8;
-            pixel_y = tex_y % 8;
-            tile_col = tex_x / 8;
-            pixel_x = tex_x % 8;
 
-            if (obj_1d) {
-                tile_index = (uint16_t)(base_tile + tile_row * tiles_w + tile_col);
-                if (bpp8) {
-                    tile_index = (uint16_t)(base_tile + (tile_row * tiles_w + tile_col) * 2);
-                }
-            } else {
-                tile_index = (uint16_t)(base_tile + tile_row * 32 + tile_col);
-                if (bpp8) {
-                    tile_index = (uint16_t)(base_tile + tile_row * 32 + tile_col * 2);
-                }
-            }
-
-            if (bpp8) {
-                uint32_t addr = obj_tile_base + (uint32_t)tile_index * 32u + (uint32_t)pixel_y * 8u + (uint32_t)pixel_x;
-                color_index = (addr < MODE1_VRAM_SIZE) ? mode1_memory.vram[addr] : 0u;
-            } else {
-                uint32_t addr = obj_tile_base + (uint32_t)tile_index * 32u + (uint32_t)pixel_y * 4u + (uint32_t)(pixel_x / 2);
-                uint8_t packed = (addr < MODE1_VRAM_SIZE) ? mode1_memory.vram[addr] : 0u;
-                color_index = (pixel_x & 1) ? (packed >> 4u) : (packed & 0x0Fu);
-            }
+            span.pa = (int16_t)memory->oam_mem[affine_group * 16 + 3];
+            span.pb = (int16_t)memory->oam_mem[affine_group * 16 + 7];
+            span.pc = (int16_t)memory->oam_mem[affine_group * 16 + 11];
+            span.pd = (int16_t)memory->oam_mem[affine_group * 16 + 15];
+            span.half_width = bounds_width / 2;
+            span.input_rel_y = line - obj_y - bounds_height / 2;
+            mode1_obj_affine_kernels[bpp8](&span, index_buffer, priority_buffer);
+        } else {
+            span.tex_y = mode1_oam_vflip(attr) ? (span.obj_height - 1 - (line - obj_y)) : (line - obj_y);
+            mode1_obj_regular_kernels[bpp8][mode1_oam_hflip(attr)](&span, index_buffer, priority_buffer);
+        }
+    }
+}
 
-            if (color_index == 0u) {
-                continue;
-            }
+void virtuappu_mode1_render_obj_line_ctx(
+    const VirtuaPPUContext *ctx,
+    int line,
+    bool obj_1d,
+    uint32_t *line_buffer,
+    uint8_t *priority_buffer)
+{
+    uint16_t indices[MODE1_GBA_WIDTH];
+    int x;
 
-            if (line_buffer[screen_x] != 0u && priority_buffer[screen_x] < priority) {
-                continue;
-            }
+    /* Pixels the caller already filled only need to block lower-priority sprites, so any non-palette tag works. */
+    for (x = 0; x < MODE1_GBA_WIDTH; ++x) {
+        indices[x] = (line_buffer[x] != 0u) ? 0xFFFFu : 0u;
+    }
 
-            if (bpp8) {
-                rgb555 = mode1_memory.obj_palette[color_index];
-            } else {
-                rgb555 = mode1_memory.obj_palette[(size_t)mode1_oam_palette(attr) * 16u + color_index];
-            }
+    virtuappu_mode1_render_obj_indices_ctx(ctx, line, obj_1d, indices, priority_buffer);
 
-            line_buffer[screen_x] = virtuappu_mode1_rgb555_to_abgr8888(rgb555);
-            priority_buffer[screen_x] = priority;
+    for (x = 0; x < MODE1_GBA_WIDTH; ++x) {
+        if (indices[x] != 0u && indices[x] != 0xFFFFu) {
+            line_buffer[x] = mode1_index_color(ctx, indices[x]);
         }
     }
 }
 
-void virtuappu_mode1_composite_line(
+/* Layers are selected on palette indices in a scalar pass; the palette lookup and the colour effect then run
+ * as whole-line kernels. Callers that already hold ABGR layers pass them as `colors` and skip the lookup. */
+static void mode1_composite(
+    VirtuaPPUContext *ctx,
     int line,
-    uint32_t bg_layers[MODE1_GBA_BG_COUNT][MODE1_GBA_WIDTH],
-    uint8_t bg_priority[MODE1_GBA_BG_COUNT][MODE1_GBA_WIDTH],
-    uint32_t obj_layer[MODE1_GBA_WIDTH],
-    uint8_t obj_priority[MODE1_GBA_WIDTH],
-    uint16_t dispcnt)
-{
-    uint32_t backdrop_color = virtuappu_mode1_rgb555_to_abgr8888(mode1_memory.bg_palette[0]);
+    uint16_t bg_layers[MODE1_GBA_BG_COUNT][MODE1_GBA_WIDTH],
+    const uint16_t obj_layer[MODE1_GBA_WIDTH],
+    const uint8_t obj_priority[MODE1_GBA_WIDTH],
+    uint16_t dispcnt,
+    const uint32_t *palette,
+    const Mode1LayerColors *colors)
+{
+    const VirtuaPPUSimdKernels *simd = virtuappu_simd_kernels();
+    uint32_t backdrop_color = virtuappu_mode1_rgb555_to_abgr8888(ctx->mode1_memory.bg_palette[0]);
     bool bg_enabled[MODE1_GBA_BG_COUNT] = {
         (dispcnt & MODE1_DISP_BG0_ON) != 0u,
         (dispcnt & MODE1_DISP_BG1_ON) != 0u,
@@ -498,9 +594,9 @@ void virtuappu_mode1_composite_line(
         (dispcnt & MODE1_DISP_BG3_ON) != 0u
     };
     bool obj_enabled = (dispcnt & MODE1_DISP_OBJ_ON) != 0u;
-    uint16_t bldcnt = virtuappu_mode1_io_read16(MODE1_IO_BLDCNT);
-    uint16_t bldalpha = virtuappu_mode1_io_read16(MODE1_IO_BLDALPHA);
-    uint16_t bldy = virtuappu_mode1_io_read16(MODE1_IO_BLDY);
+    uint16_t bldcnt = virtuappu_mode1_io_read16_ctx(ctx, MODE1_IO_BLDCNT);
+    uint16_t bldalpha = virtuappu_mode1_io_read16_ctx(ctx, MODE1_IO_BLDALPHA);
+    uint16_t bldy = virtuappu_mode1_io_read16_ctx(ctx, MODE1_IO_BLDY);
     Mode1BlendEffect effect = (Mode1BlendEffect)((bldcnt >> 6u) & 3u);
     int eva = bldalpha & 0x1Fu;
     int evb = (bldalpha >> 8u) & 0x1Fu;
@@ -510,18 +606,18 @@ void virtuappu_mode1_composite_line(
     bool win0_on = (dispcnt & MODE1_DISP_WIN0_ON) != 0u;
     bool win1_on = (dispcnt & MODE1_DISP_WIN1_ON) != 0u;
     bool any_window = win0_on || win1_on;
-    uint16_t winin = virtuappu_mode1_io_read16(MODE1_IO_WININ);
-    uint16_t winout = virtuappu_mode1_io_read16(MODE1_IO_WINOUT);
-    uint16_t win0h = virtuappu_mode1_io_read16(MODE1_IO_WIN0H);
-    uint16_t win0v = virtuappu_mode1_io_read16(MODE1_IO_WIN0V);
+    uint16_t winin = virtuappu_mode1_io_read16_ctx(ctx, MODE1_IO_WININ);
+    uint16_t winout = virtuappu_mode1_io_read16_ctx(ctx, MODE1_IO_WINOUT);
+    uint16_t win0h = virtuappu_mode1_io_read16_ctx(ctx, MODE1_IO_WIN0H);
+    uint16_t win0v = virtuappu_mode1_io_read16_ctx(ctx, MODE1_IO_WIN0V);
     int win0_left = win0h >> 8u;
     int win0_right = win0h & 0xFFu;
     int win0_top = win0v >> 8u;
     int win0_bottom = win0v & 0xFFu;
     bool win0_h_wrap;
     bool win0_v_active;
-    uint16_t win1h = virtuappu_mode1_io_read16(MODE1_IO_WIN1H);
-    uint16_t win1v = virtuappu_mode1_io_read16(MODE1_IO_WIN1V);
+    uint16_t win1h = virtuappu_mode1_io_read16_ctx(ctx, MODE1_IO_WIN1H);
+    uint16_t win1v = virtuappu_mode1_io_read16_ctx(ctx, MODE1_IO_WIN1V);
     int win1_left = win1h >> 8u;
     int win1_right = win1h & 0xFFu;
     int win1_top = win1v >> 8u;
@@ -531,10 +627,15 @@ void virtuappu_mode1_composite_line(
     uint8_t win0_ctrl = (uint8_t)(winin & 0x3Fu);
     uint8_t win1_ctrl = (uint8_t)((winin >> 8u) & 0x3Fu);
     uint8_t outside_ctrl = (uint8_t)(winout & 0x3Fu);
+    uint16_t top_indices[MODE1_GBA_WIDTH];
+    uint16_t bottom_indices[MODE1_GBA_WIDTH];
+    uint8_t apply[MODE1_GBA_WIDTH];
+    uint32_t out_line[MODE1_GBA_WIDTH];
+    uint32_t bottom_line[MODE1_GBA_WIDTH];
+    uint32_t applied = 0u;
     int i;
     int x;
-
-    (void)bg_priority;
+    VIRTUAPPU_STATS_TIMER(timer);
 
     if (eva > 16) {
         eva = 16;
@@ -565,7 +666,7 @@ void virtuappu_mode1_composite_line(
     win1_v_active = win1_on && win1_top <= win1_bottom && line >= win1_top && line < win1_bottom;
 
     for (i = 0; i < MODE1_GBA_BG_COUNT; ++i) {
-        bg_order_priority[i] = (uint8_t)(virtuappu_mode1_io_read16((uint16_t)(MODE1_IO_BG0CNT + i * 2)) & 3u);
+        bg_order_priority[i] = (uint8_t)(virtuappu_mode1_io_read16_ctx(ctx, (uint16_t)(MODE1_IO_BG0CNT + i * 2)) & 3u);
     }
 
     for (i = 0; i < MODE1_GBA_BG_COUNT - 1; ++i) {
@@ -584,10 +685,10 @@ void virtuappu_mode1_composite_line(
         bool visible_bg[MODE1_GBA_BG_COUNT];
         bool visible_obj;
         bool allow_sfx;
-        uint32_t top_color = backdrop_color;
         int top_layer = 5;
-        uint32_t bottom_color = backdrop_color;
+        uint16_t top_index = 0u;
         int bottom_layer = 5;
+        uint16_t bottom_index = 0u;
         bool found_top = false;
         bool found_bottom = false;
         int priority;
@@ -620,11 +721,11 @@ void virtuappu_mode1_composite_line(
 
             if (obj_enabled && visible_obj && obj_layer[x] != 0u && obj_priority[x] == priority) {
                 if (!found_top) {
-                    top_color = obj_layer[x];
+                    top_index = obj_layer[x];
                     top_layer = 4;
                     found_top = true;
                 } else if (!found_bottom) {
-                    bottom_color = obj_layer[x];
+                    bottom_index = obj_layer[x];
                     bottom_layer = 4;
                     found_bottom = true;
                 }
@@ -643,11 +744,11 @@ void virtuappu_mode1_composite_line(
                 }
 
                 if (!found_top) {
-                    top_color = bg_layers[bg][x];
+                    top_index = bg_layers[bg][x];
                     top_layer = bg;
                     found_top = true;
                 } else if (!found_bottom) {
-                    bottom_color = bg_layers[bg][x];
+                    bottom_index = bg_layers[bg][x];
                     bottom_layer = bg;
                     found_bottom = true;
                     break;
@@ -655,73 +756,248 @@ void virtuappu_mode1_composite_line(
             }
         }
 
-        if (allow_sfx) {
-            switch (effect) {
-            case MODE1_BLEND_ALPHA:
-                if (mode1_is_first_target(bldcnt, top_layer) && mode1_is_second_target(bldcnt, bottom_layer)) {
-                    top_color = mode1_alpha_blend(top_color, bottom_color, eva, evb);
-                }
-                break;
-            case MODE1_BLEND_BRIGHTEN:
-                if (mode1_is_first_target(bldcnt, top_layer)) {
-                    top_color = mode1_brighten(top_color, evy);
-                }
-                break;
-            case MODE1_BLEND_DARKEN:
-                if (mode1_is_first_target(bldcnt, top_layer)) {
-                    top_color = mode1_darken(top_color, evy);
-                }
-                break;
-            default:
-                break;
+        apply[x] = 0u;
+        if (allow_sfx && mode1_is_first_target(bldcnt, top_layer)) {
+            if (effect == MODE1_BLEND_ALPHA) {
+                apply[x] = mode1_is_second_target(bldcnt, bottom_layer);
+            } else {
+                apply[x] = effect != MODE1_BLEND_NONE;
             }
+            applied += apply[x];
         }
 
-        virtuappu_frame_buffer[(size_t)line * MODE1_GBA_WIDTH + (size_t)x] = top_color;
+        /* Index 0 of the combined palette is the backdrop, so unfound layers resolve to it. */
+        top_indices[x] = top_index;
+        bottom_indices[x] = bottom_index;
+        if (colors != NULL) {
+            out_line[x] = found_top ? mode1_layer_color(colors, top_layer, x) : backdrop_color;
+            bottom_line[x] = found_bottom ? mode1_layer_color(colors, bottom_layer, x) : backdrop_color;
+        }
+    }
+
+    if (colors == NULL) {
+        simd->lookup32(out_line, top_indices, palette, MODE1_GBA_WIDTH);
+    }
+    if (applied != 0u) {
+        switch (effect) {
+        case MODE1_BLEND_ALPHA:
+            if (colors == NULL) {
+                simd->lookup32(bottom_line, bottom_indices, palette, MODE1_GBA_WIDTH);
+            }
+            simd->blend_alpha(out_line, bottom_line, apply, eva, evb, MODE1_GBA_WIDTH);
+            break;
+        case MODE1_BLEND_BRIGHTEN:
+            simd->brighten(out_line, apply, evy, MODE1_GBA_WIDTH);
+            break;
+        case MODE1_BLEND_DARKEN:
+            simd->darken(out_line, apply, evy, MODE1_GBA_WIDTH);
+            break;
+        default:
+            break;
+        }
+        VIRTUAPPU_STATS_ADD(ctx, line, pixels_blended, applied);
     }
+
+    VIRTUAPPU_STATS_LAP(ctx, line, VIRTUAPPU_STATS_STAGE_COMPOSITE, timer);
+    virtuappu_write_line(ctx, (size_t)line, out_line, MODE1_GBA_WIDTH);
 }
 
-void virtuappu_mode1_render_frame(const PPUMemory *ppu)
+void virtuappu_mode1_build_palette_ctx(const VirtuaPPUContext *ctx, uint32_t palette[MODE1_INDEX_COLORS])
 {
-    uint16_t dispcnt;
-    int line;
-
-    (void)ppu;
+    int i;
 
-    dispcnt = virtuappu_mode1_io_read16(MODE1_IO_DISPCNT);
-    if ((dispcnt & MODE1_DISP_FORCED_BLANK) != 0u) {
-        memset(virtuappu_frame_buffer, 0xFF, MODE1_GBA_WIDTH * MODE1_GBA_HEIGHT * sizeof(uint32_t));
+    if (ctx == NULL || palette == NULL) {
         return;
     }
 
-    for (line = 0; line < MODE1_GBA_HEIGHT; ++line) {
-        uint32_t bg_layers[MODE1_GBA_BG_COUNT][MODE1_GBA_WIDTH];
-        uint8_t bg_priority[MODE1_GBA_BG_COUNT][MODE1_GBA_WIDTH];
-        uint32_t obj_layer[MODE1_GBA_WIDTH];
-        uint8_t obj_priority[MODE1_GBA_WIDTH];
-        bool obj_1d = (dispcnt & MODE1_DISP_OBJ_1D) != 0u;
+    for (i = 0; i < MODE1_INDEX_COLORS; ++i) {
+        palette[i] = mode1_index_color(ctx, (uint16_t)i);
+    }
+}
+
+void virtuappu_mode1_composite_indices_ctx(
+    VirtuaPPUContext *ctx,
+    int line,
+    uint16_t bg_indices[MODE1_GBA_BG_COUNT][MODE1_GBA_WIDTH],
+    const uint16_t obj_indices[MODE1_GBA_WIDTH],
+    const uint8_t obj_priority[MODE1_GBA_WIDTH],
+    uint16_t dispcnt,
+    const uint32_t *palette)
+{
+    uint32_t line_palette[MODE1_INDEX_COLORS];
+
+    if (palette == NULL) {
+        virtuappu_mode1_build_palette_ctx(ctx, line_palette);
+        palette = line_palette;
+    }
+
+    mode1_composite(ctx, line, bg_indices, obj_indices, obj_priority, dispcnt, palette, NULL);
+}
 
-        memset(bg_layers, 0, sizeof(bg_layers));
-        memset(bg_priority, 0, sizeof(bg_priority));
-        memset(obj_layer, 0, sizeof(obj_layer));
-        memset(obj_priority, 0xFF, sizeof(obj_priority));
+void virtuappu_mode1_composite_line_ctx(
+    VirtuaPPUContext *ctx,
+    int line,
+    uint32_t bg_layers[MODE1_GBA_BG_COUNT][MODE1_GBA_WIDTH],
+    uint8_t bg_priority[MODE1_GBA_BG_COUNT][MODE1_GBA_WIDTH],
+    uint32_t obj_layer[MODE1_GBA_WIDTH],
+    uint8_t obj_priority[MODE1_GBA_WIDTH],
+    uint16_t dispcnt)
+{
+    uint16_t bg_present[MODE1_GBA_BG_COUNT][MODE1_GBA_WIDTH];
+    uint16_t obj_present[MODE1_GBA_WIDTH];
+    Mode1LayerColors colors;
+    int bg;
+    int x;
 
-        if ((dispcnt & MODE1_DISP_BG0_ON) != 0u) {
-            virtuappu_mode1_render_text_bg_line(0, line, bg_layers[0], bg_priority[0]);
-        }
-        if ((dispcnt & MODE1_DISP_BG1_ON) != 0u) {
-            virtuappu_mode1_render_text_bg_line(1, line, bg_layers[1], bg_priority[1]);
-        }
-        if ((dispcnt & MODE1_DISP_BG2_ON) != 0u) {
-            virtuappu_mode1_render_text_bg_line(2, line, bg_layers[2], bg_priority[2]);
-        }
-        if ((dispcnt & MODE1_DISP_BG3_ON) != 0u) {
-            virtuappu_mode1_render_text_bg_line(3, line, bg_layers[3], bg_priority[3]);
-        }
-        if ((dispcnt & MODE1_DISP_OBJ_ON) != 0u) {
-            virtuappu_mode1_render_obj_line(line, obj_1d, obj_layer, obj_priority);
+    (void)bg_priority;
+
+    for (bg = 0; bg < MODE1_GBA_BG_COUNT; ++bg) {
+        for (x = 0; x < MODE1_GBA_WIDTH; ++x) {
+            bg_present[bg][x] = bg_layers[bg][x] != 0u;
         }
+    }
+    for (x = 0; x < MODE1_GBA_WIDTH; ++x) {
+        obj_present[x] = obj_layer[x] != 0u;
+    }
+
+    colors.bg = (const uint32_t(*)[MODE1_GBA_WIDTH])bg_layers;
+    colors.obj = obj_layer;
+    mode1_composite(ctx, line, bg_present, obj_present, obj_priority, dispcnt, NULL, &colors);
+}
+
+static void mode1_render_line(VirtuaPPUContext *ctx, int line, uint16_t dispcnt, const uint32_t *palette)
+{
+    uint16_t bg_indices[MODE1_GBA_BG_COUNT][MODE1_GBA_WIDTH];
+    uint16_t obj_indices[MODE1_GBA_WIDTH];
+    uint8_t obj_priority[MODE1_GBA_WIDTH];
+    bool obj_1d = (dispcnt & MODE1_DISP_OBJ_1D) != 0u;
+    VIRTUAPPU_STATS_TIMER(timer);
+
+    memset(bg_indices, 0, sizeof(bg_indices));
+    memset(obj_indices, 0, sizeof(obj_indices));
+    memset(obj_priority, 0xFF, sizeof(obj_priority));
+
+    if ((dispcnt & MODE1_DISP_BG0_ON) != 0u) {
+        virtuappu_mode1_render_text_bg_indices_ctx(ctx, 0, line, bg_indices[0]);
+    }
+    if ((dispcnt & MODE1_DISP_BG1_ON) != 0u) {
+        virtuappu_mode1_render_text_bg_indices_ctx(ctx, 1, line, bg_indices[1]);
+    }
+    if ((dispcnt & MODE1_DISP_BG2_ON) != 0u) {
+        virtuappu_mode1_render_text_bg_indices_ctx(ctx, 2, line, bg_indices[2]);
+    }
+    if ((dispcnt & MODE1_DISP_BG3_ON) != 0u) {
+        virtuappu_mode1_render_text_bg_indices_ctx(ctx, 3, line, bg_indices[3]);
+    }
+    VIRTUAPPU_STATS_LAP(ctx, line, VIRTUAPPU_STATS_STAGE_BG, timer);
+    if ((dispcnt & MODE1_DISP_OBJ_ON) != 0u) {
+        virtuappu_mode1_render_obj_indices_ctx(ctx, line, obj_1d, obj_indices, obj_priority);
+    }
+    VIRTUAPPU_STATS_LAP(ctx, line, VIRTUAPPU_STATS_STAGE_OBJ, timer);
 
-        virtuappu_mode1_composite_line(line, bg_layers, bg_priority, obj_layer, obj_priority, dispcnt);
+    virtuappu_mode1_composite_indices_ctx(ctx, line, bg_indices, obj_indices, obj_priority, dispcnt, palette);
+}
+
+void virtuappu_mode1_begin_lines_ctx(VirtuaPPUContext *ctx)
+{
+    VirtuaPPUFrameSetup *setup;
+
+    if (!virtuappu_context_supports_mode(ctx, 1u)) {
+        return;
+    }
+
+    /* DISPCNT and the palette are read again for every line range, so writes the host makes between
+     * ranges (layer toggles, palette gradients, leaving forced blank) show up on the following lines. */
+    setup = &ctx->frame_setup;
+    setup->dispcnt = virtuappu_mode1_io_read16_ctx(ctx, MODE1_IO_DISPCNT);
+    if ((setup->dispcnt & MODE1_DISP_FORCED_BLANK) == 0u) {
+        virtuappu_mode1_build_palette_ctx(ctx, setup->palette);
+    }
+}
+
+void virtuappu_mode1_render_lines_ctx(VirtuaPPUContext *ctx, size_t first_line, size_t end_line)
+{
+    const VirtuaPPUFrameSetup *setup;
+    size_t line;
+
+    if (!virtuappu_context_supports_mode(ctx, 1u)) {
+        return;
+    }
+
+    if (end_line > MODE1_GBA_HEIGHT) {
+        end_line = MODE1_GBA_HEIGHT;
+    }
+    if (first_line >= end_line) {
+        return;
     }
+
+    virtuappu_mode1_begin_lines_ctx(ctx);
+    setup = &ctx->frame_setup;
+    if ((setup->dispcnt & MODE1_DISP_FORCED_BLANK) != 0u) {
+        virtuappu_fill_lines(ctx, first_line, end_line - first_line, MODE1_GBA_WIDTH, 0xFFFFFFFFu);
+        return;
+    }
+
+    for (line = first_line; line < end_line; ++line) {
+        mode1_render_line(ctx, (int)line, setup->dispcnt, setup->palette);
+    }
+}
+
+void virtuappu_mode1_render_frame_ctx(VirtuaPPUContext *ctx)
+{
+    if (ctx == NULL) {
+        return;
+    }
+
+    VIRTUAPPU_STATS_BEGIN_FRAME(ctx, MODE1_GBA_HEIGHT);
+    virtuappu_mode1_render_lines_ctx(ctx, 0u, MODE1_GBA_HEIGHT);
+    VIRTUAPPU_STATS_END_FRAME(ctx);
+}
+
+void virtuappu_mode1_bind_gba_memory(const VirtuaPPUMode1GbaMemory *memory)
+{
+    virtuappu_mode1_bind_gba_memory_ctx(virtuappu_get_default_context(), memory);
+}
+
+void virtuappu_mode1_get_bound_gba_memory(VirtuaPPUMode1GbaMemory *memory)
+{
+    virtuappu_mode1_get_bound_gba_memory_ctx(virtuappu_get_default_context(), memory);
+}
+
+uint16_t virtuappu_mode1_io_read16(uint16_t offset)
+{
+    return virtuappu_mode1_io_read16_ctx(virtuappu_get_default_context(), offset);
+}
+
+uint32_t virtuappu_mode1_io_read32(uint16_t offset)
+{
+    return virtuappu_mode1_io_read32_ctx(virtuappu_get_default_context(), offset);
+}
+
+void virtuappu_mode1_render_text_bg_line(int bg_index, int line, uint32_t *line_buffer, uint8_t *priority_buffer)
+{
+    virtuappu_mode1_render_text_bg_line_ctx(virtuappu_get_default_context(), bg_index, line, line_buffer, priority_buffer);
+}
+
+void virtuappu_mode1_render_obj_line(int line, bool obj_1d, uint32_t *line_buffer, uint8_t *priority_buffer)
+{
+    virtuappu_mode1_render_obj_line_ctx(virtuappu_get_default_context(), line, obj_1d, line_buffer, priority_buffer);
+}
+
+void virtuappu_mode1_composite_line(
+    int line,
+    uint32_t bg_layers[MODE1_GBA_BG_COUNT][MODE1_GBA_WIDTH],
+    uint8_t bg_priority[MODE1_GBA_BG_COUNT][MODE1_GBA_WIDTH],
+    uint32_t obj_layer[MODE1_GBA_WIDTH],
+    uint8_t obj_priority[MODE1_GBA_WIDTH],
+    uint16_t dispcnt)
+{
+    virtuappu_mode1_composite_line_ctx(virtuappu_get_default_context(), line, bg_layers, bg_priority, obj_layer, obj_priority, dispcnt);
+}
+
+void virtuappu_mode1_render_frame(const PPUMemory *ppu)
+{
+    (void)ppu;
+
+    virtuappu_mode1_render_frame_ctx(virtuappu_get_default_context());
 }
@@ -5,123 +5,177 @@
 #include "cpu/mode1.h"
 #include "virtuappu.h"
 
-void virtuappu_mode2_render_frame(const PPUMemory *ppu)
+typedef struct Mode2AffineLine {
+    const uint8_t *vram;
+    uint32_t char_base;
+    uint32_t screen_base;
+    int map_size;
+    int32_t tex_x;
+    int32_t tex_y;
+    int16_t pa;
+    int16_t pc;
+} Mode2AffineLine;
+
+typedef uint32_t (*Mode2AffineKernel)(const Mode2AffineLine *setup, uint16_t *index_buffer);
+
+#if defined(_MSC_VER)
+#define MODE2_FORCE_INLINE __forceinline
+#else
+#define MODE2_FORCE_INLINE inline __attribute__((always_inline))
+#endif
+
+/* Map sizes are powers of two, so wrapping is a mask; the wrap and clip loops are instantiated separately
+ * and return the number of texels fetched for the stats. */
+static MODE2_FORCE_INLINE uint32_t mode2_affine_kernel(const Mode2AffineLine *setup, uint16_t *index_buffer, const bool wrap)
 {
-    static const int affine_sizes[4] = {128, 256, 512, 1024};
-    uint16_t dispcnt;
-    int line;
+    const uint8_t *vram = setup->vram;
+    int32_t map_mask = setup->map_size - 1;
+    int map_tiles = setup->map_size / 8;
+    uint32_t fetched = 0u;
+    int x;
+
+    for (x = 0; x < MODE1_GBA_WIDTH; ++x) {
+        int32_t src_x = (setup->tex_x + setup->pa * x) >> 8;
+        int32_t src_y = (setup->tex_y + setup->pc * x) >> 8;
+        uint32_t map_addr;
+        uint8_t tile_index;
+        uint32_t tile_addr;
+        uint8_t color_index;
+
+        if (wrap) {
+            src_x &= map_mask;
+            src_y &= map_mask;
+        } else if ((uint32_t)src_x >= (uint32_t)setup->map_size || (uint32_t)src_y >= (uint32_t)setup->map_size) {
+            continue;
+        }
+        ++fetched;
 
-    (void)ppu;
+        map_addr = setup->screen_base + (uint32_t)((src_y / 8) * map_tiles + src_x / 8);
+        tile_index = (map_addr < MODE1_VRAM_SIZE) ? vram[map_addr] : 0u;
+        tile_addr = setup->char_base + (uint32_t)tile_index * 64u + (uint32_t)(src_y % 8) * 8u + (uint32_t)(src_x % 8);
+        color_index = (tile_addr < MODE1_VRAM_SIZE) ? vram[tile_addr] : 0u;
 
-    dispcnt = virtuappu_mode1_io_read16(MODE1_IO_DISPCNT);
-    if ((dispcnt & MODE1_DISP_FORCED_BLANK) != 0u) {
-        memset(virtuappu_frame_buffer, 0xFF, MODE1_GBA_WIDTH * MODE1_GBA_HEIGHT * sizeof(uint32_t));
-        return;
+        if (color_index != 0u) {
+            index_buffer[x] = color_index;
+        }
+    }
+
+    return fetched;
+}
+
+static uint32_t mode2_affine_clip(const Mode2AffineLine *setup, uint16_t *index_buffer)
+{
+    return mode2_affine_kernel(setup, index_buffer, false);
+}
+
+static uint32_t mode2_affine_wrap(const Mode2AffineLine *setup, uint16_t *index_buffer)
+{
+    return mode2_affine_kernel(setup, index_buffer, true);
+}
+
+static const Mode2AffineKernel mode2_affine_kernels[2] = {mode2_affine_clip, mode2_affine_wrap};
+
+static void mode2_render_line(VirtuaPPUContext *ctx, int line, uint16_t dispcnt, const uint32_t *palette)
+{
+    static const int affine_sizes[4] = {128, 256, 512, 1024};
+    uint16_t bg_indices[MODE1_GBA_BG_COUNT][MODE1_GBA_WIDTH];
+    uint16_t obj_indices[MODE1_GBA_WIDTH];
+    uint8_t obj_priority[MODE1_GBA_WIDTH];
+    bool obj_1d = (dispcnt & MODE1_DISP_OBJ_1D) != 0u;
+    VIRTUAPPU_STATS_TIMER(timer);
+
+    memset(bg_indices, 0, sizeof(bg_indices));
+    memset(obj_indices, 0, sizeof(obj_indices));
+    memset(obj_priority, 0xFF, sizeof(obj_priority));
+
+    if ((dispcnt & MODE1_DISP_BG0_ON) != 0u) {
+        virtuappu_mode1_render_text_bg_indices_ctx(ctx, 0, line, bg_indices[0]);
+    }
+    if ((dispcnt & MODE1_DISP_BG1_ON) != 0u) {
+        virtuappu_mode1_render_text_bg_indices_ctx(ctx, 1, line, bg_indices[1]);
     }
 
-    for (line = 0; line < MODE1_GBA_HEIGHT; ++line) {
-        uint32_t bg_layers[MODE1_GBA_BG_COUNT][MODE1_GBA_WIDTH];
-        uint8_t bg_priority[MODE1_GBA_BG_COUNT][MODE1_GBA_WIDTH];
-        uint32_t obj_layer[MODE1_GBA_WIDTH];
-        uint8_t obj_priority[MODE1_GBA_WIDTH];
-        VirtuaPPUMode1GbaMemory memory;
-        bool obj_1d = (dispcnt & MODE1_DISP_OBJ_1D) != 0u;
-
-        memset(bg_layers, 0, sizeof(bg_layers));
-        memset(bg_priority, 0, sizeof(bg_priority));
-        memset(obj_layer, 0, sizeof(obj_layer));
-        memset(obj_priority, 0xFF, sizeof(obj_priority));
-
-        if ((dispcnt & MODE1_DISP_BG0_ON) != 0u) {
-            virtuappu_mode1_render_text_bg_line(0, line, bg_layers[0], bg_priority[0]);
+    if ((dispcnt & MODE1_DISP_BG2_ON) != 0u) {
+        uint16_t bgcnt = virtuappu_mode1_io_read16_ctx(ctx, MODE1_IO_BG2CNT);
+        int16_t pb = (int16_t)virtuappu_mode1_io_read16_ctx(ctx, 0x22u);
+        int16_t pd = (int16_t)virtuappu_mode1_io_read16_ctx(ctx, 0x26u);
+        int32_t ref_x = (int32_t)virtuappu_mode1_io_read32_ctx(ctx, 0x28u);
+        int32_t ref_y = (int32_t)virtuappu_mode1_io_read32_ctx(ctx, 0x2Cu);
+        Mode2AffineLine setup;
+        uint32_t fetched;
+
+        if ((ref_x & 0x08000000u) != 0u) {
+            ref_x |= (int32_t)0xF0000000u;
         }
-        if ((dispcnt & MODE1_DISP_BG1_ON) != 0u) {
-            virtuappu_mode1_render_text_bg_line(1, line, bg_layers[1], bg_priority[1]);
+        if ((ref_y & 0x08000000u) != 0u) {
+            ref_y |= (int32_t)0xF0000000u;
         }
 
-        if ((dispcnt & MODE1_DISP_BG2_ON) != 0u) {
-            uint16_t bgcnt;
-            uint8_t bg_priority_value;
-            uint32_t char_base;
-            uint32_t screen_base;
-            bool wrap;
-            uint16_t size_flag;
-            int map_size;
-            int map_tiles;
-            int16_t pa;
-            int16_t pb;
-            int16_t pc;
-            int16_t pd;
-            int32_t ref_x;
-            int32_t ref_y;
-            int x;
-
-            virtuappu_mode1_get_bound_gba_memory(&memory);
-            bgcnt = virtuappu_mode1_io_read16(MODE1_IO_BG2CNT);
-            bg_priority_value = (uint8_t)(bgcnt & 3u);
-            char_base = (uint32_t)((bgcnt >> 2u) & 3u) * 0x4000u;
-            screen_base = (uint32_t)((bgcnt >> 8u) & 0x1Fu) * 0x800u;
-            wrap = ((bgcnt >> 13u) & 1u) != 0u;
-            size_flag = (uint16_t)((bgcnt >> 14u) & 3u);
-            map_size = affine_sizes[size_flag];
-            map_tiles = map_size / 8;
-            pa = (int16_t)virtuappu_mode1_io_read16(0x20u);
-            pb = (int16_t)virtuappu_mode1_io_read16(0x22u);
-            pc = (int16_t)virtuappu_mode1_io_read16(0x24u);
-            pd = (int16_t)virtuappu_mode1_io_read16(0x26u);
-            ref_x = (int32_t)virtuappu_mode1_io_read32(0x28u);
-            ref_y = (int32_t)virtuappu_mode1_io_read32(0x2Cu);
-
-            if ((ref_x & 0x08000000u) != 0u) {
-                ref_x |= (int32_t)0xF0000000u;
-            }
-            if ((ref_y & 0x08000000u) != 0u) {
-                ref_y |= (int32_t)0xF0000000u;
-            }
-
-            for (x = 0; x < MODE1_GBA_WIDTH; ++x) {
-                int32_t tex_x = ref_x + pb * line + pa * x;
-                int32_t tex_y = ref_y + pd * line + pc * x;
-                int32_t src_x = tex_x >> 8;
-                int32_t src_y = tex_y >> 8;
-                int tile_col;
-                int tile_row;
-                int pixel_x;
-                int pixel_y;
-                uint32_t map_addr;
-                uint8_t tile_index;
-                uint32_t tile_addr;
-                uint8_t color_index;
-
-                if (wrap) {
-                    src_x = ((src_x % map_size) + map_size) % map_size;
-                    src_y = ((src_y % map_size) + map_size) % map_size;
-                } else if (src_x < 0 || src_x >= map_size || src_y < 0 || src_y >= map_size) {
-                    continue;
-                }
-
-                tile_col = src_x / 8;
-                tile_row = src_y / 8;
-                pixel_x = src_x % 8;
-                pixel_y = src_y % 8;
-                map_addr = screen_base + (uint32_t)(tile_row * map_tiles + tile_col);
-                tile_index = (map_addr < MODE1_VRAM_SIZE) ? memory.vram[map_addr] : 0u;
-                tile_addr = char_base + (uint32_t)tile_index * 64u + (uint32_t)pixel_y * 8u + (uint32_t)pixel_x;
-                color_index = (tile_addr < MODE1_VRAM_SIZE) ? memory.vram[tile_addr] : 0u;
-
-                if (color_index == 0u) {
-                    continue;
-                }
-
-                bg_layers[2][x] = virtuappu_mode1_rgb555_to_abgr8888(memory.bg_palette[color_index]);
-                bg_priority[2][x] = bg_priority_value;
-            }
-        }
+        setup.vram = ctx->mode1_memory.vram;
+        setup.char_base = (uint32_t)((bgcnt >> 2u) & 3u) * 0x4000u;
+        setup.screen_base = (uint32_t)((bgcnt >> 8u) & 0x1Fu) * 0x800u;
+        setup.map_size = affine_sizes[(bgcnt >> 14u) & 3u];
+        setup.tex_x = ref_x + pb * line;
+        setup.tex_y = ref_y + pd * line;
+        setup.pa = (int16_t)virtuappu_mode1_io_read16_ctx(ctx, 0x20u);
+        setup.pc = (int16_t)virtuappu_mode1_io_read16_ctx(ctx, 0x24u);
+        fetched = mode2_affine_kernels[((bgcnt >> 13u) & 1u) != 0u](&setup, bg_indices[2]);
+        VIRTUAPPU_STATS_ADD(ctx, line, tiles_fetched, fetched);
+        (void)fetched;
+    }
 
-        if ((dispcnt & MODE1_DISP_OBJ_ON) != 0u) {
-            virtuappu_mode1_render_obj_line(line, obj_1d, obj_layer, obj_priority);
-        }
+    VIRTUAPPU_STATS_LAP(ctx, line, VIRTUAPPU_STATS_STAGE_BG, timer);
 
-        virtuappu_mode1_composite_line(line, bg_layers, bg_priority, obj_layer, obj_priority, dispcnt);
+    if ((dispcnt & MODE1_DISP_OBJ_ON) != 0u) {
+        virtuappu_mode1_render_obj_indices_ctx(ctx, line, obj_1d, obj_indices, obj_priority);
     }
+    VIRTUAPPU_STATS_LAP(ctx, line, VIRTUAPPU_STATS_STAGE_OBJ, timer);
+
+    virtuappu_mode1_composite_indices_ctx(ctx, line, bg_indices, obj_indices, obj_priority, dispcnt, palette);
+}
+
+void virtuappu_mode2_render_lines_ctx(VirtuaPPUContext *ctx, size_t first_line, size_t end_line)
+{
+    const VirtuaPPUFrameSetup *setup;
+    size_t line;
+
+    if (!virtuappu_context_supports_mode(ctx, 2u)) {
+        return;
+    }
+
+    if (end_line > MODE1_GBA_HEIGHT) {
+        end_line = MODE1_GBA_HEIGHT;
+    }
+    if (first_line >= end_line) {
+        return;
+    }
+
+    virtuappu_mode1_begin_lines_ctx(ctx);
+    setup = &ctx->frame_setup;
+    if ((setup->dispcnt & MODE1_DISP_FORCED_BLANK) != 0u) {
+        virtuappu_fill_lines(ctx, first_line, end_line - first_line, MODE1_GBA_WIDTH, 0xFFFFFFFFu);
+        return;
+    }
+
+    for (line = first_line; line < end_line; ++line) {
+        mode2_render_line(ctx, (int)line, setup->dispcnt, setup->palette);
+    }
+}
+
+void virtuappu_mode2_render_frame_ctx(VirtuaPPUContext *ctx)
+{
+    if (ctx == NULL) {
+        return;
+    }
+
+    VIRTUAPPU_STATS_BEGIN_FRAME(ctx, MODE1_GBA_HEIGHT);
+    virtuappu_mode2_render_lines_ctx(ctx, 0u, MODE1_GBA_HEIGHT);
+    VIRTUAPPU_STATS_END_FRAME(ctx);
+}
+
+void virtuappu_mode2_render_frame(const PPUMemory *ppu)
+{
+    (void)ppu;
+
+    virtuappu_mode2_render_frame_ctx(virtuappu_get_default_context());
 }
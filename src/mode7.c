@@ -14,9 +14,9 @@ typedef struct Mode7SpriteCandidate {
 
 _Static_assert(sizeof(Mode7Layout) <= VIRTUAPPU_VRAM_SIZE, "Mode7Layout exceeds VRAM storage");
 
-static const Mode7Layout *mode7_get_layout(void)
+static const Mode7Layout *mode7_get_layout(const VirtuaPPUContext *ctx)
 {
-    return (const Mode7Layout *)virtuappu_vram;
+    return (const Mode7Layout *)ctx->vram;
 }
 
 static uint8_t mode7_vram_read(const Mode7Layout *layout, uint16_t addr)
@@ -124,119 +124,163 @@ static uint8_t mode7_eval_sprites(
     return candidate_count;
 }
 
-void virtuappu_mode7_render_frame(const PPUMemory *ppu)
+static void mode7_render_line(VirtuaPPUContext *ctx, const Mode7Layout *layout, uint8_t y)
 {
-    const Mode7Layout *layout = mode7_get_layout();
     const Mode7GBRegs *regs = &layout->regs;
-    uint8_t y;
+    Mode7SpriteCandidate sprites[10];
+    uint32_t out_line[MODE7_GB_SCREEN_WIDTH];
+    uint8_t sprite_count = 0u;
+    uint8_t x;
+    VIRTUAPPU_STATS_TIMER(timer);
 
-    (void)ppu;
+    if ((regs->lcdc & MODE7_LCDC_OBJ_ENABLE) != 0u) {
+        uint8_t sprite_height = (regs->lcdc & MODE7_LCDC_OBJ_SIZE) ? 16u : 8u;
+        sprite_count = mode7_eval_sprites(layout, y, sprite_height, sprites);
+    }
+    VIRTUAPPU_STATS_ADD(ctx, y, sprites_drawn, sprite_count);
+    VIRTUAPPU_STATS_LAP(ctx, y, VIRTUAPPU_STATS_STAGE_OBJ, timer);
+
+    for (x = 0u; x < MODE7_GB_SCREEN_WIDTH; ++x) {
+        uint8_t bg_color_id = 0u;
+        uint32_t bg_color = mode7_palette_color(regs->bgp, 0u);
+        uint32_t final_color;
+
+        if ((regs->lcdc & MODE7_LCDC_BG_ENABLE) != 0u) {
+            uint16_t tile_map_base = (regs->lcdc & MODE7_LCDC_BG_TILE_MAP) ? 0x9C00u : 0x9800u;
+            uint16_t tile_data_base = (regs->lcdc & MODE7_LCDC_BG_WINDOW_TILE_DATA) ? 0x8000u : 0x9000u;
+            int signed_indexing = (regs->lcdc & MODE7_LCDC_BG_WINDOW_TILE_DATA) == 0u;
+            uint8_t bg_x = (uint8_t)(x + regs->scx);
+            uint8_t bg_y = (uint8_t)(y + regs->scy);
+
+            bg_color_id = mode7_fetch_tile_color(layout, tile_map_base, tile_data_base, signed_indexing, bg_x, bg_y);
+            if (x == 0u || (bg_x & 7u) == 0u) {
+                VIRTUAPPU_STATS_ADD(ctx, y, tiles_fetched, 1u);
+            }
 
-    if ((regs->lcdc & MODE7_LCDC_ENABLE) == 0u) {
-        uint32_t clear_color = mode7_palette_color(regs->bgp, 0u);
-        size_t i;
-        for (i = 0; i < (size_t)MODE7_GB_SCREEN_WIDTH * MODE7_GB_SCREEN_HEIGHT; ++i) {
-            virtuappu_frame_buffer[i] = clear_color;
+            if ((regs->lcdc & MODE7_LCDC_WINDOW_ENABLE) != 0u && regs->wy <= y) {
+                uint8_t window_x_origin = (regs->wx > 7u) ? (uint8_t)(regs->wx - 7u) : 0u;
+                if (x >= window_x_origin && regs->wx <= 166u) {
+                    uint8_t window_x = (uint8_t)(x - window_x_origin);
+                    uint8_t window_y = (uint8_t)(y - regs->wy);
+                    uint16_t window_map_base = (regs->lcdc & MODE7_LCDC_WINDOW_TILE_MAP) ? 0x9C00u : 0x9800u;
+                    bg_color_id = mode7_fetch_tile_color(layout, window_map_base, tile_data_base, signed_indexing, window_x, window_y);
+                    if ((window_x & 7u) == 0u) {
+                        VIRTUAPPU_STATS_ADD(ctx, y, tiles_fetched, 1u);
+                    }
+                }
+            }
+
+            bg_color = mode7_palette_color(regs->bgp, bg_color_id);
         }
-        return;
-    }
 
-    for (y = 0u; y < MODE7_GB_SCREEN_HEIGHT; ++y) {
-        Mode7SpriteCandidate sprites[10];
-        uint8_t sprite_count = 0u;
-        uint8_t x;
+        final_color = bg_color;
 
-        if ((regs->lcdc & MODE7_LCDC_OBJ_ENABLE) != 0u) {
+        if ((regs->lcdc & MODE7_LCDC_OBJ_ENABLE) != 0u && sprite_count > 0u) {
             uint8_t sprite_height = (regs->lcdc & MODE7_LCDC_OBJ_SIZE) ? 16u : 8u;
-            sprite_count = mode7_eval_sprites(layout, y, sprite_height, sprites);
-        }
+            uint8_t i;
+
+            for (i = 0u; i < sprite_count; ++i) {
+                int screen_x = (int)sprites[i].x - 8;
+                uint8_t pixel_x;
+                uint8_t attributes;
+                uint8_t tile_index;
+                uint8_t line_in_sprite;
+                uint16_t tile_addr;
+                uint16_t row_addr;
+                uint8_t low;
+                uint8_t high;
+                uint8_t bit;
+                uint8_t color_id;
+                uint8_t palette;
+
+                if (x < screen_x || x >= screen_x + 8) {
+                    continue;
+                }
 
-        for (x = 0u; x < MODE7_GB_SCREEN_WIDTH; ++x) {
-            uint8_t bg_color_id = 0u;
-            uint32_t bg_color = mode7_palette_color(regs->bgp, 0u);
-            uint32_t final_color;
-
-            if ((regs->lcdc & MODE7_LCDC_BG_ENABLE) != 0u) {
-                uint16_t tile_map_base = (regs->lcdc & MODE7_LCDC_BG_TILE_MAP) ? 0x9C00u : 0x9800u;
-                uint16_t tile_data_base = (regs->lcdc & MODE7_LCDC_BG_WINDOW_TILE_DATA) ? 0x8000u : 0x9000u;
-                int signed_indexing = (regs->lcdc & MODE7_LCDC_BG_WINDOW_TILE_DATA) == 0u;
-                uint8_t bg_x = (uint8_t)(x + regs->scx);
-                uint8_t bg_y = (uint8_t)(y + regs->scy);
-
-                bg_color_id = mode7_fetch_tile_color(layout, tile_map_base, tile_data_base, signed_indexing, bg_x, bg_y);
-
-                if ((regs->lcdc & MODE7_LCDC_WINDOW_ENABLE) != 0u && regs->wy <= y) {
-                    uint8_t window_x_origin = (regs->wx > 7u) ? (uint8_t)(regs->wx - 7u) : 0u;
-                    if (x >= window_x_origin && regs->wx <= 166u) {
-                        uint8_t window_x = (uint8_t)(x - window_x_origin);
-                        uint8_t window_y = (uint8_t)(y - regs->wy);
-                        uint16_t window_map_base = (regs->lcdc & MODE7_LCDC_WINDOW_TILE_MAP) ? 0x9C00u : 0x9800u;
-                        bg_color_id = mode7_fetch_tile_color(layout, window_map_base, tile_data_base, signed_indexing, window_x, window_y);
-                    }
+                pixel_x = (uint8_t)(x - screen_x);
+                attributes = sprites[i].attributes;
+                if ((attributes & 0x20u) != 0u) {
+                    pixel_x = (uint8_t)(7u - pixel_x);
+                }
+
+                tile_index = sprites[i].tile;
+                line_in_sprite = sprites[i].line;
+                if (sprite_height == 16u) {
+                    tile_index = (uint8_t)((tile_index & 0xFEu) | (line_in_sprite >= 8u));
+                    line_in_sprite &= 0x07u;
                 }
 
-                bg_color = mode7_palette_color(regs->bgp, bg_color_id);
+                tile_addr = (uint16_t)(0x8000u + tile_index * 16u);
+                row_addr = (uint16_t)(tile_addr + line_in_sprite * 2u);
+                low = mode7_vram_read(layout, row_addr);
+                high = mode7_vram_read(layout, (uint16_t)(row_addr + 1u));
+                bit = (uint8_t)(7u - pixel_x);
+                color_id = (uint8_t)((((high >> bit) & 0x01u) << 1u) | ((low >> bit) & 0x01u));
+
+                if (color_id == 0u) {
+                    continue;
+                }
+
+                palette = (attributes & 0x10u) ? regs->obp1 : regs->obp0;
+                if ((attributes & 0x80u) != 0u && bg_color_id != 0u) {
+                    final_color = bg_color;
+                } else {
+                    final_color = mode7_palette_color(palette, color_id);
+                }
+                break;
             }
+        }
 
-            final_color = bg_color;
-
-            if ((regs->lcdc & MODE7_LCDC_OBJ_ENABLE) != 0u && sprite_count > 0u) {
-                uint8_t sprite_height = (regs->lcdc & MODE7_LCDC_OBJ_SIZE) ? 16u : 8u;
-                uint8_t i;
-
-                for (i = 0u; i < sprite_count; ++i) {
-                    int screen_x = (int)sprites[i].x - 8;
-                    uint8_t pixel_x;
-                    uint8_t attributes;
-                    uint8_t tile_index;
-                    uint8_t line_in_sprite;
-                    uint16_t tile_addr;
-                    uint16_t row_addr;
-                    uint8_t low;
-                    uint8_t high;
-                    uint8_t bit;
-                    uint8_t color_id;
-                    uint8_t palette;
-
-                    if (x < screen_x || x >= screen_x + 8) {
-                        continue;
-                    }
+        out_line[x] = final_color;
+    }
 
-                    pixel_x = (uint8_t)(x - screen_x);
-                    attributes = sprites[i].attributes;
-                    if ((attributes & 0x20u) != 0u) {
-                        pixel_x = (uint8_t)(7u - pixel_x);
-                    }
+    VIRTUAPPU_STATS_LAP(ctx, y, VIRTUAPPU_STATS_STAGE_COMPOSITE, timer);
+    virtuappu_write_line(ctx, y, out_line, MODE7_GB_SCREEN_WIDTH);
+}
 
-                    tile_index = sprites[i].tile;
-                    line_in_sprite = sprites[i].line;
-                    if (sprite_height == 16u) {
-                        tile_index = (uint8_t)((tile_index & 0xFEu) | (line_in_sprite >= 8u));
-                        line_in_sprite &= 0x07u;
-                    }
+void virtuappu_mode7_render_lines_ctx(VirtuaPPUContext *ctx, size_t first_line, size_t end_line)
+{
+    const Mode7Layout *layout;
+    size_t line;
 
-                    tile_addr = (uint16_t)(0x8000u + tile_index * 16u);
-                    row_addr = (uint16_t)(tile_addr + line_in_sprite * 2u);
-                    low = mode7_vram_read(layout, row_addr);
-                    high = mode7_vram_read(layout, (uint16_t)(row_addr + 1u));
-                    bit = (uint8_t)(7u - pixel_x);
-                    color_id = (uint8_t)((((high >> bit) & 0x01u) << 1u) | ((low >> bit) & 0x01u));
+    if (!virtuappu_context_supports_mode(ctx, 7u)) {
+        return;
+    }
 
-                    if (color_id == 0u) {
-                        continue;
-                    }
+    if (end_line > MODE7_GB_SCREEN_HEIGHT) {
+        end_line = MODE7_GB_SCREEN_HEIGHT;
+    }
+    if (first_line >= end_line) {
+        return;
+    }
 
-                    palette = (attributes & 0x10u) ? regs->obp1 : regs->obp0;
-                    if ((attributes & 0x80u) != 0u && bg_color_id != 0u) {
-                        final_color = bg_color;
-                    } else {
-                        final_color = mode7_palette_color(palette, color_id);
-                    }
-                    break;
-                }
-            }
+    /* Registers are read per range so mid-frame SCX/SCY/LCDC writes land on the following lines. */
+    layout = mode7_get_layout(ctx);
+    if ((layout->regs.lcdc & MODE7_LCDC_ENABLE) == 0u) {
+        uint32_t clear_color = mode7_palette_color(layout->regs.bgp, 0u);
+        virtuappu_fill_lines(ctx, first_line, end_line - first_line, MODE7_GB_SCREEN_WIDTH, clear_color);
+        return;
+    }
 
-            virtuappu_frame_buffer[(size_t)y * MODE7_GB_SCREEN_WIDTH + x] = final_color;
-        }
+    for (line = first_line; line < end_line; ++line) {
+        mode7_render_line(ctx, layout, (uint8_t)line);
     }
 }
+
+void virtuappu_mode7_render_frame_ctx(VirtuaPPUContext *ctx)
+{
+    if (ctx == NULL) {
+        return;
+    }
+
+    VIRTUAPPU_STATS_BEGIN_FRAME(ctx, MODE7_GB_SCREEN_HEIGHT);
+    virtuappu_mode7_render_lines_ctx(ctx, 0u, MODE7_GB_SCREEN_HEIGHT);
+    VIRTUAPPU_STATS_END_FRAME(ctx);
+}
+
+void virtuappu_mode7_render_frame(const PPUMemory *ppu)
+{
+    (void)ppu;
+
+    virtuappu_mode7_render_frame_ctx(virtuappu_get_default_context());
+}
@@ -0,0 +1,67 @@
+#include "offline.h"
+
+#include <stddef.h>
+
+#include "virtuappu.h"
+
+uint64_t virtuappu_render_offline(
+    VirtuaPPUOfflineSourceFn source,
+    VirtuaPPUOfflineSinkFn sink,
+    void *user,
+    uint32_t frames_in_flight)
+{
+    VirtuaPPUContext *frames[VIRTUAPPU_OFFLINE_MAX_FRAMES_IN_FLIGHT];
+    uint64_t rendered = 0u;
+    bool more = true;
+    uint32_t i;
+
+    if (source == NULL) {
+        return 0u;
+    }
+
+    if (frames_in_flight == 0u) {
+        frames_in_flight = VIRTUAPPU_OFFLINE_DEFAULT_FRAMES_IN_FLIGHT;
+    }
+    if (frames_in_flight > VIRTUAPPU_OFFLINE_MAX_FRAMES_IN_FLIGHT) {
+        frames_in_flight = VIRTUAPPU_OFFLINE_MAX_FRAMES_IN_FLIGHT;
+    }
+
+    for (i = 0; i < frames_in_flight; ++i) {
+        frames[i] = virtuappu_context_create();
+        if (frames[i] == NULL) {
+            frames_in_flight = i;
+            break;
+        }
+    }
+
+    while (more && frames_in_flight != 0u) {
+        uint32_t count;
+
+        /* The source runs serially and in order, so it may carry state from one frame to the next. */
+        for (count = 0; count < frames_in_flight; ++count) {
+            if (!source(user, rendered + count, frames[count])) {
+                more = false;
+                break;
+            }
+        }
+
+        if (count == 0u) {
+            break;
+        }
+
+        virtuappu_render_batch(frames, count);
+
+        if (sink != NULL) {
+            for (i = 0; i < count; ++i) {
+                sink(user, rendered + i, frames[i]);
+            }
+        }
+        rendered += count;
+    }
+
+    for (i = 0; i < frames_in_flight; ++i) {
+        virtuappu_context_destroy(frames[i]);
+    }
+
+    return rendered;
+}
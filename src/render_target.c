@@ -0,0 +1,502 @@
+#include "render_target.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "simd.h"
+#include "virtuappu.h"
+
+_Static_assert(VIRTUAPPU_MAX_FRAME_WIDTH <= VIRTUAPPU_DIRTY_BLOCK_SIZE * 64 * VIRTUAPPU_DIRTY_WORDS_PER_ROW, "Dirty rows too narrow");
+_Static_assert(VIRTUAPPU_MAX_FRAME_HEIGHT <= VIRTUAPPU_DIRTY_BLOCK_SIZE * VIRTUAPPU_DIRTY_MAX_ROWS, "Dirty map too short");
+
+static uint32_t render_target_abgr_to_argb(uint32_t abgr)
+{
+    return (abgr & 0xFF00FF00u) | ((abgr >> 16u) & 0xFFu) | ((abgr & 0xFFu) << 16u);
+}
+
+static uint16_t render_target_abgr_to_rgb565(uint32_t abgr)
+{
+    return (uint16_t)(((abgr & 0xF8u) << 8u) | ((abgr >> 5u) & 0x07E0u) | ((abgr >> 19u) & 0x1Fu));
+}
+
+static uint16_t render_target_abgr_to_xrgb1555(uint32_t abgr)
+{
+    return (uint16_t)(((abgr & 0xF8u) << 7u) | ((abgr >> 6u) & 0x03E0u) | ((abgr >> 19u) & 0x1Fu));
+}
+
+/* Colours get palette slots in the order they are first written; once the palette is full, or the lookup
+ * table is mostly used, a colour maps to the nearest existing entry. */
+static uint32_t render_target_nearest_slot(const VirtuaPPUOutputPalette *palette, uint32_t abgr)
+{
+    uint32_t best = 0u;
+    uint32_t best_distance = 0xFFFFFFFFu;
+    uint32_t i;
+
+    for (i = 0; i < palette->count; ++i) {
+        int dr = (int)(abgr & 0xFFu) - (int)(palette->colors[i] & 0xFFu);
+        int dg = (int)((abgr >> 8u) & 0xFFu) - (int)((palette->colors[i] >> 8u) & 0xFFu);
+        int db = (int)((abgr >> 16u) & 0xFFu) - (int)((palette->colors[i] >> 16u) & 0xFFu);
+        uint32_t distance = (uint32_t)(dr * dr + dg * dg + db * db);
+
+        if (distance < best_distance) {
+            best = i;
+            best_distance = distance;
+        }
+    }
+
+    return best;
+}
+
+/* Past the lookup table, colours are bucketed by the top 4 bits of each channel and a bucket is searched
+ * once, from its centre, so a frame full of distinct colours does not rescan the palette per colour. The
+ * palette is frozen once full, so buckets stay valid until the next reset. */
+static uint32_t render_target_bucket_nearest_slot(VirtuaPPUOutputPalette *palette, uint32_t abgr)
+{
+    uint32_t cell = ((abgr >> 4u) & 0x00Fu) | ((abgr >> 8u) & 0x0F0u) | ((abgr >> 12u) & 0xF00u);
+    uint32_t slot;
+
+    if (palette->nearest_cells[cell] != 0u) {
+        return palette->nearest_cells[cell] - 1u;
+    }
+
+    slot = render_target_nearest_slot(palette, (abgr & 0xFFF0F0F0u) | 0x00080808u);
+    palette->nearest_cells[cell] = (uint16_t)(slot + 1u);
+    return slot;
+}
+
+static uint16_t render_target_palette_slot(VirtuaPPUOutputPalette *palette, uint32_t abgr, uint32_t capacity)
+{
+    uint32_t bucket = (abgr * 0x9E3779B1u) >> 19u;
+    uint32_t slot;
+
+    while (palette->slots[bucket] != 0u) {
+        if (palette->keys[bucket] == abgr) {
+            return (uint16_t)(palette->slots[bucket] - 1u);
+        }
+        bucket = (bucket + 1u) & (VIRTUAPPU_OUTPUT_PALETTE_HASH - 1u);
+    }
+
+    if (palette->count < capacity) {
+        slot = palette->count++;
+        palette->colors[slot] = abgr;
+    } else {
+        slot = render_target_bucket_nearest_slot(palette, abgr);
+    }
+
+    if (palette->hash_used < VIRTUAPPU_OUTPUT_PALETTE_HASH / 2u) {
+        palette->keys[bucket] = abgr;
+        palette->slots[bucket] = (uint16_t)(slot + 1u);
+        ++palette->hash_used;
+    }
+
+    return (uint16_t)slot;
+}
+
+static void render_target_index_line(VirtuaPPUContext *ctx, uint16_t *dst, const uint32_t *pixels, size_t width, uint32_t capacity)
+{
+    uint32_t previous = 0u;
+    uint16_t previous_slot = 0u;
+    size_t x;
+
+    for (x = 0; x < width; ++x) {
+        if (x == 0u || pixels[x] != previous) {
+            previous = pixels[x];
+            previous_slot = render_target_palette_slot(ctx->output_palette, previous, capacity);
+        }
+        dst[x] = previous_slot;
+    }
+}
+
+static uint8_t *render_target_row(const VirtuaPPUContext *ctx, size_t line, size_t width)
+{
+    if (ctx->target.pixels == NULL) {
+        return (uint8_t *)&ctx->frame_buffer[line * width];
+    }
+
+    return (uint8_t *)ctx->target.pixels + line * ctx->target.pitch;
+}
+
+static VirtuaPPUPixelFormat render_target_format(const VirtuaPPUContext *ctx)
+{
+    return (ctx->target.pixels == NULL) ? VIRTUAPPU_FORMAT_ABGR8888 : ctx->target.format;
+}
+
+size_t virtuappu_pixel_format_bytes(VirtuaPPUPixelFormat format)
+{
+    switch (format) {
+    case VIRTUAPPU_FORMAT_ABGR8888:
+    case VIRTUAPPU_FORMAT_ARGB8888:
+        return 4u;
+    case VIRTUAPPU_FORMAT_RGB565:
+    case VIRTUAPPU_FORMAT_XRGB1555:
+    case VIRTUAPPU_FORMAT_INDEX16:
+        return 2u;
+    case VIRTUAPPU_FORMAT_INDEX8:
+        return 1u;
+    default:
+        return 0u;
+    }
+}
+
+bool virtuappu_pixel_format_is_indexed(VirtuaPPUPixelFormat format)
+{
+    return format == VIRTUAPPU_FORMAT_INDEX8 || format == VIRTUAPPU_FORMAT_INDEX16;
+}
+
+void virtuappu_set_render_target_ctx(VirtuaPPUContext *ctx, const VirtuaPPURenderTarget *target)
+{
+    if (ctx == NULL) {
+        return;
+    }
+
+    if (target == NULL || target->pixels == NULL || virtuappu_pixel_format_bytes(target->format) == 0u ||
+        target->scale > VIRTUAPPU_MAX_OUTPUT_SCALE) {
+        memset(&ctx->target, 0, sizeof(ctx->target));
+        ctx->dirty_primed = false;
+        return;
+    }
+
+    /* The output palette is only needed by indexed targets, so contexts allocate it on first use. */
+    if (virtuappu_pixel_format_is_indexed(target->format) && ctx->output_palette == NULL) {
+        ctx->output_palette = (VirtuaPPUOutputPalette *)calloc(1u, sizeof(*ctx->output_palette));
+        if (ctx->output_palette == NULL) {
+            memset(&ctx->target, 0, sizeof(ctx->target));
+            ctx->dirty_primed = false;
+            return;
+        }
+    }
+
+    ctx->target = *target;
+    ctx->dirty_primed = false;
+}
+
+void virtuappu_set_render_target(const VirtuaPPURenderTarget *target)
+{
+    virtuappu_set_render_target_ctx(virtuappu_get_default_context(), target);
+}
+
+static void render_target_convert(VirtuaPPUContext *ctx, void *dst, const uint32_t *pixels, size_t width, VirtuaPPUPixelFormat format)
+{
+    size_t x;
+
+    switch (format) {
+    case VIRTUAPPU_FORMAT_ABGR8888:
+        memcpy(dst, pixels, width * sizeof(uint32_t));
+        break;
+    case VIRTUAPPU_FORMAT_ARGB8888: {
+        uint32_t *out = (uint32_t *)dst;
+        for (x = 0; x < width; ++x) {
+            out[x] = render_target_abgr_to_argb(pixels[x]);
+        }
+        break;
+    }
+    case VIRTUAPPU_FORMAT_RGB565: {
+        uint16_t *out = (uint16_t *)dst;
+        for (x = 0; x < width; ++x) {
+            out[x] = render_target_abgr_to_rgb565(pixels[x]);
+        }
+        break;
+    }
+    case VIRTUAPPU_FORMAT_XRGB1555: {
+        uint16_t *out = (uint16_t *)dst;
+        for (x = 0; x < width; ++x) {
+            out[x] = render_target_abgr_to_xrgb1555(pixels[x]);
+        }
+        break;
+    }
+    case VIRTUAPPU_FORMAT_INDEX8: {
+        uint16_t slots[VIRTUAPPU_MAX_FRAME_WIDTH];
+        uint8_t *out = (uint8_t *)dst;
+        render_target_index_line(ctx, slots, pixels, width, 256u);
+        for (x = 0; x < width; ++x) {
+            out[x] = (uint8_t)slots[x];
+        }
+        break;
+    }
+    case VIRTUAPPU_FORMAT_INDEX16:
+        render_target_index_line(ctx, (uint16_t *)dst, pixels, width, VIRTUAPPU_OUTPUT_PALETTE_MAX);
+        break;
+    default:
+        break;
+    }
+}
+
+static void render_target_expand32(uint32_t *dst, const uint32_t *src, size_t width, size_t scale)
+{
+    size_t x = 0u;
+    size_t k;
+
+#if defined(__SSE2__)
+    if (scale == 2u) {
+        for (; x + 4u <= width; x += 4u) {
+            __m128i v = _mm_loadu_si128((const __m128i *)&src[x]);
+            _mm_storeu_si128((__m128i *)&dst[x * 2u], _mm_unpacklo_epi32(v, v));
+            _mm_storeu_si128((__m128i *)&dst[x * 2u + 4u], _mm_unpackhi_epi32(v, v));
+        }
+    } else if (scale >= 4u) {
+        for (; x < width; ++x) {
+            __m128i v = _mm_set1_epi32((int)src[x]);
+            _mm_storeu_si128((__m128i *)&dst[x * scale], v);
+            for (k = 4u; k < scale; ++k) {
+                dst[x * scale + k] = src[x];
+            }
+        }
+    }
+#endif
+
+    for (; x < width; ++x) {
+        for (k = 0; k < scale; ++k) {
+            dst[x * scale + k] = src[x];
+        }
+    }
+}
+
+static void render_target_expand16(uint16_t *dst, const uint16_t *src, size_t width, size_t scale)
+{
+    size_t x = 0u;
+    size_t k;
+
+#if defined(__SSE2__)
+    if (scale == 2u) {
+        for (; x + 8u <= width; x += 8u) {
+            __m128i v = _mm_loadu_si128((const __m128i *)&src[x]);
+            _mm_storeu_si128((__m128i *)&dst[x * 2u], _mm_unpacklo_epi16(v, v));
+            _mm_storeu_si128((__m128i *)&dst[x * 2u + 8u], _mm_unpackhi_epi16(v, v));
+        }
+    } else if (scale == 4u) {
+        for (; x + 4u <= width; x += 4u) {
+            __m128i v = _mm_loadl_epi64((const __m128i *)&src[x]);
+            __m128i pairs = _mm_unpacklo_epi16(v, v);
+            _mm_storeu_si128((__m128i *)&dst[x * 4u], _mm_unpacklo_epi32(pairs, pairs));
+            _mm_storeu_si128((__m128i *)&dst[x * 4u + 8u], _mm_unpackhi_epi32(pairs, pairs));
+        }
+    }
+#endif
+
+    for (; x < width; ++x) {
+        for (k = 0; k < scale; ++k) {
+            dst[x * scale + k] = src[x];
+        }
+    }
+}
+
+static void render_target_expand8(uint8_t *dst, const uint8_t *src, size_t width, size_t scale)
+{
+    size_t x;
+
+    for (x = 0; x < width; ++x) {
+        memset(&dst[x * scale], src[x], scale);
+    }
+}
+
+static void render_target_darken(void *dst, const void *src, size_t count, VirtuaPPUPixelFormat format)
+{
+    size_t x;
+
+    if (virtuappu_pixel_format_bytes(format) == 4u) {
+        const uint32_t *in = (const uint32_t *)src;
+        uint32_t *out = (uint32_t *)dst;
+        for (x = 0; x < count; ++x) {
+            out[x] = (in[x] & 0xFF000000u) | ((in[x] >> 1u) & 0x007F7F7Fu);
+        }
+    } else {
+        const uint16_t mask = (format == VIRTUAPPU_FORMAT_RGB565) ? 0x7BEFu : 0x3DEFu;
+        const uint16_t *in = (const uint16_t *)src;
+        uint16_t *out = (uint16_t *)dst;
+        for (x = 0; x < count; ++x) {
+            out[x] = (uint16_t)((in[x] >> 1u) & mask);
+        }
+    }
+}
+
+static void render_target_write_line(VirtuaPPUContext *ctx, size_t line, const uint32_t *pixels, size_t width)
+{
+    const VirtuaPPUPixelFormat format = render_target_format(ctx);
+    const size_t scale = (ctx->target.pixels != NULL && ctx->target.scale > 1u) ? ctx->target.scale : 1u;
+    union {
+        uint32_t u32[VIRTUAPPU_MAX_FRAME_WIDTH];
+        uint16_t u16[VIRTUAPPU_MAX_FRAME_WIDTH];
+        uint8_t u8[VIRTUAPPU_MAX_FRAME_WIDTH];
+    } converted;
+    size_t bytes_per_pixel;
+    size_t row_bytes;
+    uint8_t *first_row;
+    size_t k;
+
+    if (scale == 1u) {
+        render_target_convert(ctx, render_target_row(ctx, line, width), pixels, width, format);
+        return;
+    }
+
+    bytes_per_pixel = virtuappu_pixel_format_bytes(format);
+    row_bytes = width * scale * bytes_per_pixel;
+    first_row = (uint8_t *)ctx->target.pixels + line * scale * ctx->target.pitch;
+
+    render_target_convert(ctx, &converted, pixels, width, format);
+    if (bytes_per_pixel == 4u) {
+        render_target_expand32((uint32_t *)first_row, converted.u32, width, scale);
+    } else if (bytes_per_pixel == 2u) {
+        render_target_expand16((uint16_t *)first_row, converted.u16, width, scale);
+    } else {
+        render_target_expand8(first_row, converted.u8, width, scale);
+    }
+
+    /* Indices cannot be darkened, so indexed targets repeat the line without scanlines. */
+    for (k = 1u; k < scale; ++k) {
+        uint8_t *row = first_row + k * ctx->target.pitch;
+
+        if (ctx->target.scanlines && k + 1u == scale && !virtuappu_pixel_format_is_indexed(format)) {
+            render_target_darken(row, first_row, width * scale, format);
+        } else {
+            memcpy(row, first_row, row_bytes);
+        }
+    }
+}
+
+static void render_target_track_line(VirtuaPPUContext *ctx, size_t line, const uint32_t *pixels, size_t width)
+{
+    uint32_t *previous = &ctx->frame_buffer[line * width];
+    uint64_t *mask = ctx->dirty_lines[line];
+    bool full = !ctx->dirty_primed || width != ctx->dirty_width;
+    size_t block;
+    size_t x0;
+
+    memset(mask, 0, sizeof(ctx->dirty_lines[0]));
+    for (block = 0, x0 = 0; x0 < width; ++block, x0 += VIRTUAPPU_DIRTY_BLOCK_SIZE) {
+        size_t count = (x0 + VIRTUAPPU_DIRTY_BLOCK_SIZE <= width) ? VIRTUAPPU_DIRTY_BLOCK_SIZE : width - x0;
+
+        if (full || memcmp(&previous[x0], &pixels[x0], count * sizeof(uint32_t)) != 0) {
+            mask[block / 64u] |= (uint64_t)1u << (block % 64u);
+        }
+    }
+
+    /* External targets keep the previous frame in frame_buffer so the comparison stays in ABGR8888. */
+    if (ctx->target.pixels != NULL) {
+        memcpy(previous, pixels, width * sizeof(uint32_t));
+    }
+}
+
+void virtuappu_write_line(VirtuaPPUContext *ctx, size_t line, const uint32_t *pixels, size_t width)
+{
+    VIRTUAPPU_STATS_TIMER(timer);
+
+    if (ctx->dirty_tracking) {
+        render_target_track_line(ctx, line, pixels, width);
+    }
+    render_target_write_line(ctx, line, pixels, width);
+    VIRTUAPPU_STATS_LAP(ctx, line, VIRTUAPPU_STATS_STAGE_OUTPUT, timer);
+}
+
+void virtuappu_set_dirty_tracking_ctx(VirtuaPPUContext *ctx, bool enabled)
+{
+    if (ctx == NULL) {
+        return;
+    }
+
+    ctx->dirty_tracking = enabled;
+    ctx->dirty_primed = false;
+    memset(ctx->dirty_lines, 0, sizeof(ctx->dirty_lines));
+}
+
+void virtuappu_set_dirty_tracking(bool enabled)
+{
+    virtuappu_set_dirty_tracking_ctx(virtuappu_get_default_context(), enabled);
+}
+
+bool virtuappu_get_dirty_map_ctx(const VirtuaPPUContext *ctx, VirtuaPPUDirtyMap *map)
+{
+    uint32_t line;
+    uint32_t row;
+    uint32_t word;
+
+    if (map == NULL) {
+        return false;
+    }
+
+    memset(map, 0, sizeof(*map));
+    if (ctx == NULL || !ctx->dirty_tracking || !virtuappu_get_frame_size_ctx(ctx, &map->width, &map->height)) {
+        return false;
+    }
+
+    map->blocks_x = (map->width + VIRTUAPPU_DIRTY_BLOCK_SIZE - 1u) / VIRTUAPPU_DIRTY_BLOCK_SIZE;
+    map->blocks_y = (map->height + VIRTUAPPU_DIRTY_BLOCK_SIZE - 1u) / VIRTUAPPU_DIRTY_BLOCK_SIZE;
+
+    for (line = 0; line < map->height; ++line) {
+        for (word = 0; word < VIRTUAPPU_DIRTY_WORDS_PER_ROW; ++word) {
+            map->rows[line / VIRTUAPPU_DIRTY_BLOCK_SIZE][word] |= ctx->dirty_lines[line][word];
+        }
+    }
+
+    for (row = 0; row < map->blocks_y; ++row) {
+        for (word = 0; word < VIRTUAPPU_DIRTY_WORDS_PER_ROW; ++word) {
+            uint64_t bits = map->rows[row][word];
+
+            while (bits != 0u) {
+                bits &= bits - 1u;
+                ++map->dirty_blocks;
+            }
+        }
+    }
+
+    return true;
+}
+
+bool virtuappu_get_dirty_map(VirtuaPPUDirtyMap *map)
+{
+    return virtuappu_get_dirty_map_ctx(virtuappu_get_default_context(), map);
+}
+
+void virtuappu_reset_output_palette(VirtuaPPUContext *ctx)
+{
+    VirtuaPPUOutputPalette *palette = ctx->output_palette;
+
+    if (!virtuappu_pixel_format_is_indexed(ctx->target.format) || (palette->count == 0u && palette->hash_used == 0u)) {
+        return;
+    }
+
+    palette->count = 0u;
+    palette->hash_used = 0u;
+    memset(palette->slots, 0, sizeof(palette->slots));
+    memset(palette->nearest_cells, 0, sizeof(palette->nearest_cells));
+}
+
+uint32_t virtuappu_get_output_palette_ctx(const VirtuaPPUContext *ctx, uint32_t *abgr, uint32_t capacity)
+{
+    uint32_t count;
+
+    if (ctx == NULL || !virtuappu_pixel_format_is_indexed(ctx->target.format)) {
+        return 0u;
+    }
+
+    count = ctx->output_palette->count;
+    if (abgr != NULL) {
+        memcpy(abgr, ctx->output_palette->colors, ((capacity < count) ? capacity : count) * sizeof(uint32_t));
+    }
+
+    return count;
+}
+
+uint32_t virtuappu_get_output_palette(uint32_t *abgr, uint32_t capacity)
+{
+    return virtuappu_get_output_palette_ctx(virtuappu_get_default_context(), abgr, capacity);
+}
+
+void virtuappu_fill_lines(VirtuaPPUContext *ctx, size_t first_line, size_t line_count, size_t width, uint32_t abgr)
+{
+    uint32_t pixels[VIRTUAPPU_MAX_FRAME_WIDTH];
+    size_t line;
+
+    if (width > VIRTUAPPU_MAX_FRAME_WIDTH) {
+        width = VIRTUAPPU_MAX_FRAME_WIDTH;
+    }
+
+    virtuappu_simd_kernels()->fill32(pixels, abgr, width);
+
+    for (line = first_line; line < first_line + line_count; ++line) {
+        virtuappu_write_line(ctx, line, pixels, width);
+    }
+}
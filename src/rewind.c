@@ -0,0 +1,436 @@
+#include "rewind.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "virtuappu.h"
+
+enum {
+    REWIND_VRAM_PAGES = VIRTUAPPU_VRAM_SIZE / VIRTUAPPU_REWIND_PAGE_BYTES,
+    REWIND_STAGING_PAGES = (sizeof(Mode1Layout) + VIRTUAPPU_REWIND_PAGE_BYTES - 1u) / VIRTUAPPU_REWIND_PAGE_BYTES,
+    REWIND_PAGE_HEADER_BYTES = 4u,
+    REWIND_TOKEN_HEADER_BYTES = 4u
+};
+
+_Static_assert(VIRTUAPPU_VRAM_SIZE % VIRTUAPPU_REWIND_PAGE_BYTES == 0, "VRAM must be a whole number of rewind pages");
+_Static_assert(REWIND_VRAM_PAGES + REWIND_STAGING_PAGES <= 0x10000, "Rewind page indices must fit in 16 bits");
+
+typedef struct RewindRecord {
+    size_t size;
+    PPUMemory registers;
+    uint8_t data[];
+} RewindRecord;
+
+struct VirtuaPPURewind {
+    uint8_t *shadow;
+    uint8_t *staging;
+    uint8_t *scratch;
+    size_t scratch_capacity;
+    RewindRecord **records;
+    uint32_t max_records;
+    uint32_t record_head;
+    uint32_t record_count;
+    size_t delta_bytes;
+    size_t budget_bytes;
+    PPUMemory registers;
+    bool has_snapshot;
+    uint32_t last_changed_pages;
+    size_t last_delta_bytes;
+};
+
+static bool rewind_bound_externally(const VirtuaPPUContext *ctx)
+{
+    const VirtuaPPUMode1GbaMemory *memory = &ctx->mode1_memory;
+    uint8_t mode = ctx->registers->mode;
+
+    if (mode != 1u && mode != 2u) {
+        return false;
+    }
+    if (ctx->vram_size < sizeof(Mode1Layout)) {
+        return true;
+    }
+
+    return memory->io_mem != ctx->vram + offsetof(Mode1Layout, io_mem) ||
+           memory->vram != ctx->vram + offsetof(Mode1Layout, vram) ||
+           (uint8_t *)memory->bg_palette != ctx->vram + offsetof(Mode1Layout, bg_palette) ||
+           (uint8_t *)memory->obj_palette != ctx->vram + offsetof(Mode1Layout, obj_palette) ||
+           (uint8_t *)memory->oam_mem != ctx->vram + offsetof(Mode1Layout, oam_mem);
+}
+
+/* Externally bound Mode 1 memory is gathered into a Mode1Layout image that follows VRAM in the page space. */
+static void rewind_gather(VirtuaPPURewind *rewind, const VirtuaPPUContext *ctx)
+{
+    const VirtuaPPUMode1GbaMemory *memory = &ctx->mode1_memory;
+    Mode1Layout *layout = (Mode1Layout *)rewind->staging;
+
+    memcpy(layout->io_mem, memory->io_mem, sizeof(layout->io_mem));
+    memcpy(layout->vram, memory->vram, sizeof(layout->vram));
+    memcpy(layout->bg_palette, memory->bg_palette, sizeof(layout->bg_palette));
+    memcpy(layout->obj_palette, memory->obj_palette, sizeof(layout->obj_palette));
+    memcpy(layout->oam_mem, memory->oam_mem, sizeof(layout->oam_mem));
+}
+
+static void rewind_scatter(const VirtuaPPURewind *rewind, VirtuaPPUContext *ctx)
+{
+    const VirtuaPPUMode1GbaMemory *memory = &ctx->mode1_memory;
+    const Mode1Layout *layout = (const Mode1Layout *)(rewind->shadow + VIRTUAPPU_VRAM_SIZE);
+
+    memcpy(memory->io_mem, layout->io_mem, sizeof(layout->io_mem));
+    memcpy(memory->vram, layout->vram, sizeof(layout->vram));
+    memcpy(memory->bg_palette, layout->bg_palette, sizeof(layout->bg_palette));
+    memcpy(memory->obj_palette, layout->obj_palette, sizeof(layout->obj_palette));
+    memcpy(memory->oam_mem, layout->oam_mem, sizeof(layout->oam_mem));
+}
+
+static uint32_t rewind_footprint_pages(const VirtuaPPUContext *ctx, uint8_t mode)
+{
+    size_t bytes = virtuappu_mode_vram_footprint(mode);
+
+    /* Contexts sized for one mode hold fewer pages; bytes past their VRAM are not part of the snapshot. */
+    if (bytes > ctx->vram_size) {
+        bytes = ctx->vram_size;
+    }
+    return (uint32_t)((bytes + VIRTUAPPU_REWIND_PAGE_BYTES - 1u) / VIRTUAPPU_REWIND_PAGE_BYTES);
+}
+
+static void rewind_put_u16(uint8_t *dst, size_t value)
+{
+    dst[0] = (uint8_t)value;
+    dst[1] = (uint8_t)(value >> 8u);
+}
+
+static size_t rewind_get_u16(const uint8_t *src)
+{
+    return (size_t)src[0] | ((size_t)src[1] << 8u);
+}
+
+/* Pages are stored as old ^ new, so applying a record to the shadow steps it back one snapshot.
+ * Zero runs of four bytes or more are skipped; a page that does not shrink is stored raw. */
+static size_t rewind_encode_page(uint8_t *dst, const uint8_t *old_page, const uint8_t *new_page)
+{
+    uint8_t delta[VIRTUAPPU_REWIND_PAGE_BYTES];
+    size_t size = 0u;
+    size_t pos = 0u;
+    size_t i;
+
+    for (i = 0; i < VIRTUAPPU_REWIND_PAGE_BYTES; ++i) {
+        delta[i] = old_page[i] ^ new_page[i];
+    }
+
+    while (pos < VIRTUAPPU_REWIND_PAGE_BYTES) {
+        size_t skip_start = pos;
+        size_t end;
+
+        while (pos < VIRTUAPPU_REWIND_PAGE_BYTES && delta[pos] == 0u) {
+            ++pos;
+        }
+        if (pos == VIRTUAPPU_REWIND_PAGE_BYTES) {
+            break;
+        }
+
+        end = pos;
+        while (end < VIRTUAPPU_REWIND_PAGE_BYTES) {
+            size_t zero = end;
+
+            while (zero < VIRTUAPPU_REWIND_PAGE_BYTES && delta[zero] == 0u && zero - end < REWIND_TOKEN_HEADER_BYTES) {
+                ++zero;
+            }
+            if (zero == VIRTUAPPU_REWIND_PAGE_BYTES || zero - end == REWIND_TOKEN_HEADER_BYTES) {
+                break;
+            }
+            end = (zero == end) ? end + 1u : zero;
+        }
+
+        if (size + REWIND_TOKEN_HEADER_BYTES + (end - pos) >= VIRTUAPPU_REWIND_PAGE_BYTES) {
+            memcpy(dst, delta, VIRTUAPPU_REWIND_PAGE_BYTES);
+            return VIRTUAPPU_REWIND_PAGE_BYTES;
+        }
+
+        rewind_put_u16(dst + size, pos - skip_start);
+        rewind_put_u16(dst + size + 2u, end - pos);
+        memcpy(dst + size + REWIND_TOKEN_HEADER_BYTES, delta + pos, end - pos);
+        size += REWIND_TOKEN_HEADER_BYTES + (end - pos);
+        pos = end;
+    }
+
+    return size;
+}
+
+static void rewind_apply_page(uint8_t *page, const uint8_t *src, size_t size)
+{
+    size_t consumed = 0u;
+    size_t pos = 0u;
+    size_t i;
+
+    if (size == VIRTUAPPU_REWIND_PAGE_BYTES) {
+        for (i = 0; i < VIRTUAPPU_REWIND_PAGE_BYTES; ++i) {
+            page[i] ^= src[i];
+        }
+        return;
+    }
+
+    while (consumed < size) {
+        size_t count = rewind_get_u16(src + consumed + 2u);
+
+        pos += rewind_get_u16(src + consumed);
+        consumed += REWIND_TOKEN_HEADER_BYTES;
+        for (i = 0; i < count; ++i) {
+            page[pos + i] ^= src[consumed + i];
+        }
+        pos += count;
+        consumed += count;
+    }
+}
+
+static void rewind_apply_record(VirtuaPPURewind *rewind, const RewindRecord *record)
+{
+    size_t consumed = 0u;
+
+    while (consumed < record->size) {
+        size_t page = rewind_get_u16(record->data + consumed);
+        size_t size = rewind_get_u16(record->data + consumed + 2u);
+
+        consumed += REWIND_PAGE_HEADER_BYTES;
+        rewind_apply_page(rewind->shadow + page * VIRTUAPPU_REWIND_PAGE_BYTES, record->data + consumed, size);
+        consumed += size;
+    }
+
+    rewind->registers = record->registers;
+}
+
+static void rewind_drop_oldest(VirtuaPPURewind *rewind)
+{
+    RewindRecord *record = rewind->records[rewind->record_head];
+
+    rewind->delta_bytes -= record->size;
+    free(record);
+    rewind->records[rewind->record_head] = NULL;
+    rewind->record_head = (rewind->record_head + 1u) % rewind->max_records;
+    --rewind->record_count;
+}
+
+static bool rewind_diff_pages(VirtuaPPURewind *rewind, const uint8_t *source, uint32_t first_page, uint32_t page_count)
+{
+    uint32_t page;
+
+    for (page = 0; page < page_count; ++page) {
+        const uint8_t *src = source + (size_t)page * VIRTUAPPU_REWIND_PAGE_BYTES;
+        uint8_t *shadow = rewind->shadow + (size_t)(first_page + page) * VIRTUAPPU_REWIND_PAGE_BYTES;
+        size_t size;
+
+        if (memcmp(src, shadow, VIRTUAPPU_REWIND_PAGE_BYTES) == 0) {
+            continue;
+        }
+
+        if (rewind->last_delta_bytes + REWIND_PAGE_HEADER_BYTES + VIRTUAPPU_REWIND_PAGE_BYTES > rewind->scratch_capacity) {
+            size_t capacity = rewind->scratch_capacity * 2u;
+            uint8_t *scratch = (uint8_t *)realloc(rewind->scratch, capacity);
+
+            if (scratch == NULL) {
+                return false;
+            }
+            rewind->scratch = scratch;
+            rewind->scratch_capacity = capacity;
+        }
+
+        size = rewind_encode_page(rewind->scratch + rewind->last_delta_bytes + REWIND_PAGE_HEADER_BYTES, shadow, src);
+        rewind_put_u16(rewind->scratch + rewind->last_delta_bytes, first_page + page);
+        rewind_put_u16(rewind->scratch + rewind->last_delta_bytes + 2u, size);
+        rewind->last_delta_bytes += REWIND_PAGE_HEADER_BYTES + size;
+        ++rewind->last_changed_pages;
+        memcpy(shadow, src, VIRTUAPPU_REWIND_PAGE_BYTES);
+    }
+
+    return true;
+}
+
+VirtuaPPURewind *virtuappu_rewind_create(size_t budget_bytes, uint32_t max_snapshots)
+{
+    VirtuaPPURewind *rewind = (VirtuaPPURewind *)calloc(1u, sizeof(*rewind));
+
+    if (rewind == NULL) {
+        return NULL;
+    }
+
+    rewind->budget_bytes = budget_bytes ? budget_bytes : (size_t)VIRTUAPPU_REWIND_DEFAULT_BUDGET;
+    /* The shadow holds the newest snapshot, so one snapshot keeps no records at all. */
+    rewind->max_records = (max_snapshots != 0u ? max_snapshots : (uint32_t)VIRTUAPPU_REWIND_DEFAULT_SNAPSHOTS) - 1u;
+    rewind->scratch_capacity = 64u * 1024u;
+    rewind->shadow = (uint8_t *)calloc((size_t)(REWIND_VRAM_PAGES + REWIND_STAGING_PAGES), VIRTUAPPU_REWIND_PAGE_BYTES);
+    rewind->staging = (uint8_t *)calloc(REWIND_STAGING_PAGES, VIRTUAPPU_REWIND_PAGE_BYTES);
+    rewind->scratch = (uint8_t *)malloc(rewind->scratch_capacity);
+    rewind->records = (RewindRecord **)calloc(rewind->max_records ? rewind->max_records : 1u, sizeof(RewindRecord *));
+    if (rewind->shadow == NULL || rewind->staging == NULL || rewind->scratch == NULL || rewind->records == NULL) {
+        virtuappu_rewind_destroy(rewind);
+        return NULL;
+    }
+
+    return rewind;
+}
+
+void virtuappu_rewind_destroy(VirtuaPPURewind *rewind)
+{
+    if (rewind == NULL) {
+        return;
+    }
+
+    if (rewind->records != NULL) {
+        virtuappu_rewind_clear(rewind);
+    }
+    free(rewind->records);
+    free(rewind->scratch);
+    free(rewind->staging);
+    free(rewind->shadow);
+    free(rewind);
+}
+
+void virtuappu_rewind_clear(VirtuaPPURewind *rewind)
+{
+    if (rewind == NULL) {
+        return;
+    }
+
+    while (rewind->record_count != 0u) {
+        rewind_drop_oldest(rewind);
+    }
+    rewind->record_head = 0u;
+    rewind->has_snapshot = false;
+    rewind->last_changed_pages = 0u;
+    rewind->last_delta_bytes = 0u;
+}
+
+bool virtuappu_rewind_push(VirtuaPPURewind *rewind, const VirtuaPPUContext *ctx)
+{
+    bool external;
+    RewindRecord *record;
+
+    if (rewind == NULL || ctx == NULL) {
+        return false;
+    }
+
+    external = rewind_bound_externally(ctx);
+    if (external && !virtuappu_context_supports_mode(ctx, ctx->registers->mode)) {
+        return false;
+    }
+    if (external) {
+        rewind_gather(rewind, ctx);
+    }
+
+    /* The first snapshot seeds the shadow; later ones store only the pages that changed since. */
+    if (!rewind->has_snapshot) {
+        if (ctx->vram != NULL) {
+            memcpy(rewind->shadow, ctx->vram, ctx->vram_size);
+        }
+        if (external) {
+            memcpy(rewind->shadow + VIRTUAPPU_VRAM_SIZE, rewind->staging, (size_t)REWIND_STAGING_PAGES * VIRTUAPPU_REWIND_PAGE_BYTES);
+        }
+        rewind->registers = *ctx->registers;
+        rewind->has_snapshot = true;
+        rewind->last_changed_pages = REWIND_VRAM_PAGES;
+        rewind->last_delta_bytes = 0u;
+        return true;
+    }
+
+    rewind->last_changed_pages = 0u;
+    rewind->last_delta_bytes = 0u;
+    if (!rewind_diff_pages(rewind, ctx->vram, 0u, rewind_footprint_pages(ctx, ctx->registers->mode)) ||
+        (external && !rewind_diff_pages(rewind, rewind->staging, REWIND_VRAM_PAGES, REWIND_STAGING_PAGES))) {
+        virtuappu_rewind_clear(rewind);
+        return false;
+    }
+
+    /* A record that alone exceeds the budget drops the whole history, and a single-snapshot ring never keeps
+     * one; the shadow still holds this snapshot. */
+    if (rewind->max_records == 0u || rewind->last_delta_bytes > rewind->budget_bytes) {
+        while (rewind->record_count != 0u) {
+            rewind_drop_oldest(rewind);
+        }
+        rewind->registers = *ctx->registers;
+        return true;
+    }
+
+    record = (RewindRecord *)malloc(sizeof(*record) + rewind->last_delta_bytes);
+    if (record == NULL) {
+        virtuappu_rewind_clear(rewind);
+        return false;
+    }
+
+    while (rewind->record_count == rewind->max_records ||
+           (rewind->record_count != 0u && rewind->delta_bytes + rewind->last_delta_bytes > rewind->budget_bytes)) {
+        rewind_drop_oldest(rewind);
+    }
+
+    record->size = rewind->last_delta_bytes;
+    record->registers = rewind->registers;
+    memcpy(record->data, rewind->scratch, rewind->last_delta_bytes);
+    rewind->records[(rewind->record_head + rewind->record_count) % rewind->max_records] = record;
+    ++rewind->record_count;
+    rewind->delta_bytes += record->size;
+    rewind->registers = *ctx->registers;
+    return true;
+}
+
+bool virtuappu_rewind_restore(const VirtuaPPURewind *rewind, VirtuaPPUContext *ctx)
+{
+    if (rewind == NULL || ctx == NULL || !rewind->has_snapshot) {
+        return false;
+    }
+
+    *ctx->registers = rewind->registers;
+    if (ctx->vram != NULL) {
+        memcpy(ctx->vram, rewind->shadow, (size_t)rewind_footprint_pages(ctx, rewind->registers.mode) * VIRTUAPPU_REWIND_PAGE_BYTES);
+    }
+    if (rewind_bound_externally(ctx) && virtuappu_context_supports_mode(ctx, ctx->registers->mode)) {
+        rewind_scatter(rewind, ctx);
+    }
+    virtuappu_virtual_tiles_flush_ctx(ctx);
+    ctx->input_hash_valid = false;
+    return true;
+}
+
+bool virtuappu_rewind_step_back(VirtuaPPURewind *rewind, VirtuaPPUContext *ctx)
+{
+    uint32_t newest;
+
+    if (rewind == NULL || ctx == NULL || rewind->record_count == 0u) {
+        return false;
+    }
+
+    newest = (rewind->record_head + rewind->record_count - 1u) % rewind->max_records;
+    rewind_apply_record(rewind, rewind->records[newest]);
+    rewind->delta_bytes -= rewind->records[newest]->size;
+    free(rewind->records[newest]);
+    rewind->records[newest] = NULL;
+    --rewind->record_count;
+    rewind->last_changed_pages = 0u;
+    rewind->last_delta_bytes = 0u;
+
+    return virtuappu_rewind_restore(rewind, ctx);
+}
+
+uint32_t virtuappu_rewind_snapshot_count(const VirtuaPPURewind *rewind)
+{
+    if (rewind == NULL || !rewind->has_snapshot) {
+        return 0u;
+    }
+
+    return rewind->record_count + 1u;
+}
+
+void virtuappu_rewind_get_info(const VirtuaPPURewind *rewind, VirtuaPPURewindInfo *info)
+{
+    if (info == NULL) {
+        return;
+    }
+
+    memset(info, 0, sizeof(*info));
+    if (rewind == NULL) {
+        return;
+    }
+
+    info->snapshots = virtuappu_rewind_snapshot_count(rewind);
+    info->delta_bytes = rewind->delta_bytes;
+    info->budget_bytes = rewind->budget_bytes;
+    info->last_changed_pages = rewind->last_changed_pages;
+    info->last_delta_bytes = rewind->last_delta_bytes;
+}
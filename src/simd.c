@@ -0,0 +1,584 @@
+#include "simd.h"
+
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#define SIMD_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define SIMD_TARGET(features)
+#else
+#define SIMD_TARGET(features) __attribute__((target(features)))
+#endif
+#endif
+
+static uint32_t simd_alpha_channel(uint32_t top, uint32_t bottom, uint32_t shift, int eva, int evb)
+{
+    uint32_t value = ((((top >> shift) & 0xFFu) * (uint32_t)eva) + (((bottom >> shift) & 0xFFu) * (uint32_t)evb)) / 16u;
+
+    return ((value > 255u) ? 255u : value) << shift;
+}
+
+static void simd_fill32_scalar(uint32_t *dst, uint32_t value, size_t count)
+{
+    size_t x;
+
+    for (x = 0; x < count; ++x) {
+        dst[x] = value;
+    }
+}
+
+static void simd_decode_4bpp_scalar(uint8_t *dst, const uint8_t *src, size_t bytes)
+{
+    size_t i;
+
+    for (i = 0; i < bytes; ++i) {
+        dst[i * 2u] = src[i] & 0x0Fu;
+        dst[i * 2u + 1u] = src[i] >> 4u;
+    }
+}
+
+static void simd_lookup32_scalar(uint32_t *dst, const uint16_t *indices, const uint32_t *palette, size_t count)
+{
+    size_t x;
+
+    for (x = 0; x < count; ++x) {
+        dst[x] = palette[indices[x]];
+    }
+}
+
+static void simd_blend_alpha_scalar(uint32_t *dst, const uint32_t *bottom, const uint8_t *mask, int eva, int evb, size_t count)
+{
+    size_t x;
+
+    for (x = 0; x < count; ++x) {
+        if (mask[x] != 0u) {
+            dst[x] = 0xFF000000u | simd_alpha_channel(dst[x], bottom[x], 16u, eva, evb) |
+                     simd_alpha_channel(dst[x], bottom[x], 8u, eva, evb) | simd_alpha_channel(dst[x], bottom[x], 0u, eva, evb);
+        }
+    }
+}
+
+static void simd_brighten_scalar(uint32_t *dst, const uint8_t *mask, int evy, size_t count)
+{
+    size_t x;
+
+    for (x = 0; x < count; ++x) {
+        uint32_t out = 0xFF000000u;
+        uint32_t shift;
+
+        if (mask[x] == 0u) {
+            continue;
+        }
+        for (shift = 0u; shift < 24u; shift += 8u) {
+            uint32_t c = (dst[x] >> shift) & 0xFFu;
+            out |= (c + ((255u - c) * (uint32_t)evy) / 16u) << shift;
+        }
+        dst[x] = out;
+    }
+}
+
+static void simd_darken_scalar(uint32_t *dst, const uint8_t *mask, int evy, size_t count)
+{
+    size_t x;
+
+    for (x = 0; x < count; ++x) {
+        uint32_t out = 0xFF000000u;
+        uint32_t shift;
+
+        if (mask[x] == 0u) {
+            continue;
+        }
+        for (shift = 0u; shift < 24u; shift += 8u) {
+            uint32_t c = (dst[x] >> shift) & 0xFFu;
+            out |= (c - (c * (uint32_t)evy) / 16u) << shift;
+        }
+        dst[x] = out;
+    }
+}
+
+static const VirtuaPPUSimdKernels simd_scalar_kernels = {
+    VIRTUAPPU_SIMD_SCALAR,
+    simd_fill32_scalar,
+    simd_decode_4bpp_scalar,
+    simd_lookup32_scalar,
+    simd_blend_alpha_scalar,
+    simd_brighten_scalar,
+    simd_darken_scalar
+};
+
+#ifdef SIMD_X86
+
+/* All vector kernels work on 16-bit channel lanes: 255 * 16 * 2 still fits, and packus clamps to 255. */
+
+SIMD_TARGET("sse2") static void simd_fill32_sse2(uint32_t *dst, uint32_t value, size_t count)
+{
+    const __m128i v = _mm_set1_epi32((int)value);
+    size_t x = 0u;
+
+    for (; x + 4u <= count; x += 4u) {
+        _mm_storeu_si128((__m128i *)&dst[x], v);
+    }
+    simd_fill32_scalar(dst + x, value, count - x);
+}
+
+SIMD_TARGET("sse2") static void simd_decode_4bpp_sse2(uint8_t *dst, const uint8_t *src, size_t bytes)
+{
+    const __m128i low = _mm_set1_epi8(0x0F);
+    size_t i = 0u;
+
+    for (; i + 16u <= bytes; i += 16u) {
+        __m128i v = _mm_loadu_si128((const __m128i *)&src[i]);
+        __m128i lo = _mm_and_si128(v, low);
+        __m128i hi = _mm_and_si128(_mm_srli_epi16(v, 4), low);
+        _mm_storeu_si128((__m128i *)&dst[i * 2u], _mm_unpacklo_epi8(lo, hi));
+        _mm_storeu_si128((__m128i *)&dst[i * 2u + 16u], _mm_unpackhi_epi8(lo, hi));
+    }
+    simd_decode_4bpp_scalar(dst + i * 2u, src + i, bytes - i);
+}
+
+SIMD_TARGET("sse2") static __m128i simd_keep_mask_sse2(const uint8_t *mask)
+{
+    uint32_t bits;
+    __m128i m;
+
+    memcpy(&bits, mask, sizeof(bits));
+    m = _mm_cvtsi32_si128((int)bits);
+    m = _mm_unpacklo_epi8(m, m);
+    m = _mm_unpacklo_epi16(m, m);
+    return _mm_cmpeq_epi32(m, _mm_setzero_si128());
+}
+
+SIMD_TARGET("sse2") static void simd_blend_alpha_sse2(uint32_t *dst, const uint32_t *bottom, const uint8_t *mask, int eva, int evb, size_t count)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i va = _mm_set1_epi16((short)eva);
+    const __m128i vb = _mm_set1_epi16((short)evb);
+    const __m128i alpha = _mm_set1_epi32((int)0xFF000000u);
+    size_t x = 0u;
+
+    for (; x + 4u <= count; x += 4u) {
+        __m128i t = _mm_loadu_si128((const __m128i *)&dst[x]);
+        __m128i b = _mm_loadu_si128((const __m128i *)&bottom[x]);
+        __m128i keep = simd_keep_mask_sse2(&mask[x]);
+        __m128i lo = _mm_add_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(t, zero), va), _mm_mullo_epi16(_mm_unpacklo_epi8(b, zero), vb));
+        __m128i hi = _mm_add_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(t, zero), va), _mm_mullo_epi16(_mm_unpackhi_epi8(b, zero), vb));
+        __m128i out = _mm_or_si128(_mm_packus_epi16(_mm_srli_epi16(lo, 4), _mm_srli_epi16(hi, 4)), alpha);
+
+        _mm_storeu_si128((__m128i *)&dst[x], _mm_or_si128(_mm_and_si128(keep, t), _mm_andnot_si128(keep, out)));
+    }
+    simd_blend_alpha_scalar(dst + x, bottom + x, mask + x, eva, evb, count - x);
+}
+
+SIMD_TARGET("sse2") static __m128i simd_fade_sse2(__m128i c, __m128i vy, bool brighten)
+{
+    if (brighten) {
+        return _mm_add_epi16(c, _mm_srli_epi16(_mm_mullo_epi16(_mm_sub_epi16(_mm_set1_epi16(255), c), vy), 4));
+    }
+
+    return _mm_sub_epi16(c, _mm_srli_epi16(_mm_mullo_epi16(c, vy), 4));
+}
+
+SIMD_TARGET("sse2") static void simd_fade_lines_sse2(uint32_t *dst, const uint8_t *mask, int evy, bool brighten, size_t count)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i vy = _mm_set1_epi16((short)evy);
+    const __m128i alpha = _mm_set1_epi32((int)0xFF000000u);
+    size_t x = 0u;
+
+    for (; x + 4u <= count; x += 4u) {
+        __m128i t = _mm_loadu_si128((const __m128i *)&dst[x]);
+        __m128i keep = simd_keep_mask_sse2(&mask[x]);
+        __m128i lo = simd_fade_sse2(_mm_unpacklo_epi8(t, zero), vy, brighten);
+        __m128i hi = simd_fade_sse2(_mm_unpackhi_epi8(t, zero), vy, brighten);
+        __m128i out = _mm_or_si128(_mm_packus_epi16(lo, hi), alpha);
+
+        _mm_storeu_si128((__m128i *)&dst[x], _mm_or_si128(_mm_and_si128(keep, t), _mm_andnot_si128(keep, out)));
+    }
+    if (brighten) {
+        simd_brighten_scalar(dst + x, mask + x, evy, count - x);
+    } else {
+        simd_darken_scalar(dst + x, mask + x, evy, count - x);
+    }
+}
+
+static void simd_brighten_sse2(uint32_t *dst, const uint8_t *mask, int evy, size_t count)
+{
+    simd_fade_lines_sse2(dst, mask, evy, true, count);
+}
+
+static void simd_darken_sse2(uint32_t *dst, const uint8_t *mask, int evy, size_t count)
+{
+    simd_fade_lines_sse2(dst, mask, evy, false, count);
+}
+
+SIMD_TARGET("avx2") static void simd_fill32_avx2(uint32_t *dst, uint32_t value, size_t count)
+{
+    const __m256i v = _mm256_set1_epi32((int)value);
+    size_t x = 0u;
+
+    for (; x + 8u <= count; x += 8u) {
+        _mm256_storeu_si256((__m256i *)&dst[x], v);
+    }
+    simd_fill32_scalar(dst + x, value, count - x);
+}
+
+SIMD_TARGET("avx2") static void simd_decode_4bpp_avx2(uint8_t *dst, const uint8_t *src, size_t bytes)
+{
+    const __m256i low = _mm256_set1_epi8(0x0F);
+    size_t i = 0u;
+
+    for (; i + 32u <= bytes; i += 32u) {
+        __m256i v = _mm256_loadu_si256((const __m256i *)&src[i]);
+        __m256i lo = _mm256_and_si256(v, low);
+        __m256i hi = _mm256_and_si256(_mm256_srli_epi16(v, 4), low);
+        __m256i first = _mm256_unpacklo_epi8(lo, hi);
+        __m256i second = _mm256_unpackhi_epi8(lo, hi);
+
+        /* unpack works per 128-bit lane; recombine so the output stays in source order. */
+        _mm256_storeu_si256((__m256i *)&dst[i * 2u], _mm256_permute2x128_si256(first, second, 0x20));
+        _mm256_storeu_si256((__m256i *)&dst[i * 2u + 32u], _mm256_permute2x128_si256(first, second, 0x31));
+    }
+    simd_decode_4bpp_sse2(dst + i * 2u, src + i, bytes - i);
+}
+
+SIMD_TARGET("avx2") static void simd_lookup32_avx2(uint32_t *dst, const uint16_t *indices, const uint32_t *palette, size_t count)
+{
+    size_t x = 0u;
+
+    for (; x + 8u <= count; x += 8u) {
+        __m256i idx = _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i *)&indices[x]));
+        _mm256_storeu_si256((__m256i *)&dst[x], _mm256_i32gather_epi32((const int *)palette, idx, 4));
+    }
+    simd_lookup32_scalar(dst + x, indices + x, palette, count - x);
+}
+
+SIMD_TARGET("avx2") static __m256i simd_keep_mask_avx2(const uint8_t *mask)
+{
+    __m256i m = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *)mask));
+
+    return _mm256_cmpeq_epi32(m, _mm256_setzero_si256());
+}
+
+SIMD_TARGET("avx2") static void simd_blend_alpha_avx2(uint32_t *dst, const uint32_t *bottom, const uint8_t *mask, int eva, int evb, size_t count)
+{
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i va = _mm256_set1_epi16((short)eva);
+    const __m256i vb = _mm256_set1_epi16((short)evb);
+    const __m256i alpha = _mm256_set1_epi32((int)0xFF000000u);
+    size_t x = 0u;
+
+    for (; x + 8u <= count; x += 8u) {
+        __m256i t = _mm256_loadu_si256((const __m256i *)&dst[x]);
+        __m256i b = _mm256_loadu_si256((const __m256i *)&bottom[x]);
+        __m256i lo = _mm256_add_epi16(_mm256_mullo_epi16(_mm256_unpacklo_epi8(t, zero), va),
+                                      _mm256_mullo_epi16(_mm256_unpacklo_epi8(b, zero), vb));
+        __m256i hi = _mm256_add_epi16(_mm256_mullo_epi16(_mm256_unpackhi_epi8(t, zero), va),
+                                      _mm256_mullo_epi16(_mm256_unpackhi_epi8(b, zero), vb));
+        __m256i out = _mm256_or_si256(_mm256_packus_epi16(_mm256_srli_epi16(lo, 4), _mm256_srli_epi16(hi, 4)), alpha);
+
+        _mm256_storeu_si256((__m256i *)&dst[x], _mm256_blendv_epi8(out, t, simd_keep_mask_avx2(&mask[x])));
+    }
+    simd_blend_alpha_sse2(dst + x, bottom + x, mask + x, eva, evb, count - x);
+}
+
+SIMD_TARGET("avx2") static __m256i simd_fade_avx2(__m256i c, __m256i vy, bool brighten)
+{
+    if (brighten) {
+        return _mm256_add_epi16(c, _mm256_srli_epi16(_mm256_mullo_epi16(_mm256_sub_epi16(_mm256_set1_epi16(255), c), vy), 4));
+    }
+
+    return _mm256_sub_epi16(c, _mm256_srli_epi16(_mm256_mullo_epi16(c, vy), 4));
+}
+
+SIMD_TARGET("avx2") static void simd_fade_lines_avx2(uint32_t *dst, const uint8_t *mask, int evy, bool brighten, size_t count)
+{
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i vy = _mm256_set1_epi16((short)evy);
+    const __m256i alpha = _mm256_set1_epi32((int)0xFF000000u);
+    size_t x = 0u;
+
+    for (; x + 8u <= count; x += 8u) {
+        __m256i t = _mm256_loadu_si256((const __m256i *)&dst[x]);
+        __m256i lo = simd_fade_avx2(_mm256_unpacklo_epi8(t, zero), vy, brighten);
+        __m256i hi = simd_fade_avx2(_mm256_unpackhi_epi8(t, zero), vy, brighten);
+        __m256i out = _mm256_or_si256(_mm256_packus_epi16(lo, hi), alpha);
+
+        _mm256_storeu_si256((__m256i *)&dst[x], _mm256_blendv_epi8(out, t, simd_keep_mask_avx2(&mask[x])));
+    }
+    simd_fade_lines_sse2(dst + x, mask + x, evy, brighten, count - x);
+}
+
+static void simd_brighten_avx2(uint32_t *dst, const uint8_t *mask, int evy, size_t count)
+{
+    simd_fade_lines_avx2(dst, mask, evy, true, count);
+}
+
+static void simd_darken_avx2(uint32_t *dst, const uint8_t *mask, int evy, size_t count)
+{
+    simd_fade_lines_avx2(dst, mask, evy, false, count);
+}
+
+SIMD_TARGET("avx512f,avx512bw") static void simd_fill32_avx512(uint32_t *dst, uint32_t value, size_t count)
+{
+    const __m512i v = _mm512_set1_epi32((int)value);
+    size_t x = 0u;
+
+    for (; x + 16u <= count; x += 16u) {
+        _mm512_storeu_si512((void *)&dst[x], v);
+    }
+    simd_fill32_avx2(dst + x, value, count - x);
+}
+
+SIMD_TARGET("avx512f,avx512bw") static void simd_lookup32_avx512(uint32_t *dst, const uint16_t *indices, const uint32_t *palette, size_t count)
+{
+    size_t x = 0u;
+
+    for (; x + 16u <= count; x += 16u) {
+        __m512i idx = _mm512_cvtepu16_epi32(_mm256_loadu_si256((const __m256i *)&indices[x]));
+        _mm512_storeu_si512((void *)&dst[x], _mm512_i32gather_epi32(idx, (const void *)palette, 4));
+    }
+    simd_lookup32_avx2(dst + x, indices + x, palette, count - x);
+}
+
+SIMD_TARGET("avx512f,avx512bw") static __mmask16 simd_apply_mask_avx512(const uint8_t *mask)
+{
+    __m512i m = _mm512_cvtepu8_epi32(_mm_loadu_si128((const __m128i *)mask));
+
+    return _mm512_test_epi32_mask(m, m);
+}
+
+SIMD_TARGET("avx512f,avx512bw") static void simd_blend_alpha_avx512(uint32_t *dst, const uint32_t *bottom, const uint8_t *mask, int eva, int evb, size_t count)
+{
+    const __m512i zero = _mm512_setzero_si512();
+    const __m512i va = _mm512_set1_epi16((short)eva);
+    const __m512i vb = _mm512_set1_epi16((short)evb);
+    const __m512i alpha = _mm512_set1_epi32((int)0xFF000000u);
+    size_t x = 0u;
+
+    for (; x + 16u <= count; x += 16u) {
+        __mmask16 apply = simd_apply_mask_avx512(&mask[x]);
+        __m512i t;
+        __m512i b;
+        __m512i lo;
+        __m512i hi;
+        __m512i out;
+
+        if (apply == 0u) {
+            continue;
+        }
+        t = _mm512_loadu_si512((const void *)&dst[x]);
+        b = _mm512_loadu_si512((const void *)&bottom[x]);
+        lo = _mm512_add_epi16(_mm512_mullo_epi16(_mm512_unpacklo_epi8(t, zero), va), _mm512_mullo_epi16(_mm512_unpacklo_epi8(b, zero), vb));
+        hi = _mm512_add_epi16(_mm512_mullo_epi16(_mm512_unpackhi_epi8(t, zero), va), _mm512_mullo_epi16(_mm512_unpackhi_epi8(b, zero), vb));
+        out = _mm512_or_si512(_mm512_packus_epi16(_mm512_srli_epi16(lo, 4), _mm512_srli_epi16(hi, 4)), alpha);
+        _mm512_storeu_si512((void *)&dst[x], _mm512_mask_mov_epi32(t, apply, out));
+    }
+    simd_blend_alpha_avx2(dst + x, bottom + x, mask + x, eva, evb, count - x);
+}
+
+SIMD_TARGET("avx512f,avx512bw") static __m512i simd_fade_avx512(__m512i c, __m512i vy, bool brighten)
+{
+    if (brighten) {
+        return _mm512_add_epi16(c, _mm512_srli_epi16(_mm512_mullo_epi16(_mm512_sub_epi16(_mm512_set1_epi16(255), c), vy), 4));
+    }
+
+    return _mm512_sub_epi16(c, _mm512_srli_epi16(_mm512_mullo_epi16(c, vy), 4));
+}
+
+SIMD_TARGET("avx512f,avx512bw") static void simd_fade_lines_avx512(uint32_t *dst, const uint8_t *mask, int evy, bool brighten, size_t count)
+{
+    const __m512i zero = _mm512_setzero_si512();
+    const __m512i vy = _mm512_set1_epi16((short)evy);
+    const __m512i alpha = _mm512_set1_epi32((int)0xFF000000u);
+    size_t x = 0u;
+
+    for (; x + 16u <= count; x += 16u) {
+        __mmask16 apply = simd_apply_mask_avx512(&mask[x]);
+        __m512i t;
+        __m512i out;
+
+        if (apply == 0u) {
+            continue;
+        }
+        t = _mm512_loadu_si512((const void *)&dst[x]);
+        out = _mm512_packus_epi16(simd_fade_avx512(_mm512_unpacklo_epi8(t, zero), vy, brighten),
+                                  simd_fade_avx512(_mm512_unpackhi_epi8(t, zero), vy, brighten));
+        _mm512_storeu_si512((void *)&dst[x], _mm512_mask_mov_epi32(t, apply, _mm512_or_si512(out, alpha)));
+    }
+    simd_fade_lines_avx2(dst + x, mask + x, evy, brighten, count - x);
+}
+
+static void simd_brighten_avx512(uint32_t *dst, const uint8_t *mask, int evy, size_t count)
+{
+    simd_fade_lines_avx512(dst, mask, evy, true, count);
+}
+
+static void simd_darken_avx512(uint32_t *dst, const uint8_t *mask, int evy, size_t count)
+{
+    simd_fade_lines_avx512(dst, mask, evy, false, count);
+}
+
+static const VirtuaPPUSimdKernels simd_sse2_kernels = {
+    VIRTUAPPU_SIMD_SSE2,
+    simd_fill32_sse2,
+    simd_decode_4bpp_sse2,
+    simd_lookup32_scalar,
+    simd_blend_alpha_sse2,
+    simd_brighten_sse2,
+    simd_darken_sse2
+};
+
+static const VirtuaPPUSimdKernels simd_avx2_kernels = {
+    VIRTUAPPU_SIMD_AVX2,
+    simd_fill32_avx2,
+    simd_decode_4bpp_avx2,
+    simd_lookup32_avx2,
+    simd_blend_alpha_avx2,
+    simd_brighten_avx2,
+    simd_darken_avx2
+};
+
+static const VirtuaPPUSimdKernels simd_avx512_kernels = {
+    VIRTUAPPU_SIMD_AVX512,
+    simd_fill32_avx512,
+    simd_decode_4bpp_avx2,
+    simd_lookup32_avx512,
+    simd_blend_alpha_avx512,
+    simd_brighten_avx512,
+    simd_darken_avx512
+};
+
+#endif
+
+static _Atomic(const VirtuaPPUSimdKernels *) simd_current = &simd_scalar_kernels;
+static atomic_bool simd_selected;
+
+VirtuaPPUSimdLevel virtuappu_simd_detect(void)
+{
+#if defined(SIMD_X86) && defined(_MSC_VER)
+    int info[4];
+    int max_leaf;
+    bool os_avx;
+    bool os_avx512;
+
+    __cpuid(info, 0);
+    max_leaf = info[0];
+    __cpuid(info, 1);
+    if ((info[3] & (1 << 26)) == 0) {
+        return VIRTUAPPU_SIMD_SCALAR;
+    }
+    if ((info[2] & (1 << 27)) == 0 || max_leaf < 7) {
+        return VIRTUAPPU_SIMD_SSE2;
+    }
+
+    os_avx = (_xgetbv(0) & 0x06u) == 0x06u;
+    os_avx512 = (_xgetbv(0) & 0xE6u) == 0xE6u;
+    __cpuidex(info, 7, 0);
+    if (os_avx512 && (info[1] & (1 << 16)) != 0 && (info[1] & (1 << 30)) != 0) {
+        return VIRTUAPPU_SIMD_AVX512;
+    }
+    if (os_avx && (info[1] & (1 << 5)) != 0) {
+        return VIRTUAPPU_SIMD_AVX2;
+    }
+    return VIRTUAPPU_SIMD_SSE2;
+#elif defined(SIMD_X86)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw")) {
+        return VIRTUAPPU_SIMD_AVX512;
+    }
+    if (__builtin_cpu_supports("avx2")) {
+        return VIRTUAPPU_SIMD_AVX2;
+    }
+    if (__builtin_cpu_supports("sse2")) {
+        return VIRTUAPPU_SIMD_SSE2;
+    }
+    return VIRTUAPPU_SIMD_SCALAR;
+#else
+    return VIRTUAPPU_SIMD_SCALAR;
+#endif
+}
+
+VirtuaPPUSimdLevel virtuappu_simd_set_level(VirtuaPPUSimdLevel level)
+{
+    const VirtuaPPUSimdKernels *kernels = &simd_scalar_kernels;
+    VirtuaPPUSimdLevel supported = virtuappu_simd_detect();
+
+    if (level > supported) {
+        level = supported;
+    }
+
+#ifdef SIMD_X86
+    switch (level) {
+    case VIRTUAPPU_SIMD_AVX512:
+        kernels = &simd_avx512_kernels;
+        break;
+    case VIRTUAPPU_SIMD_AVX2:
+        kernels = &simd_avx2_kernels;
+        break;
+    case VIRTUAPPU_SIMD_SSE2:
+        kernels = &simd_sse2_kernels;
+        break;
+    default:
+        break;
+    }
+#endif
+
+    atomic_store_explicit(&simd_current, kernels, memory_order_release);
+    atomic_store_explicit(&simd_selected, true, memory_order_release);
+    return kernels->level;
+}
+
+/* The first call picks the best supported level; VIRTUAPPU_SIMD=scalar|sse2|avx2|avx512 caps it for testing. */
+VirtuaPPUSimdLevel virtuappu_simd_select(void)
+{
+    VirtuaPPUSimdLevel level = VIRTUAPPU_SIMD_AVX512;
+    const char *override;
+
+    if (atomic_load_explicit(&simd_selected, memory_order_acquire)) {
+        return virtuappu_simd_level();
+    }
+
+    override = getenv("VIRTUAPPU_SIMD");
+    if (override != NULL) {
+        VirtuaPPUSimdLevel candidate;
+
+        for (candidate = VIRTUAPPU_SIMD_SCALAR; candidate <= VIRTUAPPU_SIMD_AVX512; ++candidate) {
+            if (strcmp(override, virtuappu_simd_level_name(candidate)) == 0) {
+                level = candidate;
+                break;
+            }
+        }
+    }
+
+    return virtuappu_simd_set_level(level);
+}
+
+VirtuaPPUSimdLevel virtuappu_simd_level(void)
+{
+    return virtuappu_simd_kernels()->level;
+}
+
+const char *virtuappu_simd_level_name(VirtuaPPUSimdLevel level)
+{
+    switch (level) {
+    case VIRTUAPPU_SIMD_SCALAR:
+        return "scalar";
+    case VIRTUAPPU_SIMD_SSE2:
+        return "sse2";
+    case VIRTUAPPU_SIMD_AVX2:
+        return "avx2";
+    case VIRTUAPPU_SIMD_AVX512:
+        return "avx512";
+    default:
+        return "unknown";
+    }
+}
+
+const VirtuaPPUSimdKernels *virtuappu_simd_kernels(void)
+{
+    return atomic_load_explicit(&simd_current, memory_order_acquire);
+}
@@ -0,0 +1,94 @@
+#include "stats.h"
+
+#include <string.h>
+
+#include "virtuappu.h"
+
+_Static_assert((int)VIRTUAPPU_STATS_MAX_LINES == (int)VIRTUAPPU_MAX_FRAME_HEIGHT, "Stats must cover every frame line");
+
+#ifdef VIRTUAPPU_ENABLE_STATS
+
+static uint32_t stats_histogram_bucket(uint64_t cycles)
+{
+    uint32_t bucket = 0u;
+
+    while (cycles > 1u && bucket + 1u < VIRTUAPPU_STATS_HISTOGRAM_BUCKETS) {
+        cycles >>= 1u;
+        ++bucket;
+    }
+
+    return bucket;
+}
+
+void virtuappu_stats_begin_frame(VirtuaPPUContext *ctx, uint32_t line_count)
+{
+    VirtuaPPUStatsState *state = ctx->stats;
+
+    if (line_count > VIRTUAPPU_STATS_MAX_LINES) {
+        line_count = VIRTUAPPU_STATS_MAX_LINES;
+    }
+
+    memset(state->lines, 0, sizeof(state->lines[0]) * VIRTUAPPU_STATS_MAX_LINES);
+    state->line_count = line_count;
+    state->frame_cycles = 0u;
+    state->frame_begin = virtuappu_stats_now();
+}
+
+void virtuappu_stats_end_frame(VirtuaPPUContext *ctx)
+{
+    ctx->stats->frame_cycles = virtuappu_stats_now() - ctx->stats->frame_begin;
+}
+
+#endif
+
+bool virtuappu_get_stats_ctx(const VirtuaPPUContext *ctx, VirtuaPPUStats *stats)
+{
+#ifdef VIRTUAPPU_ENABLE_STATS
+    const VirtuaPPUStatsState *state;
+    uint32_t line;
+    uint32_t stage;
+#endif
+
+    if (stats == NULL) {
+        return false;
+    }
+
+    memset(stats, 0, sizeof(*stats));
+
+#ifdef VIRTUAPPU_ENABLE_STATS
+    if (ctx == NULL) {
+        return false;
+    }
+
+    state = ctx->stats;
+    stats->frame_cycles = state->frame_cycles;
+    stats->line_count = state->line_count;
+
+    for (line = 0; line < state->line_count; ++line) {
+        const VirtuaPPULineStats *line_stats = &state->lines[line];
+        uint64_t cycles = 0u;
+
+        for (stage = 0; stage < VIRTUAPPU_STATS_STAGE_COUNT; ++stage) {
+            stats->stage_cycles[stage] += line_stats->stage_cycles[stage];
+            cycles += line_stats->stage_cycles[stage];
+        }
+
+        stats->tiles_fetched += line_stats->tiles_fetched;
+        stats->opaque_blocks_skipped += line_stats->opaque_blocks_skipped;
+        stats->sprites_drawn += line_stats->sprites_drawn;
+        stats->pixels_blended += line_stats->pixels_blended;
+        stats->line_cycles[line] = cycles;
+        ++stats->line_histogram[stats_histogram_bucket(cycles)];
+    }
+
+    return true;
+#else
+    (void)ctx;
+    return false;
+#endif
+}
+
+bool virtuappu_get_stats(VirtuaPPUStats *stats)
+{
+    return virtuappu_get_stats_ctx(virtuappu_get_default_context(), stats);
+}
@@ -0,0 +1,390 @@
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE
+#endif
+
+#include "thread_pool.h"
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <sched.h>
+#include <unistd.h>
+#endif
+
+typedef struct ThreadPoolSlice {
+    _Alignas(64) atomic_size_t next;
+    size_t end;
+} ThreadPoolSlice;
+
+typedef struct ThreadPoolJob {
+    VirtuaPPUTaskFn task;
+    void *user;
+    size_t count;
+    size_t grain;
+} ThreadPoolJob;
+
+typedef struct ThreadPoolWorker {
+    pthread_t thread;
+    uint64_t generation;
+    uint32_t index;
+    int32_t cpu;
+} ThreadPoolWorker;
+
+typedef struct ThreadPool {
+    pthread_mutex_t lock;
+    pthread_cond_t start;
+    pthread_cond_t done;
+    pthread_mutex_t submit;
+    ThreadPoolWorker *workers;
+    ThreadPoolSlice *slices;
+    void *slice_storage;
+    const ThreadPoolJob *job;
+    uint32_t worker_count;
+    uint32_t busy_workers;
+    uint64_t generation;
+    bool stopping;
+    atomic_bool started;
+} ThreadPool;
+
+static ThreadPool thread_pool = {
+    PTHREAD_MUTEX_INITIALIZER,
+    PTHREAD_COND_INITIALIZER,
+    PTHREAD_COND_INITIALIZER,
+    PTHREAD_MUTEX_INITIALIZER,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    0u,
+    0u,
+    0u,
+    false,
+    false
+};
+
+static pthread_mutex_t thread_pool_config_lock = PTHREAD_MUTEX_INITIALIZER;
+static VirtuaPPUTaskHooks thread_pool_hooks;
+
+static uint32_t thread_pool_hardware_threads(void)
+{
+#if defined(_WIN32)
+    SYSTEM_INFO info;
+
+    GetSystemInfo(&info);
+    return (info.dwNumberOfProcessors > 0u) ? (uint32_t)info.dwNumberOfProcessors : 1u;
+#else
+    long count = sysconf(_SC_NPROCESSORS_ONLN);
+
+    return (count > 0) ? (uint32_t)count : 1u;
+#endif
+}
+
+static void thread_pool_pin(int32_t cpu)
+{
+#if defined(__linux__)
+    cpu_set_t set;
+
+    if (cpu < 0 || cpu >= CPU_SETSIZE) {
+        return;
+    }
+
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+#elif defined(_WIN32)
+    if (cpu < 0 || cpu >= (int32_t)(sizeof(DWORD_PTR) * 8u)) {
+        return;
+    }
+
+    SetThreadAffinityMask(GetCurrentThread(), (DWORD_PTR)1u << cpu);
+#else
+    (void)cpu;
+#endif
+}
+
+static void thread_pool_run_chunk(const ThreadPoolJob *job, size_t chunk)
+{
+    size_t begin = chunk * job->grain;
+    size_t end = (begin + job->grain < job->count) ? begin + job->grain : job->count;
+
+    job->task(job->user, begin, end);
+}
+
+static void thread_pool_run(ThreadPool *pool, const ThreadPoolJob *job, uint32_t self)
+{
+    uint32_t participants = pool->worker_count + 1u;
+    uint32_t offset;
+
+    for (offset = 0; offset < participants; ++offset) {
+        ThreadPoolSlice *slice = &pool->slices[(self + offset) % participants];
+
+        for (;;) {
+            size_t chunk = atomic_fetch_add_explicit(&slice->next, 1u, memory_order_relaxed);
+
+            if (chunk >= slice->end) {
+                break;
+            }
+
+            thread_pool_run_chunk(job, chunk);
+        }
+    }
+}
+
+static void *thread_pool_worker_main(void *arg)
+{
+    ThreadPoolWorker *worker = (ThreadPoolWorker *)arg;
+    ThreadPool *pool = &thread_pool;
+    uint64_t seen = worker->generation;
+
+    thread_pool_pin(worker->cpu);
+
+    pthread_mutex_lock(&pool->lock);
+    for (;;) {
+        const ThreadPoolJob *job;
+
+        while (pool->generation == seen && !pool->stopping) {
+            pthread_cond_wait(&pool->start, &pool->lock);
+        }
+        if (pool->stopping) {
+            break;
+        }
+
+        seen = pool->generation;
+        job = pool->job;
+        pthread_mutex_unlock(&pool->lock);
+
+        thread_pool_run(pool, job, worker->index);
+
+        pthread_mutex_lock(&pool->lock);
+        if (--pool->busy_workers == 0u) {
+            pthread_cond_signal(&pool->done);
+        }
+    }
+    pthread_mutex_unlock(&pool->lock);
+
+    return NULL;
+}
+
+static void thread_pool_stop(ThreadPool *pool)
+{
+    uint32_t i;
+
+    if (!pool->started) {
+        return;
+    }
+
+    pthread_mutex_lock(&pool->lock);
+    pool->stopping = true;
+    pthread_cond_broadcast(&pool->start);
+    pthread_mutex_unlock(&pool->lock);
+
+    for (i = 0; i < pool->worker_count; ++i) {
+        pthread_join(pool->workers[i].thread, NULL);
+    }
+
+    free(pool->workers);
+    free(pool->slice_storage);
+    pool->workers = NULL;
+    pool->slices = NULL;
+    pool->slice_storage = NULL;
+    pool->worker_count = 0u;
+    pool->stopping = false;
+    pool->started = false;
+}
+
+static bool thread_pool_start(ThreadPool *pool, const VirtuaPPUThreadConfig *config)
+{
+    uint32_t thread_count = (config != NULL) ? config->thread_count : 0u;
+    uint32_t i;
+
+    if (thread_count == 0u) {
+        thread_count = thread_pool_hardware_threads();
+    }
+    if (thread_count > VIRTUAPPU_THREAD_POOL_MAX_THREADS) {
+        thread_count = VIRTUAPPU_THREAD_POOL_MAX_THREADS;
+    }
+
+    /* aligned_alloc is missing from the MinGW CRT, so slices are over-allocated and aligned by hand. */
+    pool->slice_storage = calloc(1u, sizeof(ThreadPoolSlice) * thread_count + _Alignof(ThreadPoolSlice) - 1u);
+    pool->workers = (thread_count > 1u) ? (ThreadPoolWorker *)calloc(thread_count - 1u, sizeof(ThreadPoolWorker)) : NULL;
+    if (pool->slice_storage == NULL || (thread_count > 1u && pool->workers == NULL)) {
+        free(pool->slice_storage);
+        free(pool->workers);
+        pool->slice_storage = NULL;
+        pool->workers = NULL;
+        return false;
+    }
+    pool->slices = (ThreadPoolSlice *)(((uintptr_t)pool->slice_storage + _Alignof(ThreadPoolSlice) - 1u) &
+                                       ~(uintptr_t)(_Alignof(ThreadPoolSlice) - 1u));
+
+    for (i = 0; i < thread_count; ++i) {
+        atomic_init(&pool->slices[i].next, 0u);
+        pool->slices[i].end = 0u;
+    }
+
+    pool->worker_count = 0u;
+    pool->started = true;
+    for (i = 0; i + 1u < thread_count; ++i) {
+        ThreadPoolWorker *worker = &pool->workers[i];
+
+        worker->generation = pool->generation;
+        worker->index = i + 1u;
+        worker->cpu = (config != NULL && config->cpu_affinity != NULL) ? config->cpu_affinity[i] : -1;
+        if (pthread_create(&worker->thread, NULL, thread_pool_worker_main, worker) != 0) {
+            break;
+        }
+        ++pool->worker_count;
+    }
+
+    return true;
+}
+
+bool virtuappu_thread_pool_configure(const VirtuaPPUThreadConfig *config)
+{
+    bool ok;
+
+    pthread_mutex_lock(&thread_pool_config_lock);
+    pthread_mutex_lock(&thread_pool.submit);
+    thread_pool_stop(&thread_pool);
+    ok = thread_pool_start(&thread_pool, config);
+    pthread_mutex_unlock(&thread_pool.submit);
+    pthread_mutex_unlock(&thread_pool_config_lock);
+
+    return ok;
+}
+
+void virtuappu_thread_pool_shutdown(void)
+{
+    pthread_mutex_lock(&thread_pool_config_lock);
+    pthread_mutex_lock(&thread_pool.submit);
+    thread_pool_stop(&thread_pool);
+    pthread_mutex_unlock(&thread_pool.submit);
+    pthread_mutex_unlock(&thread_pool_config_lock);
+}
+
+uint32_t virtuappu_thread_pool_size(void)
+{
+    return thread_pool.started ? thread_pool.worker_count + 1u : 0u;
+}
+
+void virtuappu_set_task_hooks(const VirtuaPPUTaskHooks *hooks)
+{
+    if (hooks == NULL) {
+        memset(&thread_pool_hooks, 0, sizeof(thread_pool_hooks));
+        return;
+    }
+
+    thread_pool_hooks = *hooks;
+}
+
+static void thread_pool_run_serial(size_t count, size_t grain, VirtuaPPUTaskFn task, void *user)
+{
+    size_t begin;
+
+    for (begin = 0; begin < count; begin += grain) {
+        task(user, begin, (begin + grain < count) ? begin + grain : count);
+    }
+}
+
+#ifdef USE_OPENMP
+static void thread_pool_run_openmp(size_t count, size_t grain, VirtuaPPUTaskFn task, void *user)
+{
+    long chunk_count = (long)((count + grain - 1u) / grain);
+    long chunk;
+
+#pragma omp parallel for schedule(dynamic, 1)
+    for (chunk = 0; chunk < chunk_count; ++chunk) {
+        size_t begin = (size_t)chunk * grain;
+        task(user, begin, (begin + grain < count) ? begin + grain : count);
+    }
+}
+#endif
+
+void virtuappu_parallel_for(size_t count, size_t grain, VirtuaPPUTaskFn task, void *user)
+{
+    ThreadPool *pool = &thread_pool;
+    ThreadPoolJob job;
+    size_t chunk_count;
+    uint32_t participants;
+    uint32_t i;
+
+    if (task == NULL || count == 0u) {
+        return;
+    }
+    if (grain == 0u) {
+        grain = 1u;
+    }
+
+    if (thread_pool_hooks.parallel_for != NULL) {
+        thread_pool_hooks.parallel_for(thread_pool_hooks.hook_user, count, grain, task, user);
+        return;
+    }
+
+    chunk_count = (count + grain - 1u) / grain;
+    if (chunk_count < 2u) {
+        thread_pool_run_serial(count, grain, task, user);
+        return;
+    }
+
+#ifdef USE_OPENMP
+    if (!pool->started) {
+        thread_pool_run_openmp(count, grain, task, user);
+        return;
+    }
+#endif
+
+    if (!pool->started) {
+        pthread_mutex_lock(&thread_pool_config_lock);
+        if (!pool->started) {
+            pthread_mutex_lock(&pool->submit);
+            thread_pool_start(pool, NULL);
+            pthread_mutex_unlock(&pool->submit);
+        }
+        pthread_mutex_unlock(&thread_pool_config_lock);
+    }
+
+    /* Nested or concurrent submissions run inline rather than queueing behind the active job. */
+    if (pthread_mutex_trylock(&pool->submit) != 0) {
+        thread_pool_run_serial(count, grain, task, user);
+        return;
+    }
+    if (pool->worker_count == 0u) {
+        pthread_mutex_unlock(&pool->submit);
+        thread_pool_run_serial(count, grain, task, user);
+        return;
+    }
+
+    job.task = task;
+    job.user = user;
+    job.count = count;
+    job.grain = grain;
+
+    participants = pool->worker_count + 1u;
+    for (i = 0; i < participants; ++i) {
+        atomic_store_explicit(&pool->slices[i].next, (chunk_count * i) / participants, memory_order_relaxed);
+        pool->slices[i].end = (chunk_count * (i + 1u)) / participants;
+    }
+
+    pthread_mutex_lock(&pool->lock);
+    pool->job = &job;
+    pool->busy_workers = pool->worker_count;
+    ++pool->generation;
+    pthread_cond_broadcast(&pool->start);
+    pthread_mutex_unlock(&pool->lock);
+
+    thread_pool_run(pool, &job, 0u);
+
+    pthread_mutex_lock(&pool->lock);
+    while (pool->busy_workers != 0u) {
+        pthread_cond_wait(&pool->done, &pool->lock);
+    }
+    pool->job = NULL;
+    pthread_mutex_unlock(&pool->lock);
+
+    pthread_mutex_unlock(&pool->submit);
+}
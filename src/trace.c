@@ -0,0 +1,480 @@
+#include "trace.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "virtuappu.h"
+
+enum {
+    TRACE_HEADER_BYTES = 16u,
+    TRACE_FRAME_HEADER_BYTES = 8u,
+    TRACE_RUN_HEADER_BYTES = 8u
+};
+
+typedef struct TraceRegion {
+    size_t offset;
+    const uint8_t *data;
+    size_t size;
+} TraceRegion;
+
+struct VirtuaPPUTraceRecorder {
+    FILE *file;
+    uint8_t *shadow;
+    uint8_t *record;
+    size_t record_size;
+    size_t record_capacity;
+    uint32_t run_count;
+    uint64_t frame_count;
+    bool failed;
+};
+
+struct VirtuaPPUTraceReader {
+    uint8_t *data;
+    size_t size;
+    size_t cursor;
+    uint64_t frame_count;
+};
+
+typedef struct TraceOfflineSource {
+    VirtuaPPUTraceReader *reader;
+    VirtuaPPUContext *cursor;
+    VirtuaPPUOfflineSinkFn sink;
+    void *user;
+} TraceOfflineSource;
+
+static const uint8_t trace_magic[8] = {'V', 'P', 'P', 'U', 'T', 'R', 'C', 'E'};
+
+static void trace_put_u32(uint8_t *dst, uint32_t value)
+{
+    dst[0] = (uint8_t)value;
+    dst[1] = (uint8_t)(value >> 8u);
+    dst[2] = (uint8_t)(value >> 16u);
+    dst[3] = (uint8_t)(value >> 24u);
+}
+
+static uint32_t trace_get_u32(const uint8_t *src)
+{
+    return (uint32_t)src[0] | ((uint32_t)src[1] << 8u) | ((uint32_t)src[2] << 16u) | ((uint32_t)src[3] << 24u);
+}
+
+static bool trace_reserve(VirtuaPPUTraceRecorder *recorder, size_t extra)
+{
+    size_t capacity = recorder->record_capacity;
+    uint8_t *record;
+
+    if (recorder->record_size + extra <= capacity) {
+        return true;
+    }
+
+    while (capacity < recorder->record_size + extra) {
+        capacity = (capacity == 0u) ? 64u * 1024u : capacity * 2u;
+    }
+
+    record = (uint8_t *)realloc(recorder->record, capacity);
+    if (record == NULL) {
+        return false;
+    }
+
+    recorder->record = record;
+    recorder->record_capacity = capacity;
+    return true;
+}
+
+static bool trace_append_run(VirtuaPPUTraceRecorder *recorder, size_t offset, const uint8_t *data, size_t size)
+{
+    uint8_t *dst;
+
+    if (!trace_reserve(recorder, TRACE_RUN_HEADER_BYTES + size)) {
+        return false;
+    }
+
+    dst = recorder->record + recorder->record_size;
+    trace_put_u32(dst, (uint32_t)offset);
+    trace_put_u32(dst + 4u, (uint32_t)size);
+    memcpy(dst + TRACE_RUN_HEADER_BYTES, data, size);
+    memcpy(recorder->shadow + offset, data, size);
+    recorder->record_size += TRACE_RUN_HEADER_BYTES + size;
+    ++recorder->run_count;
+    return true;
+}
+
+static bool trace_diff_region(VirtuaPPUTraceRecorder *recorder, const TraceRegion *region)
+{
+    const uint8_t *shadow = recorder->shadow + region->offset;
+    size_t offset = 0u;
+
+    while (offset < region->size) {
+        size_t block = region->size - offset;
+        size_t run_start;
+
+        if (block > VIRTUAPPU_TRACE_BLOCK_BYTES) {
+            block = VIRTUAPPU_TRACE_BLOCK_BYTES;
+        }
+        if (memcmp(region->data + offset, shadow + offset, block) == 0) {
+            offset += block;
+            continue;
+        }
+
+        /* Consecutive dirty blocks are merged into one run. */
+        run_start = offset;
+        do {
+            offset += block;
+            block = region->size - offset;
+            if (block > VIRTUAPPU_TRACE_BLOCK_BYTES) {
+                block = VIRTUAPPU_TRACE_BLOCK_BYTES;
+            }
+        } while (offset < region->size && memcmp(region->data + offset, shadow + offset, block) != 0);
+
+        if (!trace_append_run(recorder, region->offset + run_start, region->data + run_start, offset - run_start)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static size_t trace_collect_regions(const VirtuaPPUContext *ctx, TraceRegion *regions)
+{
+    const VirtuaPPUMode1GbaMemory *memory = &ctx->mode1_memory;
+    uint8_t mode = ctx->registers->mode;
+
+    if (!virtuappu_context_supports_mode(ctx, mode)) {
+        return 0u;
+    }
+
+    /* Modes 1/2 are traced as the Mode1Layout image that virtuappu_context_copy_state() would produce. */
+    if (mode == 1u || mode == 2u) {
+        regions[0].offset = offsetof(Mode1Layout, io_mem);
+        regions[0].data = memory->io_mem;
+        regions[0].size = MODE1_IO_MEM_SIZE;
+        regions[1].offset = offsetof(Mode1Layout, vram);
+        regions[1].data = memory->vram;
+        regions[1].size = MODE1_VRAM_SIZE;
+        regions[2].offset = offsetof(Mode1Layout, bg_palette);
+        regions[2].data = (const uint8_t *)memory->bg_palette;
+        regions[2].size = MODE1_PALETTE_COLORS * sizeof(uint16_t);
+        regions[3].offset = offsetof(Mode1Layout, obj_palette);
+        regions[3].data = (const uint8_t *)memory->obj_palette;
+        regions[3].size = MODE1_PALETTE_COLORS * sizeof(uint16_t);
+        regions[4].offset = offsetof(Mode1Layout, oam_mem);
+        regions[4].data = (const uint8_t *)memory->oam_mem;
+        regions[4].size = MODE1_OAM_HALFWORDS * sizeof(uint16_t);
+        return 5u;
+    }
+
+    regions[0].offset = 0u;
+    regions[0].data = ctx->vram;
+    regions[0].size = virtuappu_mode_vram_footprint(mode);
+    return (regions[0].size != 0u) ? 1u : 0u;
+}
+
+VirtuaPPUTraceRecorder *virtuappu_trace_recorder_create(const char *path)
+{
+    VirtuaPPUTraceRecorder *recorder;
+    uint8_t header[TRACE_HEADER_BYTES];
+
+    if (path == NULL) {
+        return NULL;
+    }
+
+    recorder = (VirtuaPPUTraceRecorder *)calloc(1u, sizeof(*recorder));
+    if (recorder == NULL) {
+        return NULL;
+    }
+
+    recorder->shadow = (uint8_t *)calloc(VIRTUAPPU_VRAM_SIZE, sizeof(uint8_t));
+    recorder->file = fopen(path, "wb");
+    if (recorder->shadow == NULL || recorder->file == NULL) {
+        if (recorder->file != NULL) {
+            fclose(recorder->file);
+        }
+        free(recorder->shadow);
+        free(recorder);
+        return NULL;
+    }
+
+    memcpy(header, trace_magic, sizeof(trace_magic));
+    trace_put_u32(header + 8u, VIRTUAPPU_TRACE_VERSION);
+    trace_put_u32(header + 12u, VIRTUAPPU_TRACE_BLOCK_BYTES);
+    recorder->failed = fwrite(header, 1u, sizeof(header), recorder->file) != sizeof(header);
+
+    return recorder;
+}
+
+bool virtuappu_trace_record_frame(VirtuaPPUTraceRecorder *recorder, const VirtuaPPUContext *ctx)
+{
+    TraceRegion regions[5];
+    size_t region_count;
+    size_t i;
+
+    if (recorder == NULL || ctx == NULL || recorder->failed) {
+        return false;
+    }
+
+    recorder->record_size = 0u;
+    recorder->run_count = 0u;
+    if (!trace_reserve(recorder, TRACE_FRAME_HEADER_BYTES)) {
+        return false;
+    }
+
+    recorder->record[0] = (uint8_t)ctx->registers->frame_width;
+    recorder->record[1] = (uint8_t)(ctx->registers->frame_width >> 8u);
+    recorder->record[2] = ctx->registers->mode;
+    recorder->record[3] = ctx->registers->reserved;
+    recorder->record_size = TRACE_FRAME_HEADER_BYTES;
+
+    region_count = trace_collect_regions(ctx, regions);
+    for (i = 0; i < region_count; ++i) {
+        if (!trace_diff_region(recorder, &regions[i])) {
+            recorder->failed = true;
+            return false;
+        }
+    }
+
+    trace_put_u32(recorder->record + 4u, recorder->run_count);
+    if (fwrite(recorder->record, 1u, recorder->record_size, recorder->file) != recorder->record_size) {
+        recorder->failed = true;
+        return false;
+    }
+
+    ++recorder->frame_count;
+    return true;
+}
+
+uint64_t virtuappu_trace_recorder_frame_count(const VirtuaPPUTraceRecorder *recorder)
+{
+    return (recorder != NULL) ? recorder->frame_count : 0u;
+}
+
+bool virtuappu_trace_recorder_close(VirtuaPPUTraceRecorder *recorder)
+{
+    bool ok;
+
+    if (recorder == NULL) {
+        return false;
+    }
+
+    ok = !recorder->failed;
+    if (fclose(recorder->file) != 0) {
+        ok = false;
+    }
+
+    free(recorder->record);
+    free(recorder->shadow);
+    free(recorder);
+    return ok;
+}
+
+static bool trace_scan_frame(const uint8_t *data, size_t size, size_t *cursor)
+{
+    size_t at = *cursor;
+    uint32_t run_count;
+    uint32_t run;
+
+    if (size - at < TRACE_FRAME_HEADER_BYTES) {
+        return false;
+    }
+
+    run_count = trace_get_u32(data + at + 4u);
+    at += TRACE_FRAME_HEADER_BYTES;
+
+    for (run = 0; run < run_count; ++run) {
+        uint32_t offset;
+        uint32_t length;
+
+        if (size - at < TRACE_RUN_HEADER_BYTES) {
+            return false;
+        }
+
+        offset = trace_get_u32(data + at);
+        length = trace_get_u32(data + at + 4u);
+        at += TRACE_RUN_HEADER_BYTES;
+        if (offset > VIRTUAPPU_VRAM_SIZE || length > VIRTUAPPU_VRAM_SIZE - offset || length > size - at) {
+            return false;
+        }
+        at += length;
+    }
+
+    *cursor = at;
+    return true;
+}
+
+VirtuaPPUTraceReader *virtuappu_trace_reader_open(const char *path)
+{
+    VirtuaPPUTraceReader *reader;
+    FILE *file;
+    long length;
+    size_t cursor;
+
+    if (path == NULL) {
+        return NULL;
+    }
+
+    file = fopen(path, "rb");
+    if (file == NULL) {
+        return NULL;
+    }
+
+    reader = (VirtuaPPUTraceReader *)calloc(1u, sizeof(*reader));
+    if (reader == NULL || fseek(file, 0, SEEK_END) != 0 || (length = ftell(file)) < (long)TRACE_HEADER_BYTES ||
+        fseek(file, 0, SEEK_SET) != 0) {
+        free(reader);
+        fclose(file);
+        return NULL;
+    }
+
+    reader->size = (size_t)length;
+    reader->data = (uint8_t *)malloc(reader->size);
+    if (reader->data == NULL || fread(reader->data, 1u, reader->size, file) != reader->size) {
+        virtuappu_trace_reader_close(reader);
+        fclose(file);
+        return NULL;
+    }
+    fclose(file);
+
+    if (memcmp(reader->data, trace_magic, sizeof(trace_magic)) != 0 ||
+        trace_get_u32(reader->data + 8u) != VIRTUAPPU_TRACE_VERSION) {
+        virtuappu_trace_reader_close(reader);
+        return NULL;
+    }
+
+    /* Validate every record up front so replay never has to bounds-check. */
+    cursor = TRACE_HEADER_BYTES;
+    while (cursor < reader->size) {
+        if (!trace_scan_frame(reader->data, reader->size, &cursor)) {
+            virtuappu_trace_reader_close(reader);
+            return NULL;
+        }
+        ++reader->frame_count;
+    }
+
+    reader->cursor = TRACE_HEADER_BYTES;
+    return reader;
+}
+
+void virtuappu_trace_reader_close(VirtuaPPUTraceReader *reader)
+{
+    if (reader == NULL) {
+        return;
+    }
+
+    free(reader->data);
+    free(reader);
+}
+
+uint64_t virtuappu_trace_reader_frame_count(const VirtuaPPUTraceReader *reader)
+{
+    return (reader != NULL) ? reader->frame_count : 0u;
+}
+
+void virtuappu_trace_reader_rewind(VirtuaPPUTraceReader *reader)
+{
+    if (reader == NULL) {
+        return;
+    }
+
+    reader->cursor = TRACE_HEADER_BYTES;
+}
+
+bool virtuappu_trace_read_frame(VirtuaPPUTraceReader *reader, VirtuaPPUContext *ctx)
+{
+    const uint8_t *frame;
+    uint32_t run_count;
+    uint32_t run;
+    size_t at;
+
+    if (reader == NULL || ctx == NULL || reader->cursor >= reader->size) {
+        return false;
+    }
+
+    /* Deltas are relative to an all-zero state, so the first frame starts from a clean context. */
+    if (reader->cursor == TRACE_HEADER_BYTES) {
+        virtuappu_reset_ctx(ctx);
+    }
+
+    frame = reader->data + reader->cursor;
+    run_count = trace_get_u32(frame + 4u);
+
+    /* Runs were bounded by the full VRAM size at open; contexts sized for one mode may hold less. */
+    at = reader->cursor + TRACE_FRAME_HEADER_BYTES;
+    for (run = 0; run < run_count; ++run) {
+        uint32_t offset = trace_get_u32(reader->data + at);
+        uint32_t length = trace_get_u32(reader->data + at + 4u);
+
+        if ((size_t)offset + length > ctx->vram_size) {
+            return false;
+        }
+        at += TRACE_RUN_HEADER_BYTES + length;
+    }
+
+    ctx->registers->frame_width = (uint16_t)(frame[0] | (frame[1] << 8u));
+    ctx->registers->mode = frame[2];
+    ctx->registers->reserved = frame[3];
+    at = reader->cursor + TRACE_FRAME_HEADER_BYTES;
+
+    for (run = 0; run < run_count; ++run) {
+        uint32_t offset = trace_get_u32(reader->data + at);
+        uint32_t length = trace_get_u32(reader->data + at + 4u);
+
+        memcpy(ctx->vram + offset, reader->data + at + TRACE_RUN_HEADER_BYTES, length);
+        at += TRACE_RUN_HEADER_BYTES + length;
+    }
+
+    if (ctx->registers->mode == 1u || ctx->registers->mode == 2u) {
+        virtuappu_mode1_bind_gba_memory_ctx(ctx, NULL);
+    }
+
+    reader->cursor = at;
+    return true;
+}
+
+static bool trace_offline_next(void *user, uint64_t frame_index, VirtuaPPUContext *frame)
+{
+    TraceOfflineSource *source = (TraceOfflineSource *)user;
+
+    (void)frame_index;
+
+    if (!virtuappu_trace_read_frame(source->reader, source->cursor)) {
+        return false;
+    }
+
+    virtuappu_context_copy_state(frame, source->cursor);
+    return true;
+}
+
+static void trace_offline_sink(void *user, uint64_t frame_index, const VirtuaPPUContext *frame)
+{
+    TraceOfflineSource *source = (TraceOfflineSource *)user;
+
+    source->sink(source->user, frame_index, frame);
+}
+
+uint64_t virtuappu_trace_render_offline(
+    VirtuaPPUTraceReader *reader,
+    VirtuaPPUOfflineSinkFn sink,
+    void *user,
+    uint32_t frames_in_flight)
+{
+    TraceOfflineSource source;
+    uint64_t rendered;
+
+    if (reader == NULL) {
+        return 0u;
+    }
+
+    /* Deltas are applied in order on one cursor context; each frame then renders from its own copy. */
+    source.reader = reader;
+    source.cursor = virtuappu_context_create();
+    source.sink = sink;
+    source.user = user;
+    if (source.cursor == NULL) {
+        return 0u;
+    }
+
+    virtuappu_trace_reader_rewind(reader);
+    rendered = virtuappu_render_offline(trace_offline_next, (sink != NULL) ? trace_offline_sink : NULL, &source, frames_in_flight);
+    virtuappu_context_destroy(source.cursor);
+
+    return rendered;
+}
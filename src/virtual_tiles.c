@@ -0,0 +1,584 @@
+#include "virtual_tiles.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "modes_impl.h"
+#include "virtuappu.h"
+
+#define VTILES_EMPTY UINT32_MAX
+
+enum {
+    VTILES_MARGIN_TILES = 1
+};
+
+struct VirtuaPPUVirtualTiles {
+    VirtuaPPUVirtualTilesConfig config;
+    uint32_t slot_count;
+    uint32_t first_tile;
+    uint32_t hash_mask;
+    uint32_t *hash_keys;
+    uint32_t *hash_slots;
+    uint32_t *slot_logical;
+    uint32_t *slot_frame;
+    uint32_t *slot_prev;
+    uint32_t *slot_next;
+    uint32_t lru_head;
+    uint32_t lru_tail;
+    uint32_t resident;
+    uint32_t frame;
+    VirtuaPPUVirtualTileStats stats;
+};
+
+static uint32_t vtiles_bucket(const VirtuaPPUVirtualTiles *tiles, uint32_t logical_tile)
+{
+    return (logical_tile * 0x9E3779B1u) & tiles->hash_mask;
+}
+
+static uint32_t vtiles_find(const VirtuaPPUVirtualTiles *tiles, uint32_t logical_tile)
+{
+    uint32_t bucket = vtiles_bucket(tiles, logical_tile);
+
+    while (tiles->hash_slots[bucket] != VTILES_EMPTY) {
+        if (tiles->hash_keys[bucket] == logical_tile) {
+            return tiles->hash_slots[bucket];
+        }
+        bucket = (bucket + 1u) & tiles->hash_mask;
+    }
+
+    return VTILES_EMPTY;
+}
+
+static void vtiles_insert(VirtuaPPUVirtualTiles *tiles, uint32_t logical_tile, uint32_t slot)
+{
+    uint32_t bucket = vtiles_bucket(tiles, logical_tile);
+
+    while (tiles->hash_slots[bucket] != VTILES_EMPTY) {
+        bucket = (bucket + 1u) & tiles->hash_mask;
+    }
+
+    tiles->hash_keys[bucket] = logical_tile;
+    tiles->hash_slots[bucket] = slot;
+}
+
+/* Linear probing with backward-shift deletion keeps lookups tombstone-free however often tiles churn. */
+static void vtiles_remove(VirtuaPPUVirtualTiles *tiles, uint32_t logical_tile)
+{
+    uint32_t bucket = vtiles_bucket(tiles, logical_tile);
+    uint32_t next;
+
+    while (tiles->hash_slots[bucket] != VTILES_EMPTY && tiles->hash_keys[bucket] != logical_tile) {
+        bucket = (bucket + 1u) & tiles->hash_mask;
+    }
+    if (tiles->hash_slots[bucket] == VTILES_EMPTY) {
+        return;
+    }
+
+    next = bucket;
+    for (;;) {
+        uint32_t home;
+
+        tiles->hash_slots[bucket] = VTILES_EMPTY;
+        do {
+            next = (next + 1u) & tiles->hash_mask;
+            if (tiles->hash_slots[next] == VTILES_EMPTY) {
+                return;
+            }
+            home = vtiles_bucket(tiles, tiles->hash_keys[next]);
+        } while (((next - home) & tiles->hash_mask) < ((next - bucket) & tiles->hash_mask));
+
+        tiles->hash_keys[bucket] = tiles->hash_keys[next];
+        tiles->hash_slots[bucket] = tiles->hash_slots[next];
+        bucket = next;
+    }
+}
+
+static void vtiles_unlink(VirtuaPPUVirtualTiles *tiles, uint32_t slot)
+{
+    uint32_t prev = tiles->slot_prev[slot];
+    uint32_t next = tiles->slot_next[slot];
+
+    if (prev != VTILES_EMPTY) {
+        tiles->slot_next[prev] = next;
+    } else {
+        tiles->lru_head = next;
+    }
+    if (next != VTILES_EMPTY) {
+        tiles->slot_prev[next] = prev;
+    } else {
+        tiles->lru_tail = prev;
+    }
+}
+
+static void vtiles_push_front(VirtuaPPUVirtualTiles *tiles, uint32_t slot)
+{
+    tiles->slot_prev[slot] = VTILES_EMPTY;
+    tiles->slot_next[slot] = tiles->lru_head;
+    if (tiles->lru_head != VTILES_EMPTY) {
+        tiles->slot_prev[tiles->lru_head] = slot;
+    } else {
+        tiles->lru_tail = slot;
+    }
+    tiles->lru_head = slot;
+}
+
+static void vtiles_push_back(VirtuaPPUVirtualTiles *tiles, uint32_t slot)
+{
+    tiles->slot_next[slot] = VTILES_EMPTY;
+    tiles->slot_prev[slot] = tiles->lru_tail;
+    if (tiles->lru_tail != VTILES_EMPTY) {
+        tiles->slot_next[tiles->lru_tail] = slot;
+    } else {
+        tiles->lru_head = slot;
+    }
+    tiles->lru_tail = slot;
+}
+
+static void vtiles_reset(VirtuaPPUVirtualTiles *tiles)
+{
+    uint32_t slot;
+
+    memset(tiles->hash_slots, 0xFF, ((size_t)tiles->hash_mask + 1u) * sizeof(uint32_t));
+    tiles->lru_head = VTILES_EMPTY;
+    tiles->lru_tail = VTILES_EMPTY;
+    for (slot = 0; slot < tiles->slot_count; ++slot) {
+        tiles->slot_logical[slot] = VTILES_EMPTY;
+        tiles->slot_frame[slot] = 0u;
+        vtiles_push_back(tiles, slot);
+    }
+    tiles->resident = 0u;
+}
+
+/* A tile used in the current frame is never evicted for another one of the same frame; once every slot
+ * is pinned that way, further misses are counted as overflows and stay unresolved. */
+static void vtiles_touch(VirtuaPPUVirtualTiles *tiles, uint8_t *gfx_data, uint32_t logical_tile, VirtuaPPUVirtualTileStats *stats)
+{
+    uint32_t slot = vtiles_find(tiles, logical_tile);
+
+    if (slot != VTILES_EMPTY) {
+        if (tiles->slot_frame[slot] != tiles->frame) {
+            tiles->slot_frame[slot] = tiles->frame;
+            ++stats->tiles_referenced;
+            ++stats->hits;
+        }
+        vtiles_unlink(tiles, slot);
+        vtiles_push_front(tiles, slot);
+        return;
+    }
+
+    ++stats->tiles_referenced;
+    slot = tiles->lru_tail;
+    if (slot == VTILES_EMPTY || (tiles->slot_logical[slot] != VTILES_EMPTY && tiles->slot_frame[slot] == tiles->frame)) {
+        ++stats->overflows;
+        return;
+    }
+
+    if (tiles->slot_logical[slot] != VTILES_EMPTY) {
+        vtiles_remove(tiles, tiles->slot_logical[slot]);
+        tiles->slot_logical[slot] = VTILES_EMPTY;
+        --tiles->resident;
+        ++stats->evictions;
+    }
+
+    if (!tiles->config.source(tiles->config.user, logical_tile,
+                              gfx_data + (size_t)(tiles->first_tile + slot) * tiles->config.tile_bytes,
+                              tiles->config.tile_bytes)) {
+        ++stats->source_failures;
+        return;
+    }
+
+    ++stats->misses;
+    tiles->slot_logical[slot] = logical_tile;
+    tiles->slot_frame[slot] = tiles->frame;
+    ++tiles->resident;
+    vtiles_insert(tiles, logical_tile, slot);
+    vtiles_unlink(tiles, slot);
+    vtiles_push_front(tiles, slot);
+}
+
+static void vtiles_free(VirtuaPPUVirtualTiles *tiles)
+{
+    if (tiles == NULL) {
+        return;
+    }
+
+    free(tiles->hash_keys);
+    free(tiles->hash_slots);
+    free(tiles->slot_logical);
+    free(tiles->slot_frame);
+    free(tiles->slot_prev);
+    free(tiles->slot_next);
+    free(tiles);
+}
+
+bool virtuappu_virtual_tiles_enable_ctx(VirtuaPPUContext *ctx, const VirtuaPPUVirtualTilesConfig *config)
+{
+    VirtuaPPUVirtualTiles *tiles;
+    uint32_t gfx_tiles;
+    uint32_t hash_size = 1u;
+
+    if (ctx == NULL || config == NULL || config->source == NULL || ctx->vram_size < sizeof(Mode0Layout) ||
+        config->tile_bytes == 0u || config->gfx_offset % config->tile_bytes != 0u ||
+        config->gfx_offset >= sizeof(((Mode0Layout *)0)->gfx_data)) {
+        return false;
+    }
+
+    gfx_tiles = (uint32_t)((sizeof(((Mode0Layout *)0)->gfx_data) - config->gfx_offset) / config->tile_bytes);
+    if (gfx_tiles == 0u || config->resident_slots > gfx_tiles) {
+        return false;
+    }
+
+    tiles = (VirtuaPPUVirtualTiles *)calloc(1u, sizeof(*tiles));
+    if (tiles == NULL) {
+        return false;
+    }
+
+    tiles->config = *config;
+    tiles->slot_count = (config->resident_slots != 0u) ? config->resident_slots : gfx_tiles;
+    tiles->first_tile = config->gfx_offset / config->tile_bytes;
+    while (hash_size < tiles->slot_count * 2u) {
+        hash_size <<= 1u;
+    }
+    tiles->hash_mask = hash_size - 1u;
+    tiles->hash_keys = (uint32_t *)malloc((size_t)hash_size * sizeof(uint32_t));
+    tiles->hash_slots = (uint32_t *)malloc((size_t)hash_size * sizeof(uint32_t));
+    tiles->slot_logical = (uint32_t *)malloc((size_t)tiles->slot_count * sizeof(uint32_t));
+    tiles->slot_frame = (uint32_t *)malloc((size_t)tiles->slot_count * sizeof(uint32_t));
+    tiles->slot_prev = (uint32_t *)malloc((size_t)tiles->slot_count * sizeof(uint32_t));
+    tiles->slot_next = (uint32_t *)malloc((size_t)tiles->slot_count * sizeof(uint32_t));
+    if (tiles->hash_keys == NULL || tiles->hash_slots == NULL || tiles->slot_logical == NULL || tiles->slot_frame == NULL ||
+        tiles->slot_prev == NULL || tiles->slot_next == NULL) {
+        vtiles_free(tiles);
+        return false;
+    }
+
+    vtiles_reset(tiles);
+    tiles->stats.capacity = tiles->slot_count;
+    vtiles_free(ctx->virtual_tiles);
+    ctx->virtual_tiles = tiles;
+    ctx->input_hash_valid = false;
+    return true;
+}
+
+void virtuappu_virtual_tiles_disable_ctx(VirtuaPPUContext *ctx)
+{
+    if (ctx == NULL) {
+        return;
+    }
+
+    vtiles_free(ctx->virtual_tiles);
+    ctx->virtual_tiles = NULL;
+}
+
+void virtuappu_virtual_tiles_flush_ctx(VirtuaPPUContext *ctx)
+{
+    if (ctx == NULL || ctx->virtual_tiles == NULL) {
+        return;
+    }
+
+    vtiles_reset(ctx->virtual_tiles);
+    ctx->input_hash_valid = false;
+}
+
+void virtuappu_virtual_tiles_invalidate_ctx(VirtuaPPUContext *ctx, uint32_t logical_tile)
+{
+    VirtuaPPUVirtualTiles *tiles;
+    uint32_t slot;
+
+    if (ctx == NULL || ctx->virtual_tiles == NULL) {
+        return;
+    }
+
+    tiles = ctx->virtual_tiles;
+    slot = vtiles_find(tiles, logical_tile);
+    if (slot == VTILES_EMPTY) {
+        return;
+    }
+
+    vtiles_remove(tiles, logical_tile);
+    tiles->slot_logical[slot] = VTILES_EMPTY;
+    --tiles->resident;
+    vtiles_unlink(tiles, slot);
+    vtiles_push_back(tiles, slot);
+    ctx->input_hash_valid = false;
+}
+
+uint32_t virtuappu_virtual_tiles_prefetch_ctx(VirtuaPPUContext *ctx, const uint32_t *logical_tiles, size_t count)
+{
+    VirtuaPPUVirtualTileStats stats;
+    Mode0Layout *layout;
+    size_t i;
+
+    if (ctx == NULL || ctx->virtual_tiles == NULL || logical_tiles == NULL) {
+        return 0u;
+    }
+
+    /* Prefetches only fill free or stale slots; tiles the last frame used stay resident. */
+    layout = (Mode0Layout *)ctx->vram;
+    memset(&stats, 0, sizeof(stats));
+    for (i = 0; i < count; ++i) {
+        vtiles_touch(ctx->virtual_tiles, layout->gfx_data, logical_tiles[i], &stats);
+    }
+
+    ctx->input_hash_valid = false;
+    return stats.misses;
+}
+
+static int64_t vtiles_floor_div(int64_t value, int64_t divisor)
+{
+    return (value >= 0) ? value / divisor : -((-value + divisor - 1) / divisor);
+}
+
+/* Touches the map cells under the pixel box [x0, x1) x [y0, y1) plus a one-tile margin, each cell once. */
+static void vtiles_touch_bg_window(
+    VirtuaPPUVirtualTiles *tiles,
+    Mode0Layout *layout,
+    size_t bg,
+    const int64_t box[4],
+    uint32_t map_width,
+    uint32_t map_height,
+    bool wrap_x,
+    bool wrap_y)
+{
+    uint32_t bank = (uint32_t)layout->bg[bg].tile_base << 16u;
+    int64_t tx0 = vtiles_floor_div(box[0], 8) - VTILES_MARGIN_TILES;
+    int64_t tx1 = vtiles_floor_div(box[2] - 1, 8) + VTILES_MARGIN_TILES;
+    int64_t ty0 = vtiles_floor_div(box[1], 8) - VTILES_MARGIN_TILES;
+    int64_t ty1 = vtiles_floor_div(box[3] - 1, 8) + VTILES_MARGIN_TILES;
+    int64_t ty;
+    int64_t tx;
+
+    if (wrap_x && tx1 - tx0 + 1 > (int64_t)map_width) {
+        tx0 = 0;
+        tx1 = (int64_t)map_width - 1;
+    } else if (!wrap_x) {
+        tx0 = (tx0 < 0) ? 0 : tx0;
+        tx1 = (tx1 >= (int64_t)map_width) ? (int64_t)map_width - 1 : tx1;
+    }
+    if (wrap_y && ty1 - ty0 + 1 > (int64_t)map_height) {
+        ty0 = 0;
+        ty1 = (int64_t)map_height - 1;
+    } else if (!wrap_y) {
+        ty0 = (ty0 < 0) ? 0 : ty0;
+        ty1 = (ty1 >= (int64_t)map_height) ? (int64_t)map_height - 1 : ty1;
+    }
+
+    for (ty = ty0; ty <= ty1; ++ty) {
+        int64_t row = ty - vtiles_floor_div(ty, map_height) * map_height;
+
+        for (tx = tx0; tx <= tx1; ++tx) {
+            int64_t column = tx - vtiles_floor_div(tx, map_width) * map_width;
+            size_t index = (size_t)row * map_width + (size_t)column;
+
+            vtiles_touch(tiles, layout->gfx_data, bank | (layout->tilemaps[bg][index] & 0xFFFFu), &tiles->stats);
+        }
+    }
+}
+
+/* The screen box a BG samples this frame, in map pixels, across every line's scroll or affine offset. */
+static void vtiles_bg_visible_box(const Mode0Layout *layout, size_t bg, uint32_t frame_width, int64_t box[4])
+{
+    const Mode0BgEntry *entry = &layout->bg[bg];
+    int64_t origin_x = 0;
+    int64_t origin_y = 0;
+    int64_t line_min_x = INT64_MAX;
+    int64_t line_max_x = INT64_MIN;
+    int64_t line_min_y = INT64_MAX;
+    int64_t line_max_y = INT64_MIN;
+    size_t line;
+
+    if ((entry->flags & MODE0_BG_FLAG_RING) != 0u) {
+        origin_x = layout->bg_ring[bg].world_x;
+        origin_y = layout->bg_ring[bg].world_y;
+    }
+
+    if ((entry->flags & MODE0_BG_FLAG_AFFINE) == 0u) {
+        for (line = 0; line < MODE0_MAX_LINES; ++line) {
+            int64_t x = origin_x + entry->scroll_x + layout->bg_line_scroll[bg][line].scroll_x;
+            int64_t y = origin_y + entry->scroll_y + layout->bg_line_scroll[bg][line].scroll_y + (int64_t)line;
+
+            line_min_x = (x < line_min_x) ? x : line_min_x;
+            line_max_x = (x > line_max_x) ? x : line_max_x;
+            line_min_y = (y < line_min_y) ? y : line_min_y;
+            line_max_y = (y > line_max_y) ? y : line_max_y;
+        }
+        box[0] = line_min_x;
+        box[1] = line_min_y;
+        box[2] = line_max_x + frame_width;
+        box[3] = line_max_y + 1;
+        return;
+    }
+
+    /* Affine BGs: the 8.8 matrix maps the screen corners, and per-line tx/ty only shift the result. */
+    {
+        const int64_t corners[4][2] = {
+            {0, 0}, {(int64_t)frame_width, 0}, {0, MODE0_MAX_LINES}, {(int64_t)frame_width, MODE0_MAX_LINES}};
+        size_t c;
+
+        for (line = 0; line < MODE0_MAX_LINES; ++line) {
+            int64_t x = layout->bg_line_affine[bg][line].tx;
+            int64_t y = layout->bg_line_affine[bg][line].ty;
+
+            line_min_x = (x < line_min_x) ? x : line_min_x;
+            line_max_x = (x > line_max_x) ? x : line_max_x;
+            line_min_y = (y < line_min_y) ? y : line_min_y;
+            line_max_y = (y > line_max_y) ? y : line_max_y;
+        }
+
+        box[0] = box[1] = INT64_MAX;
+        box[2] = box[3] = INT64_MIN;
+        for (c = 0; c < 4u; ++c) {
+            int64_t u = (int64_t)entry->matrix.a * corners[c][0] + (int64_t)entry->matrix.b * corners[c][1] + entry->tx;
+            int64_t v = (int64_t)entry->matrix.c * corners[c][0] + (int64_t)entry->matrix.d * corners[c][1] + entry->ty;
+
+            box[0] = (u + line_min_x < box[0]) ? u + line_min_x : box[0];
+            box[1] = (v + line_min_y < box[1]) ? v + line_min_y : box[1];
+            box[2] = (u + line_max_x > box[2]) ? u + line_max_x : box[2];
+            box[3] = (v + line_max_y > box[3]) ? v + line_max_y : box[3];
+        }
+
+        box[0] = vtiles_floor_div(box[0], 256) + origin_x;
+        box[1] = vtiles_floor_div(box[1], 256) + origin_y;
+        box[2] = vtiles_floor_div(box[2], 256) + origin_x + 1;
+        box[3] = vtiles_floor_div(box[3], 256) + origin_y + 1;
+    }
+}
+
+void virtuappu_virtual_tiles_begin_frame_ctx(VirtuaPPUContext *ctx)
+{
+    VirtuaPPUVirtualTiles *tiles;
+    Mode0Layout *layout;
+    uint32_t frame_width;
+    size_t bg;
+    size_t i;
+
+    if (ctx == NULL || ctx->virtual_tiles == NULL) {
+        return;
+    }
+
+    tiles = ctx->virtual_tiles;
+    layout = (Mode0Layout *)ctx->vram;
+    frame_width = ctx->registers->frame_width;
+    ++tiles->frame;
+    memset(&tiles->stats, 0, sizeof(tiles->stats));
+
+    /* BG entries name logical tile (tile_base << 16) | tile_index. Only the window each BG shows this frame
+     * is touched: ring BGs wrap over their torus, plain maps are row-major and one frame wide. */
+    for (bg = 0; bg < MODE0_BG_COUNT && frame_width != 0u; ++bg) {
+        const Mode0BgEntry *entry = &layout->bg[bg];
+        const Mode0BgRing *ring = &layout->bg_ring[bg];
+        uint32_t map_width = (frame_width + 7u) / 8u;
+        uint32_t map_height;
+        int64_t box[4];
+        bool ring_enabled;
+
+        if ((entry->flags & MODE0_BG_FLAG_ENABLED) == 0u) {
+            continue;
+        }
+
+        ring_enabled = (entry->flags & MODE0_BG_FLAG_RING) != 0u && ring->width_tiles != 0u && ring->height_tiles != 0u &&
+                       (size_t)ring->width_tiles * ring->height_tiles <= MODE0_TILEMAP_ENTRIES_PER_BG;
+        if (ring_enabled) {
+            map_width = ring->width_tiles;
+            map_height = ring->height_tiles;
+        } else {
+            map_height = MODE0_TILEMAP_ENTRIES_PER_BG / map_width;
+        }
+        if (map_height == 0u) {
+            continue;
+        }
+
+        vtiles_bg_visible_box(layout, bg, frame_width, box);
+        vtiles_touch_bg_window(
+            tiles,
+            layout,
+            bg,
+            box,
+            map_width,
+            map_height,
+            ring_enabled || (entry->flags & MODE0_BG_FLAG_WRAP_X) != 0u,
+            ring_enabled || (entry->flags & MODE0_BG_FLAG_WRAP_Y) != 0u);
+    }
+
+    /* Objects cover width_blocks * height_blocks consecutive tiles in the configured OBJ bank. */
+    for (i = 0; i < MODE0_OAM_COUNT; ++i) {
+        const Mode0OAMEntry *obj = &layout->oam[i];
+        uint32_t tile_count;
+        uint32_t tile;
+
+        if ((obj->flags & MODE0_OAM_FLAG_ENABLED) == 0u) {
+            continue;
+        }
+
+        tile_count = (uint32_t)(obj->width_blocks ? obj->width_blocks : 1u) * (obj->height_blocks ? obj->height_blocks : 1u);
+        for (tile = 0; tile < tile_count; ++tile) {
+            uint32_t logical = ((uint32_t)tiles->config.obj_tile_bank << 16u) | ((obj->tile_index + tile) & 0xFFFFu);
+            vtiles_touch(tiles, layout->gfx_data, logical, &tiles->stats);
+        }
+    }
+
+    tiles->stats.resident = tiles->resident;
+    tiles->stats.capacity = tiles->slot_count;
+}
+
+uint32_t virtuappu_virtual_tiles_lookup_ctx(const VirtuaPPUContext *ctx, uint32_t logical_tile)
+{
+    uint32_t slot;
+
+    if (ctx == NULL || ctx->virtual_tiles == NULL) {
+        return VIRTUAPPU_VIRTUAL_TILE_NONE;
+    }
+
+    slot = vtiles_find(ctx->virtual_tiles, logical_tile);
+    return (slot == VTILES_EMPTY) ? VIRTUAPPU_VIRTUAL_TILE_NONE : ctx->virtual_tiles->first_tile + slot;
+}
+
+bool virtuappu_get_virtual_tile_stats_ctx(const VirtuaPPUContext *ctx, VirtuaPPUVirtualTileStats *stats)
+{
+    if (stats == NULL) {
+        return false;
+    }
+
+    memset(stats, 0, sizeof(*stats));
+    if (ctx == NULL || ctx->virtual_tiles == NULL) {
+        return false;
+    }
+
+    *stats = ctx->virtual_tiles->stats;
+    return true;
+}
+
+bool virtuappu_virtual_tiles_enable(const VirtuaPPUVirtualTilesConfig *config)
+{
+    return virtuappu_virtual_tiles_enable_ctx(virtuappu_get_default_context(), config);
+}
+
+void virtuappu_virtual_tiles_disable(void)
+{
+    virtuappu_virtual_tiles_disable_ctx(virtuappu_get_default_context());
+}
+
+void virtuappu_virtual_tiles_flush(void)
+{
+    virtuappu_virtual_tiles_flush_ctx(virtuappu_get_default_context());
+}
+
+void virtuappu_virtual_tiles_invalidate(uint32_t logical_tile)
+{
+    virtuappu_virtual_tiles_invalidate_ctx(virtuappu_get_default_context(), logical_tile);
+}
+
+uint32_t virtuappu_virtual_tiles_prefetch(const uint32_t *logical_tiles, size_t count)
+{
+    return virtuappu_virtual_tiles_prefetch_ctx(virtuappu_get_default_context(), logical_tiles, count);
+}
+
+uint32_t virtuappu_virtual_tiles_lookup(uint32_t logical_tile)
+{
+    return virtuappu_virtual_tiles_lookup_ctx(virtuappu_get_default_context(), logical_tile);
+}
+
+bool virtuappu_get_virtual_tile_stats(VirtuaPPUVirtualTileStats *stats)
+{
+    return virtuappu_get_virtual_tile_stats_ctx(virtuappu_get_default_context(), stats);
+}
@@ -1,51 +1,868 @@
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE
+#endif
+
 #include "virtuappu.h"
 
+#include <stddef.h>
+#include <stdlib.h>
 #include <string.h>
 
+#if defined(__linux__)
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
 #include "modes_impl.h"
+#include "simd.h"
+#include "thread_pool.h"
 
 uint32_t virtuappu_frame_buffer[VIRTUAPPU_FRAME_BUFFER_SIZE];
 uint8_t virtuappu_vram[VIRTUAPPU_VRAM_SIZE];
 PPUMemory virtuappu_registers;
 
-void virtuappu_reset(void)
+_Static_assert(VIRTUAPPU_MAX_FRAME_WIDTH >= MODE7_GB_SCREEN_WIDTH && VIRTUAPPU_MAX_FRAME_HEIGHT >= MODE7_GB_SCREEN_HEIGHT,
+               "Frame limits must hold at least the Mode 7 screen");
+_Static_assert(VIRTUAPPU_VRAM_SIZE >= (int)sizeof(Mode7Layout), "VRAM must hold at least a Mode7Layout");
+_Static_assert(VIRTUAPPU_VRAM_SIZE % VIRTUAPPU_VRAM_PAGE_BYTES == 0, "VRAM must be a whole number of pages");
+
+typedef struct VirtuaPPUBatchTask {
+    VirtuaPPUContext *ctx;
+    size_t first_line;
+    size_t end_line;
+} VirtuaPPUBatchTask;
+
+static VirtuaPPUOutputPalette virtuappu_default_output_palette;
+#ifdef VIRTUAPPU_ENABLE_STATS
+static VirtuaPPUStatsState virtuappu_default_stats;
+#endif
+
+static VirtuaPPUContext virtuappu_default_context = {
+    virtuappu_frame_buffer,
+    VIRTUAPPU_FRAME_BUFFER_SIZE,
+    virtuappu_vram,
+    VIRTUAPPU_VRAM_SIZE,
+    &virtuappu_registers,
+    {
+        virtuappu_vram + offsetof(Mode1Layout, io_mem),
+        virtuappu_vram + offsetof(Mode1Layout, vram),
+        (uint16_t *)(virtuappu_vram + offsetof(Mode1Layout, bg_palette)),
+        (uint16_t *)(virtuappu_vram + offsetof(Mode1Layout, obj_palette)),
+        (uint16_t *)(virtuappu_vram + offsetof(Mode1Layout, oam_mem))
+    },
+    {NULL, 0u, VIRTUAPPU_FORMAT_ABGR8888, 0u, false},
+    {0u, 0u, 0u},
+    0u,
+    false,
+    false,
+    false,
+    0u,
+    {{0u}},
+    &virtuappu_default_output_palette,
+    {false, 0u, 0u, {0u}},
+    NULL,
+    NULL,
+    false
+#ifdef VIRTUAPPU_ENABLE_STATS
+    ,
+    &virtuappu_default_stats
+#endif
+};
+
+static VirtuaPPUContext *virtuappu_context_alloc(size_t frame_buffer_pixels, size_t vram_size)
 {
-    memset(virtuappu_frame_buffer, 0, sizeof(virtuappu_frame_buffer));
-    memset(virtuappu_vram, 0, sizeof(virtuappu_vram));
-    memset(&virtuappu_registers, 0, sizeof(virtuappu_registers));
+    VirtuaPPUContext *ctx = (VirtuaPPUContext *)calloc(1u, sizeof(*ctx));
+
+    if (ctx == NULL) {
+        return NULL;
+    }
+
+    virtuappu_simd_select();
+    ctx->owns_storage = true;
+    ctx->frame_buffer = (uint32_t *)calloc(frame_buffer_pixels, sizeof(uint32_t));
+    ctx->frame_buffer_pixels = frame_buffer_pixels;
+    ctx->vram = (vram_size != 0u) ? (uint8_t *)calloc(vram_size, sizeof(uint8_t)) : NULL;
+    ctx->vram_size = vram_size;
+#ifdef VIRTUAPPU_ENABLE_STATS
+    ctx->stats = (VirtuaPPUStatsState *)calloc(1u, sizeof(*ctx->stats));
+    if (ctx->stats == NULL) {
+        virtuappu_context_destroy(ctx);
+        return NULL;
+    }
+#endif
+    if (ctx->frame_buffer == NULL || (ctx->vram == NULL && vram_size != 0u)) {
+        virtuappu_context_destroy(ctx);
+        return NULL;
+    }
+
+    ctx->registers = &ctx->owned_registers;
+    virtuappu_mode1_bind_gba_memory_ctx(ctx, NULL);
+
+    return ctx;
 }
 
-void virtuappu_render_frame(void)
+VirtuaPPUContext *virtuappu_context_create(void)
+{
+    return virtuappu_context_alloc(VIRTUAPPU_FRAME_BUFFER_SIZE, VIRTUAPPU_VRAM_SIZE);
+}
+
+VirtuaPPUContext *virtuappu_context_create_for_mode(uint8_t mode, uint16_t max_frame_width, uint32_t flags)
+{
+    VirtuaPPUContext *ctx;
+    size_t frame_pixels;
+    size_t vram_size;
+
+    switch (mode) {
+    case 0:
+        if (max_frame_width == 0u) {
+            max_frame_width = VIRTUAPPU_MAX_FRAME_WIDTH;
+        }
+        if (max_frame_width > VIRTUAPPU_MAX_FRAME_WIDTH || MODE0_MAX_LINES > VIRTUAPPU_MAX_FRAME_HEIGHT) {
+            return NULL;
+        }
+        frame_pixels = (size_t)max_frame_width * MODE0_MAX_LINES;
+        break;
+    case 1:
+    case 2:
+        frame_pixels = (size_t)MODE1_GBA_WIDTH * MODE1_GBA_HEIGHT;
+        break;
+    case 7:
+        frame_pixels = (size_t)MODE7_GB_SCREEN_WIDTH * MODE7_GB_SCREEN_HEIGHT;
+        break;
+    default:
+        return NULL;
+    }
+
+    /* Hosts that bind their own GBA memory skip the fallback Mode1Layout entirely. */
+    vram_size = virtuappu_mode_vram_footprint(mode);
+    if ((mode == 1u || mode == 2u) && (flags & VIRTUAPPU_CONTEXT_EXTERNAL_GBA_MEMORY) != 0u) {
+        vram_size = 0u;
+    }
+    vram_size = (vram_size + VIRTUAPPU_VRAM_PAGE_BYTES - 1u) & ~(size_t)(VIRTUAPPU_VRAM_PAGE_BYTES - 1u);
+    if (vram_size > VIRTUAPPU_VRAM_SIZE) {
+        return NULL;
+    }
+
+    ctx = virtuappu_context_alloc(frame_pixels, vram_size);
+    if (ctx != NULL) {
+        ctx->registers->mode = mode;
+        ctx->registers->frame_width = (mode == 0u) ? max_frame_width : 0u;
+    }
+    return ctx;
+}
+
+void virtuappu_context_destroy(VirtuaPPUContext *ctx)
+{
+    if (ctx == NULL || !ctx->owns_storage) {
+        return;
+    }
+
+#ifdef VIRTUAPPU_ENABLE_STATS
+    free(ctx->stats);
+#endif
+    virtuappu_virtual_tiles_disable_ctx(ctx);
+    free(ctx->output_palette);
+    free(ctx->frame_buffer);
+    free(ctx->vram);
+    free(ctx);
+}
+
+VirtuaPPUContext *virtuappu_get_default_context(void)
+{
+    return &virtuappu_default_context;
+}
+
+size_t virtuappu_mode_vram_footprint(uint8_t mode)
+{
+    switch (mode) {
+    case 0:
+        return sizeof(Mode0Layout);
+    case 1:
+    case 2:
+        return sizeof(Mode1Layout);
+    case 7:
+        return sizeof(Mode7Layout);
+    default:
+        return 0u;
+    }
+}
+
+bool virtuappu_context_supports_mode(const VirtuaPPUContext *ctx, uint8_t mode)
+{
+    const VirtuaPPUMode1GbaMemory *memory;
+
+    if (ctx == NULL) {
+        return false;
+    }
+
+    switch (mode) {
+    case 0:
+        return MODE0_MAX_LINES <= VIRTUAPPU_MAX_FRAME_HEIGHT && ctx->registers->frame_width <= VIRTUAPPU_MAX_FRAME_WIDTH &&
+               ctx->vram_size >= sizeof(Mode0Layout) &&
+               (size_t)ctx->registers->frame_width * MODE0_MAX_LINES <= ctx->frame_buffer_pixels;
+    case 1:
+    case 2:
+        /* Every region is either bound by the host or falls back to a Mode1Layout in the context VRAM. */
+        memory = &ctx->mode1_memory;
+        return memory->io_mem != NULL && memory->vram != NULL && memory->bg_palette != NULL && memory->obj_palette != NULL &&
+               memory->oam_mem != NULL && MODE1_GBA_WIDTH <= VIRTUAPPU_MAX_FRAME_WIDTH && MODE1_GBA_HEIGHT <= VIRTUAPPU_MAX_FRAME_HEIGHT &&
+               (size_t)MODE1_GBA_WIDTH * MODE1_GBA_HEIGHT <= ctx->frame_buffer_pixels;
+    case 7:
+        return ctx->vram_size >= sizeof(Mode7Layout) && MODE7_GB_SCREEN_WIDTH <= VIRTUAPPU_MAX_FRAME_WIDTH &&
+               MODE7_GB_SCREEN_HEIGHT <= VIRTUAPPU_MAX_FRAME_HEIGHT &&
+               (size_t)MODE7_GB_SCREEN_WIDTH * MODE7_GB_SCREEN_HEIGHT <= ctx->frame_buffer_pixels;
+    default:
+        return false;
+    }
+}
+
+void virtuappu_context_copy_state(VirtuaPPUContext *dst, const VirtuaPPUContext *src)
+{
+    uint8_t mode;
+
+    if (dst == NULL || src == NULL || dst == src) {
+        return;
+    }
+
+    mode = src->registers->mode;
+    if (virtuappu_mode_vram_footprint(mode) > dst->vram_size) {
+        return;
+    }
+
+    *dst->registers = *src->registers;
+    dst->input_hash_valid = false;
+
+    if (mode == 1u || mode == 2u) {
+        Mode1Layout *layout = (Mode1Layout *)dst->vram;
+        const VirtuaPPUMode1GbaMemory *memory = &src->mode1_memory;
+
+        memcpy(layout->io_mem, memory->io_mem, sizeof(layout->io_mem));
+        memcpy(layout->vram, memory->vram, sizeof(layout->vram));
+        memcpy(layout->bg_palette, memory->bg_palette, sizeof(layout->bg_palette));
+        memcpy(layout->obj_palette, memory->obj_palette, sizeof(layout->obj_palette));
+        memcpy(layout->oam_mem, memory->oam_mem, sizeof(layout->oam_mem));
+        virtuappu_mode1_bind_gba_memory_ctx(dst, NULL);
+        return;
+    }
+
+    memcpy(dst->vram, src->vram, virtuappu_mode_vram_footprint(mode));
+    virtuappu_virtual_tiles_flush_ctx(dst);
+}
+
+/* Large clears hand whole pages back to the kernel instead of writing them: private anonymous pages
+ * (heap and .bss alike) read back as zero and are only faulted in again when touched. */
+static void virtuappu_zero_memory(void *memory, size_t size)
+{
+    uint8_t *bytes = (uint8_t *)memory;
+
+#if defined(__linux__)
+    if (size >= VIRTUAPPU_RESET_MADVISE_BYTES) {
+        long page_size = sysconf(_SC_PAGESIZE);
+
+        if (page_size > 0) {
+            uintptr_t mask = (uintptr_t)page_size - 1u;
+            uint8_t *first = (uint8_t *)(((uintptr_t)bytes + mask) & ~mask);
+            uint8_t *last = (uint8_t *)(((uintptr_t)bytes + size) & ~mask);
+
+            if (first < last && madvise(first, (size_t)(last - first), MADV_DONTNEED) == 0) {
+                memset(bytes, 0, (size_t)(first - bytes));
+                memset(last, 0, (size_t)(bytes + size - last));
+                return;
+            }
+        }
+    }
+#endif
+
+    memset(bytes, 0, size);
+}
+
+static void virtuappu_reset_state(VirtuaPPUContext *ctx)
+{
+    memset(ctx->registers, 0, sizeof(*ctx->registers));
+    ctx->input_hash_valid = false;
+    ctx->dirty_primed = false;
+    ctx->frame_setup.active = false;
+    virtuappu_virtual_tiles_flush_ctx(ctx);
+}
+
+void virtuappu_reset_ctx(VirtuaPPUContext *ctx)
+{
+    if (ctx == NULL) {
+        return;
+    }
+
+    virtuappu_simd_select();
+    virtuappu_zero_memory(ctx->frame_buffer, ctx->frame_buffer_pixels * sizeof(uint32_t));
+    if (ctx->vram != NULL) {
+        virtuappu_zero_memory(ctx->vram, ctx->vram_size);
+    }
+    virtuappu_reset_state(ctx);
+}
+
+static bool virtuappu_on_fallback_layout(const VirtuaPPUContext *ctx, const void *region)
+{
+    const uint8_t *bytes = (const uint8_t *)region;
+
+    return bytes == NULL || (ctx->vram != NULL && bytes >= ctx->vram && bytes < ctx->vram + ctx->vram_size);
+}
+
+void virtuappu_reset_mode_ctx(VirtuaPPUContext *ctx, uint8_t mode)
+{
+    size_t vram_bytes;
+    size_t frame_pixels;
+
+    if (ctx == NULL) {
+        return;
+    }
+
+    /* Only the mode's own layout and frame area are cleared; bytes beyond them stay as they were. */
+    switch (mode) {
+    case 0:
+        frame_pixels = ctx->frame_buffer_pixels;
+        break;
+    case 1:
+    case 2:
+        frame_pixels = (size_t)MODE1_GBA_WIDTH * MODE1_GBA_HEIGHT;
+        break;
+    case 7:
+        frame_pixels = (size_t)MODE7_GB_SCREEN_WIDTH * MODE7_GB_SCREEN_HEIGHT;
+        break;
+    default:
+        return;
+    }
+
+    virtuappu_simd_select();
+    vram_bytes = virtuappu_mode_vram_footprint(mode);
+    if (frame_pixels > ctx->frame_buffer_pixels) {
+        frame_pixels = ctx->frame_buffer_pixels;
+    }
+    if (vram_bytes > ctx->vram_size) {
+        vram_bytes = ctx->vram_size;
+    }
+
+    virtuappu_zero_memory(ctx->frame_buffer, frame_pixels * sizeof(uint32_t));
+    if (ctx->vram != NULL) {
+        virtuappu_zero_memory(ctx->vram, vram_bytes);
+    }
+    virtuappu_reset_state(ctx);
+    ctx->registers->mode = mode;
+    if (mode == 0u) {
+        /* The widest frame the context was sized for, as virtuappu_context_create_for_mode() was asked. */
+        frame_pixels = ctx->frame_buffer_pixels / MODE0_MAX_LINES;
+        ctx->registers->frame_width = (uint16_t)((frame_pixels < VIRTUAPPU_MAX_FRAME_WIDTH) ? frame_pixels : VIRTUAPPU_MAX_FRAME_WIDTH);
+    } else if (mode == 1u || mode == 2u) {
+        VirtuaPPUMode1GbaMemory memory = ctx->mode1_memory;
+
+        /* Host-bound regions stay bound; only regions on the fallback layout (or unbound) are rebound to it. */
+        memory.io_mem = virtuappu_on_fallback_layout(ctx, memory.io_mem) ? NULL : memory.io_mem;
+        memory.vram = virtuappu_on_fallback_layout(ctx, memory.vram) ? NULL : memory.vram;
+        memory.bg_palette = virtuappu_on_fallback_layout(ctx, memory.bg_palette) ? NULL : memory.bg_palette;
+        memory.obj_palette = virtuappu_on_fallback_layout(ctx, memory.obj_palette) ? NULL : memory.obj_palette;
+        memory.oam_mem = virtuappu_on_fallback_layout(ctx, memory.oam_mem) ? NULL : memory.oam_mem;
+        virtuappu_mode1_bind_gba_memory_ctx(ctx, &memory);
+    }
+}
+
+bool virtuappu_get_frame_size_ctx(const VirtuaPPUContext *ctx, uint32_t *width, uint32_t *height)
+{
+    uint32_t frame_width;
+    uint32_t frame_height;
+
+    if (ctx == NULL || !virtuappu_context_supports_mode(ctx, ctx->registers->mode)) {
+        return false;
+    }
+
+    switch (ctx->registers->mode) {
+    case 0:
+        frame_width = ctx->registers->frame_width;
+        frame_height = MODE0_MAX_LINES;
+        if (frame_width == 0u || frame_width > VIRTUAPPU_MAX_FRAME_WIDTH) {
+            return false;
+        }
+        break;
+    case 1:
+    case 2:
+        frame_width = MODE1_GBA_WIDTH;
+        frame_height = MODE1_GBA_HEIGHT;
+        break;
+    case 7:
+        frame_width = MODE7_GB_SCREEN_WIDTH;
+        frame_height = MODE7_GB_SCREEN_HEIGHT;
+        break;
+    default:
+        return false;
+    }
+
+    if (width != NULL) {
+        *width = frame_width;
+    }
+    if (height != NULL) {
+        *height = frame_height;
+    }
+    return true;
+}
+
+static void virtuappu_prime_dirty_tracking(VirtuaPPUContext *ctx)
+{
+    uint32_t width;
+
+    if (!ctx->dirty_tracking) {
+        return;
+    }
+
+    /* The frame just written becomes the baseline the next frame is compared against. */
+    ctx->dirty_primed = virtuappu_get_frame_size_ctx(ctx, &width, NULL);
+    ctx->dirty_width = ctx->dirty_primed ? (uint16_t)width : 0u;
+}
+
+static uint64_t virtuappu_hash_mix(uint64_t hash, uint64_t word)
+{
+    hash ^= word * 0x9E3779B97F4A7C15ull;
+    hash = (hash << 31u) | (hash >> 33u);
+    return hash * 0xC2B2AE3D27D4EB4Full;
+}
+
+static uint64_t virtuappu_hash_bytes(uint64_t hash, const void *data, size_t size)
 {
-    switch (virtuappu_registers.mode) {
+    const uint8_t *bytes = (const uint8_t *)data;
+    uint64_t lanes[4] = {hash, hash ^ 0x165667B19E3779F9ull, hash + 0x27D4EB2F165667C5ull, ~hash};
+    uint64_t tail = 0u;
+    size_t offset = 0u;
+    size_t lane;
+
+    /* Four independent lanes keep the multiply latency off the critical path. */
+    for (; offset + 32u <= size; offset += 32u) {
+        for (lane = 0; lane < 4u; ++lane) {
+            uint64_t word;
+            memcpy(&word, bytes + offset + lane * 8u, sizeof(word));
+            lanes[lane] = virtuappu_hash_mix(lanes[lane], word);
+        }
+    }
+
+    for (lane = 0; offset + 8u <= size; offset += 8u, lane = (lane + 1u) & 3u) {
+        uint64_t word;
+        memcpy(&word, bytes + offset, sizeof(word));
+        lanes[lane] = virtuappu_hash_mix(lanes[lane], word);
+    }
+
+    if (offset < size) {
+        memcpy(&tail, bytes + offset, size - offset);
+    }
+
+    hash = virtuappu_hash_mix(lanes[0], lanes[1]);
+    hash = virtuappu_hash_mix(hash, lanes[2]);
+    hash = virtuappu_hash_mix(hash, lanes[3]);
+    hash = virtuappu_hash_mix(hash, tail);
+    return virtuappu_hash_mix(hash, (uint64_t)size);
+}
+
+enum {
+    VIRTUAPPU_HASH_TILE_BYTES = 32u,
+    VIRTUAPPU_HASH_TILE_UNITS = sizeof(((Mode0Layout *)0)->gfx_data) / VIRTUAPPU_HASH_TILE_BYTES,
+    VIRTUAPPU_HASH_TILE_WORDS = VIRTUAPPU_HASH_TILE_UNITS / 64u
+};
+
+/* Tile n sits at n * 32 in gfx_data at 4bpp and at n * 64 at 8bpp; tiles past the end are not read. */
+static void virtuappu_mark_tiles(uint64_t *used, uint64_t tile, uint32_t count, bool bpp8)
+{
+    uint64_t unit = bpp8 ? tile * 2u : tile;
+    uint64_t end = unit + (uint64_t)count * (bpp8 ? 2u : 1u);
+
+    if (end > VIRTUAPPU_HASH_TILE_UNITS) {
+        end = VIRTUAPPU_HASH_TILE_UNITS;
+    }
+    for (; unit < end; ++unit) {
+        used[unit / 64u] |= (uint64_t)1u << (unit % 64u);
+    }
+}
+
+/* Only the gfx_data tiles that enabled BG maps and objects name are hashed, run by run, instead of all 2 MB. */
+static uint64_t virtuappu_hash_mode0_tiles(const Mode0Layout *layout, uint64_t hash, const size_t entry_counts[MODE0_BG_COUNT])
+{
+    uint64_t used[VIRTUAPPU_HASH_TILE_WORDS];
+    size_t run_start = 0u;
+    bool in_run = false;
+    size_t unit;
+    size_t bg;
+    size_t i;
+
+    /* Until the BG fetch defines where tile_base points, a BG with a non-zero base may read any tile. */
+    for (bg = 0; bg < MODE0_BG_COUNT; ++bg) {
+        if ((layout->bg[bg].flags & MODE0_BG_FLAG_ENABLED) != 0u && layout->bg[bg].tile_base != 0u) {
+            return virtuappu_hash_bytes(hash, layout->gfx_data, sizeof(layout->gfx_data));
+        }
+    }
+
+    memset(used, 0, sizeof(used));
+    for (bg = 0; bg < MODE0_BG_COUNT; ++bg) {
+        const Mode0BgEntry *entry = &layout->bg[bg];
+        bool bpp8 = (entry->flags & MODE0_BG_FLAG_BPP8) != 0u;
+
+        for (i = 0; i < entry_counts[bg]; ++i) {
+            virtuappu_mark_tiles(used, layout->tilemaps[bg][i] & 0xFFFFu, 1u, bpp8);
+        }
+    }
+
+    for (i = 0; i < MODE0_OAM_COUNT; ++i) {
+        const Mode0OAMEntry *obj = &layout->oam[i];
+        uint32_t tile_count;
+
+        if ((obj->flags & MODE0_OAM_FLAG_ENABLED) == 0u) {
+            continue;
+        }
+        tile_count = (uint32_t)(obj->width_blocks ? obj->width_blocks : 1u) * (obj->height_blocks ? obj->height_blocks : 1u);
+        virtuappu_mark_tiles(used, obj->tile_index, tile_count, (obj->flags & MODE0_OAM_FLAG_BPP8) != 0u);
+    }
+
+    for (unit = 0; unit <= VIRTUAPPU_HASH_TILE_UNITS; ++unit) {
+        bool set;
+
+        if (unit % 64u == 0u && unit < VIRTUAPPU_HASH_TILE_UNITS && used[unit / 64u] == 0u && !in_run) {
+            unit += 63u;
+            continue;
+        }
+
+        set = unit < VIRTUAPPU_HASH_TILE_UNITS && (used[unit / 64u] & ((uint64_t)1u << (unit % 64u))) != 0u;
+        if (set && !in_run) {
+            run_start = unit;
+            in_run = true;
+        } else if (!set && in_run) {
+            hash = virtuappu_hash_mix(hash, (uint64_t)run_start);
+            hash = virtuappu_hash_bytes(hash, layout->gfx_data + run_start * VIRTUAPPU_HASH_TILE_BYTES,
+                                        (unit - run_start) * VIRTUAPPU_HASH_TILE_BYTES);
+            in_run = false;
+        }
+    }
+
+    return hash;
+}
+
+static uint64_t virtuappu_hash_mode0(const VirtuaPPUContext *ctx, uint64_t hash)
+{
+    const Mode0Layout *layout = (const Mode0Layout *)ctx->vram;
+    size_t entry_counts[MODE0_BG_COUNT];
+    size_t bg;
+
+    hash = virtuappu_hash_bytes(hash, &layout->regs, sizeof(layout->regs));
+    hash = virtuappu_hash_bytes(hash, layout->bg, sizeof(layout->bg));
+    hash = virtuappu_hash_bytes(hash, layout->bg_ring, sizeof(layout->bg_ring));
+    for (bg = 0; bg < MODE0_BG_COUNT; ++bg) {
+        const Mode0BgRing *ring = &layout->bg_ring[bg];
+
+        entry_counts[bg] = 0u;
+        if ((layout->bg[bg].flags & MODE0_BG_FLAG_ENABLED) == 0u) {
+            continue;
+        }
+
+        /* A ring BG only reads the entries of its torus. */
+        entry_counts[bg] = MODE0_TILEMAP_ENTRIES_PER_BG;
+        if ((layout->bg[bg].flags & MODE0_BG_FLAG_RING) != 0u && ring->width_tiles != 0u && ring->height_tiles != 0u &&
+            (size_t)ring->width_tiles * ring->height_tiles <= MODE0_TILEMAP_ENTRIES_PER_BG) {
+            entry_counts[bg] = (size_t)ring->width_tiles * ring->height_tiles;
+        }
+        hash = virtuappu_hash_bytes(hash, layout->tilemaps[bg], entry_counts[bg] * sizeof(Mode0TileEntry));
+        hash = virtuappu_hash_bytes(hash, layout->bg_line_scroll[bg], sizeof(layout->bg_line_scroll[bg]));
+        hash = virtuappu_hash_bytes(hash, layout->bg_line_affine[bg], sizeof(layout->bg_line_affine[bg]));
+    }
+    hash = virtuappu_hash_mode0_tiles(layout, hash, entry_counts);
+    hash = virtuappu_hash_bytes(hash, layout->palettes, sizeof(layout->palettes));
+    hash = virtuappu_hash_bytes(hash, layout->obj_affine, sizeof(layout->obj_affine));
+    return virtuappu_hash_bytes(hash, layout->oam, sizeof(layout->oam));
+}
+
+static uint64_t virtuappu_hash_mode1(const VirtuaPPUContext *ctx, uint64_t hash)
+{
+    const VirtuaPPUMode1GbaMemory *memory = &ctx->mode1_memory;
+
+    /* Only the display registers feed the renderer; timers, DMA and sound change every frame. */
+    hash = virtuappu_hash_bytes(hash, memory->io_mem, MODE1_IO_BLDY + 2u);
+    hash = virtuappu_hash_bytes(hash, memory->vram, MODE1_VRAM_SIZE);
+    hash = virtuappu_hash_bytes(hash, memory->bg_palette, MODE1_PALETTE_COLORS * sizeof(uint16_t));
+    hash = virtuappu_hash_bytes(hash, memory->obj_palette, MODE1_PALETTE_COLORS * sizeof(uint16_t));
+    return virtuappu_hash_bytes(hash, memory->oam_mem, MODE1_OAM_HALFWORDS * sizeof(uint16_t));
+}
+
+uint64_t virtuappu_frame_input_hash(const VirtuaPPUContext *ctx)
+{
+    uint64_t hash;
+
+    if (ctx == NULL) {
+        return 0u;
+    }
+
+    hash = virtuappu_hash_bytes(0x243F6A8885A308D3ull, ctx->registers, sizeof(*ctx->registers));
+    if (!virtuappu_context_supports_mode(ctx, ctx->registers->mode)) {
+        return hash;
+    }
+    hash = virtuappu_hash_mix(hash, (uint64_t)(uintptr_t)ctx->target.pixels);
+    hash = virtuappu_hash_mix(hash, (uint64_t)ctx->target.pitch);
+    hash = virtuappu_hash_mix(hash, ((uint64_t)ctx->target.format << 16u) | ((uint64_t)ctx->target.scale << 8u) |
+                                        (uint64_t)ctx->target.scanlines);
+
+    switch (ctx->registers->mode) {
     case 0:
-        virtuappu_mode0_render_frame(&virtuappu_registers);
+        return virtuappu_hash_mode0(ctx, hash);
+    case 1:
+    case 2:
+        return virtuappu_hash_mode1(ctx, hash);
+    case 7:
+        return virtuappu_hash_bytes(hash, ctx->vram, sizeof(Mode7Layout));
+    default:
+        return hash;
+    }
+}
+
+void virtuappu_render_frame_ctx(VirtuaPPUContext *ctx)
+{
+    if (ctx == NULL) {
+        return;
+    }
+
+    virtuappu_command_queue_apply_ctx(ctx, ctx->command_queue);
+    ctx->input_hash_valid = false;
+    ctx->frame_setup.active = false;
+    virtuappu_reset_output_palette(ctx);
+    switch (ctx->registers->mode) {
+    case 0:
+        virtuappu_mode0_render_frame_ctx(ctx);
         break;
     case 1:
-        virtuappu_mode1_render_frame(&virtuappu_registers);
+        virtuappu_mode1_render_frame_ctx(ctx);
         break;
     case 2:
-        virtuappu_mode2_render_frame(&virtuappu_registers);
+        virtuappu_mode2_render_frame_ctx(ctx);
         break;
     case 7:
-        virtuappu_mode7_render_frame(&virtuappu_registers);
+        virtuappu_mode7_render_frame_ctx(ctx);
         break;
     default:
         break;
     }
+
+    virtuappu_prime_dirty_tracking(ctx);
+}
+
+static void virtuappu_begin_line_frame(VirtuaPPUContext *ctx, uint32_t height)
+{
+    virtuappu_command_queue_apply_ctx(ctx, ctx->command_queue);
+    ctx->input_hash_valid = false;
+    virtuappu_reset_output_palette(ctx);
+    VIRTUAPPU_STATS_BEGIN_FRAME(ctx, height);
+    if (ctx->registers->mode == 0u) {
+        virtuappu_virtual_tiles_begin_frame_ctx(ctx);
+    }
+    ctx->frame_setup.mode = ctx->registers->mode;
+    ctx->frame_setup.active = true;
+    (void)height;
+}
+
+void virtuappu_render_lines_ctx(VirtuaPPUContext *ctx, uint32_t first_line, uint32_t end_line)
+{
+    uint32_t height;
+
+    if (ctx == NULL || !virtuappu_get_frame_size_ctx(ctx, NULL, &height)) {
+        return;
+    }
+
+    if (end_line > height) {
+        end_line = height;
+    }
+    if (first_line >= end_line) {
+        return;
+    }
+
+    /* Line 0, or a mode switch mid-frame, starts a new frame; every other range reuses its setup. */
+    if (first_line == 0u || !ctx->frame_setup.active || ctx->frame_setup.mode != ctx->registers->mode) {
+        virtuappu_begin_line_frame(ctx, height);
+    }
+
+    switch (ctx->registers->mode) {
+    case 0:
+        virtuappu_mode0_render_lines_ctx(ctx, first_line, end_line);
+        break;
+    case 1:
+        virtuappu_mode1_render_lines_ctx(ctx, first_line, end_line);
+        break;
+    case 2:
+        virtuappu_mode2_render_lines_ctx(ctx, first_line, end_line);
+        break;
+    case 7:
+        virtuappu_mode7_render_lines_ctx(ctx, first_line, end_line);
+        break;
+    default:
+        break;
+    }
+
+    if (end_line == height) {
+        ctx->frame_setup.active = false;
+        virtuappu_prime_dirty_tracking(ctx);
+        VIRTUAPPU_STATS_END_FRAME(ctx);
+    }
+}
+
+VirtuaPPURenderStatus virtuappu_render_frame_if_changed_ctx(VirtuaPPUContext *ctx)
+{
+    uint64_t hash;
+
+    if (ctx == NULL) {
+        return VIRTUAPPU_RENDER_INVALID;
+    }
+
+    virtuappu_command_queue_apply_ctx(ctx, ctx->command_queue);
+    hash = virtuappu_frame_input_hash(ctx);
+    if (ctx->input_hash_valid && ctx->input_hash == hash) {
+        memset(ctx->dirty_lines, 0, sizeof(ctx->dirty_lines));
+        return VIRTUAPPU_RENDER_UNCHANGED;
+    }
+
+    virtuappu_render_frame_ctx(ctx);
+    ctx->input_hash = hash;
+    ctx->input_hash_valid = true;
+    return VIRTUAPPU_RENDER_UPDATED;
+}
+
+static size_t virtuappu_batch_chunk_lines(const VirtuaPPUContext *ctx)
+{
+    size_t width = (size_t)ctx->registers->frame_width;
+    size_t lines;
+
+    if (ctx->registers->mode != 0u || width == 0u || width * MODE0_MAX_LINES < VIRTUAPPU_BATCH_SPLIT_PIXELS ||
+        virtuappu_pixel_format_is_indexed(ctx->target.format)) {
+        return 0u;
+    }
+
+    lines = VIRTUAPPU_BATCH_CHUNK_PIXELS / width;
+    return (lines < 8u) ? 8u : lines;
+}
+
+static void virtuappu_batch_run(void *user, size_t begin, size_t end)
+{
+    const VirtuaPPUBatchTask *tasks = (const VirtuaPPUBatchTask *)user;
+    size_t task;
+
+    for (task = begin; task < end; ++task) {
+        if (tasks[task].end_line == 0u) {
+            virtuappu_render_frame_ctx(tasks[task].ctx);
+        } else {
+            virtuappu_mode0_render_lines_ctx(tasks[task].ctx, tasks[task].first_line, tasks[task].end_line);
+        }
+    }
+}
+
+void virtuappu_render_batch(VirtuaPPUContext *const *contexts, size_t count)
+{
+    VirtuaPPUBatchTask *tasks;
+    size_t task_count = 0u;
+    size_t i;
+
+    if (contexts == NULL || count == 0u) {
+        return;
+    }
+
+    for (i = 0; i < count; ++i) {
+        size_t chunk;
+
+        if (contexts[i] == NULL) {
+            continue;
+        }
+
+        chunk = virtuappu_batch_chunk_lines(contexts[i]);
+        task_count += (chunk == 0u) ? 1u : (MODE0_MAX_LINES + chunk - 1u) / chunk;
+    }
+
+    tasks = (VirtuaPPUBatchTask *)malloc(task_count * sizeof(*tasks));
+    if (tasks == NULL) {
+        for (i = 0; i < count; ++i) {
+            virtuappu_render_frame_ctx(contexts[i]);
+        }
+        return;
+    }
+
+    task_count = 0u;
+    for (i = 0; i < count; ++i) {
+        size_t chunk;
+        size_t line;
+
+        if (contexts[i] == NULL) {
+            continue;
+        }
+
+        virtuappu_command_queue_apply_ctx(contexts[i], contexts[i]->command_queue);
+        chunk = virtuappu_batch_chunk_lines(contexts[i]);
+        contexts[i]->input_hash_valid = false;
+        if (chunk == 0u) {
+            tasks[task_count].ctx = contexts[i];
+            tasks[task_count].first_line = 0u;
+            tasks[task_count].end_line = 0u;
+            ++task_count;
+            continue;
+        }
+
+        VIRTUAPPU_STATS_BEGIN_FRAME(contexts[i], MODE0_MAX_LINES);
+        virtuappu_virtual_tiles_begin_frame_ctx(contexts[i]);
+        for (line = 0; line < MODE0_MAX_LINES; line += chunk) {
+            tasks[task_count].ctx = contexts[i];
+            tasks[task_count].first_line = line;
+            tasks[task_count].end_line = (line + chunk < MODE0_MAX_LINES) ? line + chunk : MODE0_MAX_LINES;
+            ++task_count;
+        }
+    }
+
+    virtuappu_parallel_for(task_count, 1u, virtuappu_batch_run, tasks);
+
+    for (i = 0; i < count; ++i) {
+        if (contexts[i] != NULL) {
+            virtuappu_prime_dirty_tracking(contexts[i]);
+        }
+    }
+
+#ifdef VIRTUAPPU_ENABLE_STATS
+    for (i = 0; i < count; ++i) {
+        if (contexts[i] != NULL && virtuappu_batch_chunk_lines(contexts[i]) != 0u) {
+            virtuappu_stats_end_frame(contexts[i]);
+        }
+    }
+#endif
+
+    free(tasks);
+}
+
+void virtuappu_reset(void)
+{
+    virtuappu_reset_ctx(&virtuappu_default_context);
+}
+
+void virtuappu_reset_mode(uint8_t mode)
+{
+    virtuappu_reset_mode_ctx(&virtuappu_default_context, mode);
+}
+
+void virtuappu_render_frame(void)
+{
+    virtuappu_render_frame_ctx(&virtuappu_default_context);
+}
+
+void virtuappu_render_lines(uint32_t first_line, uint32_t end_line)
+{
+    virtuappu_render_lines_ctx(&virtuappu_default_context, first_line, end_line);
+}
+
+VirtuaPPURenderStatus virtuappu_render_frame_if_changed(void)
+{
+    return virtuappu_render_frame_if_changed_ctx(&virtuappu_default_context);
 }
 
 uint32_t *virtuappu_get_frame_buffer(void)
 {
-    return virtuappu_frame_buffer;
+    return virtuappu_default_context.frame_buffer;
 }
 
 uint8_t *virtuappu_get_vram(void)
 {
-    return virtuappu_vram;
+    return virtuappu_default_context.vram;
 }
 
 PPUMemory *virtuappu_get_registers(void)
 {
-    return &virtuappu_registers;
+    return virtuappu_default_context.registers;
 }
@@ -3,6 +3,33 @@ add_rules("mode.debug", "mode.release")
 set_languages("c17")
 set_defaultmode("release")
 
+option("openmp")
+    set_default(false)
+    set_showmenu(true)
+    set_description("Run virtuappu_parallel_for on OpenMP instead of the built-in worker pool")
+option_end()
+
+option("stats")
+    set_default(false)
+    set_showmenu(true)
+    set_description("Record per-stage cycle counters and per-line histograms readable through virtuappu_get_stats()")
+option_end()
+
+option("max_frame_width")
+    set_showmenu(true)
+    set_description("Override VIRTUAPPU_MAX_FRAME_WIDTH (default 1280)")
+option_end()
+
+option("max_frame_height")
+    set_showmenu(true)
+    set_description("Override VIRTUAPPU_MAX_FRAME_HEIGHT (default 360; Mode 0 needs 360)")
+option_end()
+
+option("vram_size")
+    set_showmenu(true)
+    set_description("Override VIRTUAPPU_VRAM_SIZE in bytes (default 4194304; a multiple of 4096)")
+option_end()
+
 target("VirtuaPPU")
     set_kind("static")
     if is_plat("windows") then
@@ -12,7 +39,55 @@ target("VirtuaPPU")
     add_includedirs("include", {public = true})
     add_headerfiles("include/**.h")
     add_files("src/*.c")
-    add_defines("USE_OPENMP")
-    add_cflags("-fopenmp", {tools = {"gcc", "clang"}})
-    add_ldflags("-fopenmp", {tools = {"gcc", "clang"}})
-    add_syslinks("gomp", {public = true})
+    add_syslinks("pthread", {public = true})
+    if has_config("openmp") then
+        add_defines("USE_OPENMP")
+        add_cflags("-fopenmp", {tools = {"gcc", "clang"}})
+        add_ldflags("-fopenmp", {tools = {"gcc", "clang"}})
+        add_syslinks("gomp", {public = true})
+    end
+    if has_config("stats") then
+        add_defines("VIRTUAPPU_ENABLE_STATS", {public = true})
+    end
+    if get_config("max_frame_width") then
+        add_defines("VIRTUAPPU_MAX_FRAME_WIDTH=" .. get_config("max_frame_width"), {public = true})
+    end
+    if get_config("max_frame_height") then
+        add_defines("VIRTUAPPU_MAX_FRAME_HEIGHT=" .. get_config("max_frame_height"), {public = true})
+    end
+    if get_config("vram_size") then
+        add_defines("VIRTUAPPU_VRAM_SIZE=" .. get_config("vram_size"), {public = true})
+    end
+
+target("virtuappu_bench")
+    set_kind("binary")
+    set_default(false)
+    add_deps("VirtuaPPU")
+    add_files("bench/*.c")
+    if not is_plat("windows", "mingw") then
+        add_syslinks("m")
+    end
+
+target("virtuappu_replay")
+    set_kind("binary")
+    set_default(false)
+    add_deps("VirtuaPPU")
+    add_files("replay/*.c")
+
+target("virtuappu_fuzz")
+    set_kind("binary")
+    set_default(false)
+    add_deps("VirtuaPPU")
+    add_files("fuzz/*.c")
+
+target("virtuappu_assetpack")
+    set_kind("binary")
+    set_default(false)
+    add_deps("VirtuaPPU")
+    add_files("assetpack/*.c")
+
+target("virtuappu_queue_stress")
+    set_kind("binary")
+    set_default(false)
+    add_deps("VirtuaPPU")
+    add_files("queue_stress/*.c")